@@ -0,0 +1,196 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "cim_datetime.h"
+
+namespace daw {
+	namespace wmi {
+		namespace {
+			int64_t const microseconds_per_second = 1000000;
+			int64_t const seconds_per_day = 86400;
+
+			char const digit_pairs[] =
+				"00010203040506070809"
+				"10111213141516171819"
+				"20212223242526272829"
+				"30313233343536373839"
+				"40414243444546474849"
+				"50515253545556575859"
+				"60616263646566676869"
+				"70717273747576777879"
+				"80818283848586878889"
+				"90919293949596979899";
+
+			// Days since 1970-01-01 in the proleptic Gregorian calendar
+			int64_t days_from_civil( int64_t year, int const month, int const day ) {
+				year -= month <= 2 ? 1 : 0;
+				auto const era = (year >= 0 ? year : year - 399) / 400;
+				auto const year_of_era = year - era * 400;
+				auto const day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+				auto const day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+				return era * 146097 + day_of_era - 719468;
+			}
+
+			void civil_from_days( int64_t days, int64_t & year, int & month, int & day ) {
+				days += 719468;
+				auto const era = (days >= 0 ? days : days - 146096) / 146097;
+				auto const day_of_era = days - era * 146097;
+				auto const year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+				auto const day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+				auto const mp = (5 * day_of_year + 2) / 153;
+				day = static_cast<int>(day_of_year - (153 * mp + 2) / 5 + 1);
+				month = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+				year = year_of_era + era * 400 + (month <= 2 ? 1 : 0);
+			}
+
+			template<typename CharT>
+			bool read_digits( CharT const * str, size_t const count, int & out_value ) {
+				int result = 0;
+				for( size_t n = 0; n < count; ++n ) {
+					auto const c = str[n];
+					if( c < static_cast<CharT>('0') || c > static_cast<CharT>('9') ) {
+						return false;
+					}
+					result = result * 10 + static_cast<int>(c - static_cast<CharT>('0'));
+				}
+				out_value = result;
+				return true;
+			}
+
+			template<typename CharT>
+			bool parse( boost::basic_string_ref<CharT> value, int64_t & out_timestamp, int16_t & out_utc_offset ) {
+				if( value.size( ) != 25 || static_cast<CharT>('.') != value[14] ) {
+					return false;
+				}
+				auto const str = value.data( );
+				int year, month, day, hour, minute, second, microsecond, offset;
+				if( !read_digits( str, 4, year ) || !read_digits( str + 4, 2, month ) || !read_digits( str + 6, 2, day )
+					|| !read_digits( str + 8, 2, hour ) || !read_digits( str + 10, 2, minute ) || !read_digits( str + 12, 2, second )
+					|| !read_digits( str + 15, 6, microsecond ) || !read_digits( str + 22, 3, offset ) ) {
+					return false;
+				}
+				if( month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60 ) {
+					return false;
+				}
+				if( static_cast<CharT>('-') == str[21] ) {
+					offset = -offset;
+				} else if( static_cast<CharT>('+') != str[21] ) {
+					return false;
+				}
+				// The fields are the wall clock time at the offset
+				auto const local_seconds = days_from_civil( year, month, day ) * seconds_per_day + hour * 3600 + minute * 60 + second;
+				out_timestamp = (local_seconds - offset * 60) * microseconds_per_second + microsecond;
+				out_utc_offset = static_cast<int16_t>(offset);
+				return true;
+			}
+
+			template<typename CharT>
+			CharT * write_pair( CharT * out, int const value ) {
+				out[0] = static_cast<CharT>(digit_pairs[value * 2]);
+				out[1] = static_cast<CharT>(digit_pairs[value * 2 + 1]);
+				return out + 2;
+			}
+
+			template<typename CharT>
+			void format( int64_t const timestamp, int16_t const utc_offset, CharT * out ) {
+				auto local_seconds = timestamp / microseconds_per_second + utc_offset * 60;
+				if( timestamp % microseconds_per_second < 0 ) {
+					--local_seconds;
+				}
+				auto days = local_seconds / seconds_per_day;
+				auto seconds_of_day = local_seconds % seconds_per_day;
+				if( seconds_of_day < 0 ) {
+					seconds_of_day += seconds_per_day;
+					--days;
+				}
+				int64_t year;
+				int month, day;
+				civil_from_days( days, year, month, day );
+
+				out = write_pair( out, static_cast<int>((year / 100) % 100) );
+				out = write_pair( out, static_cast<int>(year % 100) );
+				*out++ = static_cast<CharT>('/');
+				out = write_pair( out, month );
+				*out++ = static_cast<CharT>('/');
+				out = write_pair( out, day );
+				*out++ = static_cast<CharT>('/');
+				out = write_pair( out, static_cast<int>(seconds_of_day / 3600) );
+				*out++ = static_cast<CharT>(':');
+				out = write_pair( out, static_cast<int>((seconds_of_day / 60) % 60) );
+				*out++ = static_cast<CharT>(':');
+				write_pair( out, static_cast<int>(seconds_of_day % 60) );
+			}
+		}	// namespace anonymous
+
+		bool parse_cim_datetime( boost::wstring_ref value, int64_t & out_timestamp, int16_t & out_utc_offset ) {
+			return parse( value, out_timestamp, out_utc_offset );
+		}
+
+		bool parse_cim_datetime( boost::string_ref value, int64_t & out_timestamp, int16_t & out_utc_offset ) {
+			return parse( value, out_timestamp, out_utc_offset );
+		}
+
+		void format_timestamp( int64_t const timestamp, int16_t const utc_offset, wchar_t * out ) {
+			format( timestamp, utc_offset, out );
+		}
+
+		void format_timestamp( int64_t const timestamp, int16_t const utc_offset, char * out ) {
+			format( timestamp, utc_offset, out );
+		}
+
+		std::string format_cim_datetime( int64_t const timestamp ) {
+			auto seconds = timestamp / microseconds_per_second;
+			auto microsecond = timestamp % microseconds_per_second;
+			if( microsecond < 0 ) {
+				microsecond += microseconds_per_second;
+				--seconds;
+			}
+			auto days = seconds / seconds_per_day;
+			auto seconds_of_day = seconds % seconds_per_day;
+			if( seconds_of_day < 0 ) {
+				seconds_of_day += seconds_per_day;
+				--days;
+			}
+			int64_t year;
+			int month, day;
+			civil_from_days( days, year, month, day );
+
+			// yyyymmddHHMMSS.mmmmmm+000
+			std::string result( 25, '0' );
+			auto out = &result[0];
+			out = write_pair( out, static_cast<int>((year / 100) % 100) );
+			out = write_pair( out, static_cast<int>(year % 100) );
+			out = write_pair( out, month );
+			out = write_pair( out, day );
+			out = write_pair( out, static_cast<int>(seconds_of_day / 3600) );
+			out = write_pair( out, static_cast<int>((seconds_of_day / 60) % 60) );
+			out = write_pair( out, static_cast<int>(seconds_of_day % 60) );
+			*out++ = '.';
+			out = write_pair( out, static_cast<int>(microsecond / 10000) );
+			out = write_pair( out, static_cast<int>((microsecond / 100) % 100) );
+			out = write_pair( out, static_cast<int>(microsecond % 100) );
+			*out = '+';
+			return result;
+		}
+	}	// namespace wmi
+}	// namespace daw
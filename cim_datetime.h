@@ -0,0 +1,64 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <boost/utility/string_ref.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace daw {
+	namespace wmi {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Length of "YYYY/MM/DD/HH:MM:SS" as written by
+		///				format_timestamp
+		//////////////////////////////////////////////////////////////////////////
+		size_t const formatted_timestamp_size = 19;
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Parse a CIM_DATETIME, yyyymmddHHMMSS.mmmmmmsUUU, into
+		///				microseconds since 1970-01-01 UTC and the UTC offset in
+		///				minutes that it was written with.  Returns false and
+		///				leaves the outputs alone if value is not a valid
+		///				CIM_DATETIME.  Does not allocate.
+		//////////////////////////////////////////////////////////////////////////
+		bool parse_cim_datetime( boost::wstring_ref value, int64_t & out_timestamp, int16_t & out_utc_offset );
+		bool parse_cim_datetime( boost::string_ref value, int64_t & out_timestamp, int16_t & out_utc_offset );
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Write timestamp as the wall clock time at utc_offset,
+		///				formatted YYYY/MM/DD/HH:MM:SS.  out must have room for
+		///				formatted_timestamp_size characters, no terminator is
+		///				written.
+		//////////////////////////////////////////////////////////////////////////
+		void format_timestamp( int64_t const timestamp, int16_t const utc_offset, wchar_t * out );
+		void format_timestamp( int64_t const timestamp, int16_t const utc_offset, char * out );
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Write timestamp as a UTC CIM_DATETIME,
+		///				yyyymmddHHMMSS.mmmmmm+000, for use in WQL comparisons
+		//////////////////////////////////////////////////////////////////////////
+		std::string format_cim_datetime( int64_t const timestamp );
+	}	// namespace wmi
+}	// namespace daw
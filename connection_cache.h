@@ -0,0 +1,158 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <boost/utility/string_ref.hpp>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace daw {
+	namespace wmi {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Keeps a connection per host so later queries skip the
+		///				connection setup.  Connection is any copyable handle
+		///				that shares the underlying connection, such as a
+		///				ComSmartPtr to a secured proxy.  At most max_size hosts
+		///				are kept; the least recently used is dropped to make
+		///				room.  Safe to use from several threads, connect is
+		///				called without the lock held so slow connections to
+		///				different hosts overlap.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename Connection>
+		class connection_cache {
+			using entries_t = std::list<std::pair<std::wstring, Connection>>;
+
+			mutable std::mutex m_mutex;
+			entries_t m_entries;	// most recently used first
+			std::unordered_map<std::wstring, typename entries_t::iterator> m_index;
+			size_t m_max_size;
+
+			// Only called with m_mutex held
+			bool find( std::wstring const & host, Connection & out_connection ) {
+				auto const pos = m_index.find( host );
+				if( m_index.end( ) == pos ) {
+					return false;
+				}
+				m_entries.splice( m_entries.begin( ), m_entries, pos->second );
+				out_connection = pos->second->second;
+				return true;
+			}
+
+		public:
+			static size_t const default_max_size = 256;
+
+			explicit connection_cache( size_t const max_size = default_max_size ): m_mutex( ), m_entries( ), m_index( ), m_max_size( max_size > 0 ? max_size : 1 ) { }
+			~connection_cache( ) = default;
+			connection_cache( connection_cache const & ) = delete;
+			connection_cache & operator=( connection_cache const & ) = delete;
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	The connection kept for host, or a new one from
+			///				connect( host ) that is kept from now on.  reused is
+			///				set to whether it was already kept.
+			//////////////////////////////////////////////////////////////////////////
+			template<typename Connect>
+			Connection get( boost::wstring_ref host, Connect connect, bool & reused ) {
+				auto const key = host.to_string( );
+				Connection result;
+				{
+					std::lock_guard<std::mutex> lock( m_mutex );
+					reused = find( key, result );
+					if( reused ) {
+						return result;
+					}
+				}
+				result = connect( host );
+
+				std::lock_guard<std::mutex> lock( m_mutex );
+				auto const pos = m_index.find( key );
+				if( m_index.end( ) != pos ) {
+					// Another thread connected first, keep the newest
+					pos->second->second = result;
+					m_entries.splice( m_entries.begin( ), m_entries, pos->second );
+					return result;
+				}
+				m_entries.emplace_front( key, result );
+				m_index[key] = m_entries.begin( );
+				if( m_entries.size( ) > m_max_size ) {
+					m_index.erase( m_entries.back( ).first );
+					m_entries.pop_back( );
+				}
+				return result;
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Call use( connection ) with host's connection.  Any
+			///				failure drops the connection.  A kept connection may
+			///				have gone stale since it was made, e.g. the host
+			///				restarted, so when one fails use is called once more
+			///				on a new connection.  use must be safe to repeat.
+			//////////////////////////////////////////////////////////////////////////
+			template<typename Connect, typename Use>
+			auto use( boost::wstring_ref host, Connect connect, Use use ) -> decltype(use( std::declval<Connection &>( ) )) {
+				bool reused = false;
+				auto connection = get( host, connect, reused );
+				try {
+					return use( connection );
+				} catch( ... ) {
+					remove( host );
+					if( !reused ) {
+						throw;
+					}
+				}
+				connection = get( host, connect, reused );
+				try {
+					return use( connection );
+				} catch( ... ) {
+					remove( host );
+					throw;
+				}
+			}
+
+			/// Summary: Drop the connection kept for host, if any
+			void remove( boost::wstring_ref host ) {
+				std::lock_guard<std::mutex> lock( m_mutex );
+				auto const pos = m_index.find( host.to_string( ) );
+				if( m_index.end( ) != pos ) {
+					m_entries.erase( pos->second );
+					m_index.erase( pos );
+				}
+			}
+
+			void clear( ) {
+				std::lock_guard<std::mutex> lock( m_mutex );
+				m_index.clear( );
+				m_entries.clear( );
+			}
+
+			size_t size( ) const {
+				std::lock_guard<std::mutex> lock( m_mutex );
+				return m_entries.size( );
+			}
+		};	// class connection_cache
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,218 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Unit tests of the connection_cache policy with fake connections
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE connection_cache
+#include <atomic>
+#include <boost/test/unit_test.hpp>
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "connection_cache.h"
+
+namespace {
+	// Stands in for a secured proxy to a host
+	struct fake_connection {
+		std::wstring host;
+		int number;
+		bool stale;
+	};	// struct fake_connection
+
+	using connection_t = std::shared_ptr<fake_connection>;
+
+	// Numbers the connections it makes to each host
+	struct fake_connector {
+		std::map<std::wstring, int> connects;
+
+		connection_t operator( )( boost::wstring_ref host ) {
+			auto const key = host.to_string( );
+			return std::make_shared<fake_connection>( fake_connection { key, ++connects[key], false } );
+		}
+	};	// struct fake_connector
+
+	std::runtime_error const stale_error( "The RPC server is unavailable." );
+}	// namespace anonymous
+
+BOOST_AUTO_TEST_CASE( get_reuses_a_kept_connection ) {
+	daw::wmi::connection_cache<connection_t> cache;
+	fake_connector connector;
+	bool reused = true;
+	auto const first = cache.get( L"alpha", std::ref( connector ), reused );
+	BOOST_CHECK( !reused );
+	auto const second = cache.get( L"alpha", std::ref( connector ), reused );
+	BOOST_CHECK( reused );
+	BOOST_CHECK( first == second );
+	BOOST_CHECK_EQUAL( connector.connects[L"alpha"], 1 );
+	BOOST_CHECK_EQUAL( cache.size( ), 1u );
+}
+
+BOOST_AUTO_TEST_CASE( least_recently_used_is_evicted ) {
+	daw::wmi::connection_cache<connection_t> cache( 2 );
+	fake_connector connector;
+	bool reused = false;
+	cache.get( L"alpha", std::ref( connector ), reused );
+	cache.get( L"bravo", std::ref( connector ), reused );
+	cache.get( L"alpha", std::ref( connector ), reused );	// bravo is now the oldest
+	cache.get( L"charlie", std::ref( connector ), reused );
+	BOOST_CHECK_EQUAL( cache.size( ), 2u );
+
+	cache.get( L"alpha", std::ref( connector ), reused );
+	BOOST_CHECK( reused );
+	cache.get( L"charlie", std::ref( connector ), reused );
+	BOOST_CHECK( reused );
+	auto const bravo = cache.get( L"bravo", std::ref( connector ), reused );
+	BOOST_CHECK( !reused );
+	BOOST_CHECK_EQUAL( bravo->number, 2 );
+	// Making room for bravo dropped alpha, used before charlie
+	cache.get( L"charlie", std::ref( connector ), reused );
+	BOOST_CHECK( reused );
+	cache.get( L"alpha", std::ref( connector ), reused );
+	BOOST_CHECK( !reused );
+	BOOST_CHECK_EQUAL( cache.size( ), 2u );
+}
+
+BOOST_AUTO_TEST_CASE( keeps_at_least_one ) {
+	daw::wmi::connection_cache<connection_t> cache( 0 );
+	fake_connector connector;
+	bool reused = false;
+	cache.get( L"alpha", std::ref( connector ), reused );
+	cache.get( L"alpha", std::ref( connector ), reused );
+	BOOST_CHECK( reused );
+	cache.get( L"bravo", std::ref( connector ), reused );
+	BOOST_CHECK_EQUAL( cache.size( ), 1u );
+}
+
+BOOST_AUTO_TEST_CASE( remove_and_clear ) {
+	daw::wmi::connection_cache<connection_t> cache;
+	fake_connector connector;
+	bool reused = false;
+	cache.get( L"alpha", std::ref( connector ), reused );
+	cache.get( L"bravo", std::ref( connector ), reused );
+	cache.remove( L"alpha" );
+	cache.remove( L"not kept" );
+	BOOST_CHECK_EQUAL( cache.size( ), 1u );
+	cache.get( L"alpha", std::ref( connector ), reused );
+	BOOST_CHECK( !reused );
+	cache.clear( );
+	BOOST_CHECK_EQUAL( cache.size( ), 0u );
+}
+
+BOOST_AUTO_TEST_CASE( use_retries_a_stale_connection_once ) {
+	daw::wmi::connection_cache<connection_t> cache;
+	fake_connector connector;
+	bool reused = false;
+	cache.get( L"alpha", std::ref( connector ), reused )->stale = true;
+
+	int uses = 0;
+	auto const result = cache.use( L"alpha", std::ref( connector ), [&uses]( connection_t & connection ) {
+		++uses;
+		if( connection->stale ) {
+			throw stale_error;
+		}
+		return connection->number;
+	} );
+	BOOST_CHECK_EQUAL( uses, 2 );
+	BOOST_CHECK_EQUAL( result, 2 );
+	BOOST_CHECK_EQUAL( connector.connects[L"alpha"], 2 );
+	// The new connection is the one kept
+	BOOST_CHECK_EQUAL( cache.get( L"alpha", std::ref( connector ), reused )->number, 2 );
+	BOOST_CHECK( reused );
+}
+
+BOOST_AUTO_TEST_CASE( use_gives_up_after_the_retry ) {
+	daw::wmi::connection_cache<connection_t> cache;
+	fake_connector connector;
+	bool reused = false;
+	cache.get( L"alpha", std::ref( connector ), reused );
+
+	int uses = 0;
+	BOOST_CHECK_THROW( cache.use( L"alpha", std::ref( connector ), [&uses]( connection_t & ) -> int {
+		++uses;
+		throw stale_error;
+	} ), std::runtime_error );
+	BOOST_CHECK_EQUAL( uses, 2 );
+	BOOST_CHECK_EQUAL( connector.connects[L"alpha"], 2 );
+	BOOST_CHECK_EQUAL( cache.size( ), 0u );
+}
+
+BOOST_AUTO_TEST_CASE( use_does_not_retry_a_new_connection ) {
+	daw::wmi::connection_cache<connection_t> cache;
+	fake_connector connector;
+	int uses = 0;
+	BOOST_CHECK_THROW( cache.use( L"alpha", std::ref( connector ), [&uses]( connection_t & ) -> int {
+		++uses;
+		throw stale_error;
+	} ), std::runtime_error );
+	BOOST_CHECK_EQUAL( uses, 1 );
+	BOOST_CHECK_EQUAL( connector.connects[L"alpha"], 1 );
+	BOOST_CHECK_EQUAL( cache.size( ), 0u );
+}
+
+BOOST_AUTO_TEST_CASE( connect_errors_are_not_kept ) {
+	daw::wmi::connection_cache<connection_t> cache;
+	int connects = 0;
+	auto const failing_connect = [&connects]( boost::wstring_ref ) -> connection_t {
+		++connects;
+		throw std::runtime_error( "Access is denied." );
+	};
+	BOOST_CHECK_THROW( cache.use( L"alpha", failing_connect, []( connection_t & ) {
+		return 0;
+	} ), std::runtime_error );
+	BOOST_CHECK_EQUAL( connects, 1 );
+	BOOST_CHECK_EQUAL( cache.size( ), 0u );
+}
+
+BOOST_AUTO_TEST_CASE( concurrent_gets_keep_one_per_host ) {
+	daw::wmi::connection_cache<connection_t> cache( 4 );
+	std::atomic<int> connects( 0 );
+	// Boost.Test checks are not thread safe
+	std::atomic<bool> wrong_host( false );
+	std::vector<std::thread> threads;
+	for( int t = 0; t < 8; ++t ) {
+		threads.emplace_back( [&cache, &connects, &wrong_host, t]( ) {
+			for( int n = 0; n < 200; ++n ) {
+				auto const host = std::wstring( L"host" ) + std::to_wstring( (n + t) % 6 );
+				bool reused = false;
+				auto const connection = cache.get( host, [&connects]( boost::wstring_ref name ) {
+					++connects;
+					return std::make_shared<fake_connection>( fake_connection { name.to_string( ), 0, false } );
+				}, reused );
+				if( host != connection->host ) {
+					wrong_host = true;
+				}
+			}
+		} );
+	}
+	for( auto & thread : threads ) {
+		thread.join( );
+	}
+	BOOST_CHECK( !wrong_host );
+	BOOST_CHECK_EQUAL( cache.size( ), 4u );
+	BOOST_CHECK( connects.load( ) >= 6 );
+}
@@ -0,0 +1,80 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "current_users.h"
+
+namespace daw {
+	namespace wmi {
+		size_t current_users::user_key_hash::operator( )( user_key const & key ) const {
+			auto value = (static_cast<uint64_t>(key.computer_name) << 32 | static_cast<uint64_t>(key.user_name)) * 0x9E3779B97F4A7C15ULL;
+			return static_cast<size_t>(value ^ (value >> 29));
+		}
+
+		int const current_users::boot_event_code;
+
+		current_users::current_users( int64_t const cutoff ): m_cutoff( cutoff ), m_latest( ), m_booted( ) { }
+
+		bool current_users::add( result_row const & row ) {
+			if( row.timestamp < m_cutoff ) {
+				return false;
+			}
+			if( boot_event_code == row.event_code ) {
+				// Everyone on before the boot was logged off by it
+				m_booted.insert( row.computer_name );
+				return false;
+			}
+			if( 0 != m_booted.count( row.computer_name ) ) {
+				return false;
+			}
+			// Rows come newest first so the first one seen for a user is current
+			m_latest.emplace( user_key { row.computer_name, row.user_name }, row );
+			return true;
+		}
+
+		void current_users::merge( current_users const & other ) {
+			for( auto const & latest : other.m_latest ) {
+				auto position = m_latest.find( latest.first );
+				if( m_latest.end( ) == position ) {
+					m_latest.insert( latest );
+				} else if( position->second.timestamp < latest.second.timestamp ) {
+					position->second = latest.second;
+				}
+			}
+			m_booted.insert( other.m_booted.begin( ), other.m_booted.end( ) );
+		}
+
+		std::vector<result_row> current_users::logged_on( ) const {
+			std::vector<result_row> result;
+			for( auto const & latest : m_latest ) {
+				if( 4624 == latest.second.event_code ) {
+					result.push_back( latest.second );
+				}
+			}
+			return result;
+		}
+
+		size_t current_users::size( ) const {
+			return m_latest.size( );
+		}
+	}	// namespace wmi
+}	// namespace daw
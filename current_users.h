@@ -0,0 +1,94 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "result_row.h"
+#include "string_pool.h"
+
+namespace daw {
+	namespace wmi {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Who is logged on now, from events read newest first.
+		///				Only the newest 4624 logon or 4647 logoff of each user
+		///				on each computer is kept, so memory grows with the
+		///				users rather than the events.  Events before cutoff,
+		///				or before the last 4608 boot of their computer, can
+		///				not change the answer and are ignored.
+		//////////////////////////////////////////////////////////////////////////
+		class current_users {
+			struct user_key {
+				string_pool::id_t computer_name;
+				string_pool::id_t user_name;
+
+				bool operator==( user_key const & rhs ) const {
+					return computer_name == rhs.computer_name && user_name == rhs.user_name;
+				}
+			};	// struct user_key
+
+			struct user_key_hash {
+				size_t operator( )( user_key const & key ) const;
+			};	// struct user_key_hash
+
+			int64_t m_cutoff;
+			std::unordered_map<user_key, result_row, user_key_hash> m_latest;
+			std::unordered_set<string_pool::id_t> m_booted;
+
+		public:
+			/// Summary: Boot events, Windows is starting up
+			static int const boot_event_code = 4608;
+
+			explicit current_users( int64_t const cutoff = (std::numeric_limits<int64_t>::min)( ) );
+			~current_users( ) = default;
+			current_users( current_users const & ) = default;
+			current_users & operator=( current_users const & ) = default;
+			current_users( current_users && ) = default;
+			current_users & operator=( current_users && ) = default;
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Add the next row, no newer than those before it
+			///				from its computer.  Returns false when the row is
+			///				before cutoff or is a boot, after which nothing
+			///				older from that computer matters and a source
+			///				holding only its events can stop being read.
+			//////////////////////////////////////////////////////////////////////////
+			bool add( result_row const & row );
+
+			/// Summary: Fold in the users of another computer's tracker
+			void merge( current_users const & other );
+
+			/// Summary: The logon of each user whose newest event is a logon
+			std::vector<result_row> logged_on( ) const;
+
+			/// Summary: Number of users tracked
+			size_t size( ) const;
+		};	// class current_users
+	}	// namespace wmi
+}	// namespace daw
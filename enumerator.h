@@ -0,0 +1,119 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <future>
+#include <utility>
+#include <vector>
+
+#include "run_stats.h"
+
+namespace daw {
+	namespace wmi {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	A source of objects that is read a batch at a time.
+		///				next_batch replaces the contents of out_values with up
+		///				to max_count objects and returns false once the source
+		///				is exhausted.  The final batch may be empty.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename T>
+		struct object_enumerator {
+			virtual ~object_enumerator( ) = default;
+			virtual bool next_batch( std::vector<T> & out_values, size_t max_count ) = 0;
+		};	// struct object_enumerator
+
+		/// Summary: Objects requested per next_batch unless the caller says otherwise
+		size_t const default_batch_size = 256;
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Hands out objects one at a time from an object_enumerator
+		///				while the following batch is being fetched on another
+		///				thread.  Only one request is ever outstanding against
+		///				the source.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename T>
+		class prefetching_enumerator {
+			struct batch_t {
+				std::vector<T> values;
+				bool has_more;
+			};
+
+			object_enumerator<T> & m_source;
+			size_t m_batch_size;
+			std::vector<T> m_current;
+			size_t m_position;
+			std::future<batch_t> m_pending;
+
+			void request_batch( ) {
+				m_pending = std::async( std::launch::async, [this]( ) {
+					batch_t result;
+					phase_timer const timer( run_phase::enumerate );
+					result.has_more = m_source.next_batch( result.values, m_batch_size );
+					return result;
+				} );
+			}
+
+		public:
+			prefetching_enumerator( object_enumerator<T> & source, size_t const batch_size ): m_source( source ), m_batch_size( batch_size ), m_current( ), m_position( 0 ), m_pending( ) {
+				assert( batch_size > 0 );
+				request_batch( );
+			}
+
+			~prefetching_enumerator( ) {
+				// Cannot leave the worker referencing a dead source
+				if( m_pending.valid( ) ) {
+					m_pending.wait( );
+				}
+			}
+
+			prefetching_enumerator( prefetching_enumerator const & ) = delete;
+			prefetching_enumerator & operator=( prefetching_enumerator const & ) = delete;
+			prefetching_enumerator( prefetching_enumerator && ) = delete;
+			prefetching_enumerator & operator=( prefetching_enumerator && ) = delete;
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Move the next object into out_value.  Returns false
+			///				when the source is exhausted.  Errors from the source
+			///				are rethrown here.
+			//////////////////////////////////////////////////////////////////////////
+			bool next( T & out_value ) {
+				while( m_position >= m_current.size( ) ) {
+					if( !m_pending.valid( ) ) {
+						return false;
+					}
+					auto batch = m_pending.get( );
+					m_current = std::move( batch.values );
+					m_position = 0;
+					if( batch.has_more ) {
+						request_batch( );
+					}
+				}
+				out_value = std::move( m_current[m_position++] );
+				return true;
+			}
+		};	// class prefetching_enumerator
+	}	// namespace wmi
+}	// namespace daw
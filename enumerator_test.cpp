@@ -0,0 +1,120 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Unit tests of prefetching_enumerator over a synthetic source
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE enumerator
+#include <boost/test/unit_test.hpp>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "enumerator.h"
+#include "test_enumerator.h"
+
+namespace {
+	std::vector<int> read_all( daw::wmi::prefetching_enumerator<int> & objects ) {
+		std::vector<int> result;
+		int value = 0;
+		while( objects.next( value ) ) {
+			result.push_back( value );
+		}
+		return result;
+	}
+
+	std::vector<int> numbers( int const count ) {
+		std::vector<int> result;
+		for( int n = 0; n < count; ++n ) {
+			result.push_back( n );
+		}
+		return result;
+	}
+}	// namespace anonymous
+
+BOOST_AUTO_TEST_CASE( batches_in_order ) {
+	for( auto const empty_last_batch : { true, false } ) {
+		daw::wmi::counting_enumerator source( 50, empty_last_batch );
+		{
+			daw::wmi::prefetching_enumerator<int> objects( source, 7 );
+			BOOST_CHECK( read_all( objects ) == numbers( 50 ) );
+		}
+		// Seven full batches, a last one of 1 and, with empty_last_batch, the empty batch ending it
+		BOOST_CHECK_EQUAL( source.batches( ), empty_last_batch ? 9u : 8u );
+		BOOST_CHECK( !source.overlapped( ) );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( batch_of_one ) {
+	daw::wmi::counting_enumerator source( 5, false );
+	daw::wmi::prefetching_enumerator<int> objects( source, 1 );
+	BOOST_CHECK( read_all( objects ) == numbers( 5 ) );
+	BOOST_CHECK_EQUAL( source.batches( ), 5u );
+}
+
+BOOST_AUTO_TEST_CASE( end_of_input ) {
+	daw::wmi::counting_enumerator source( 3 );
+	daw::wmi::prefetching_enumerator<int> objects( source, 256 );
+	BOOST_CHECK( read_all( objects ) == numbers( 3 ) );
+	int value = -1;
+	BOOST_CHECK( !objects.next( value ) );
+	BOOST_CHECK( !objects.next( value ) );
+	BOOST_CHECK_EQUAL( value, -1 );
+	BOOST_CHECK_EQUAL( source.batches( ), 2u );
+}
+
+BOOST_AUTO_TEST_CASE( empty_source ) {
+	daw::wmi::counting_enumerator source( 0 );
+	daw::wmi::prefetching_enumerator<int> objects( source, 16 );
+	int value = 0;
+	BOOST_CHECK( !objects.next( value ) );
+	BOOST_CHECK_EQUAL( source.batches( ), 1u );
+}
+
+BOOST_AUTO_TEST_CASE( prefetches_the_next_batch ) {
+	daw::wmi::counting_enumerator source( 100 );
+	daw::wmi::prefetching_enumerator<int> objects( source, 10 );
+	int value = 0;
+	BOOST_REQUIRE( objects.next( value ) );
+	BOOST_CHECK_EQUAL( value, 0 );
+	// The second batch is asked for as the first is handed over, while
+	// the rest of the first is still unread, and no more than that
+	auto const give_up = std::chrono::steady_clock::now( ) + std::chrono::seconds( 10 );
+	while( source.batches( ) < 2 && std::chrono::steady_clock::now( ) < give_up ) {
+		std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+	}
+	std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+	BOOST_CHECK_EQUAL( source.batches( ), 2u );
+}
+
+BOOST_AUTO_TEST_CASE( source_error_is_rethrown ) {
+	daw::wmi::counting_enumerator source( 100, true, 2 );
+	daw::wmi::prefetching_enumerator<int> objects( source, 10 );
+	int value = 0;
+	for( int n = 0; n < 20; ++n ) {
+		BOOST_REQUIRE( objects.next( value ) );
+		BOOST_CHECK_EQUAL( value, n );
+	}
+	BOOST_CHECK_THROW( objects.next( value ), std::runtime_error );
+	BOOST_CHECK_EQUAL( source.batches( ), 3u );
+}
@@ -0,0 +1,117 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+#include "row_disposition.h"
+
+namespace daw {
+	namespace wmi {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	A source of events that arrive over time
+		//////////////////////////////////////////////////////////////////////////
+		template<typename T>
+		struct event_source {
+			virtual ~event_source( ) = default;
+
+			/// Summary: Block until an event arrives.  Returns false once the source is closed
+			virtual bool wait_next( T & out_value ) = 0;
+		};	// struct event_source
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Event source fed by other threads.  Events pushed before
+		///				close are still delivered.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename T>
+		class blocking_queue: public event_source<T> {
+			std::mutex m_mutex;
+			std::condition_variable m_not_empty;
+			std::deque<T> m_values;
+			bool m_closed;
+
+		public:
+			blocking_queue( ): m_mutex( ), m_not_empty( ), m_values( ), m_closed( false ) { }
+			~blocking_queue( ) = default;
+			blocking_queue( blocking_queue const & ) = delete;
+			blocking_queue & operator=( blocking_queue const & ) = delete;
+
+			/// Summary: Returns false and drops value if the queue is closed
+			bool push( T value ) {
+				{
+					std::lock_guard<std::mutex> lock( m_mutex );
+					if( m_closed ) {
+						return false;
+					}
+					m_values.push_back( std::move( value ) );
+				}
+				m_not_empty.notify_one( );
+				return true;
+			}
+
+			void close( ) {
+				{
+					std::lock_guard<std::mutex> lock( m_mutex );
+					m_closed = true;
+				}
+				m_not_empty.notify_all( );
+			}
+
+			bool wait_next( T & out_value ) override {
+				std::unique_lock<std::mutex> lock( m_mutex );
+				m_not_empty.wait( lock, [this]( ) {
+					return m_closed || !m_values.empty( );
+				} );
+				if( m_values.empty( ) ) {
+					return false;
+				}
+				out_value = std::move( m_values.front( ) );
+				m_values.pop_front( );
+				return true;
+			}
+		};	// class blocking_queue
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Run callback on each event as it arrives and pass emitted
+		///				rows to output.  The callback follows the wmi_query
+		///				contract and returns a row_result<T> (or a T, throwing
+		///				to skip or stop).  Stopping ends the follow.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename T, typename Event, typename Callback, typename Output>
+		void follow_events( event_source<Event> & source, Callback callback, Output output ) {
+			Event current_event;
+			while( source.wait_next( current_event ) ) {
+				auto result = impl::invoke_row_callback<T>( callback, std::move( current_event ) );
+				if( row_action::stop == result.action( ) ) {
+					break;
+				} else if( row_action::emit == result.action( ) ) {
+					output( result.value( ) );
+				}
+			}
+		}
+	}	// namespace wmi
+}	// namespace daw
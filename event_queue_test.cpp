@@ -0,0 +1,146 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Unit tests of follow_events and blocking_queue with injected events
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE event_queue
+#include <boost/test/unit_test.hpp>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "event_queue.h"
+#include "row_disposition.h"
+
+namespace {
+	// Hands out a fixed list of events then reports the source closed
+	class scripted_source: public daw::wmi::event_source<int> {
+		std::vector<int> m_events;
+		size_t m_position;
+
+	public:
+		explicit scripted_source( std::vector<int> events ): m_events( std::move( events ) ), m_position( 0 ) { }
+
+		bool wait_next( int & out_value ) override {
+			if( m_position >= m_events.size( ) ) {
+				return false;
+			}
+			out_value = m_events[m_position++];
+			return true;
+		}
+
+		size_t delivered( ) const {
+			return m_position;
+		}
+	};	// class scripted_source
+
+	// Emits the even events, ten times over, and skips the rest
+	daw::wmi::row_result<int> keep_even( int const event ) {
+		if( 0 != event % 2 ) {
+			return daw::wmi::row_result<int>::skip( );
+		}
+		return event * 10;
+	}
+}	// namespace anonymous
+
+BOOST_AUTO_TEST_CASE( dispatches_each_event ) {
+	scripted_source source( { 1, 2, 3, 4, 6, 7, 8 } );
+	std::vector<int> output;
+	daw::wmi::follow_events<int>( source, keep_even, [&output]( int const row ) {
+		output.push_back( row );
+	} );
+	BOOST_CHECK( output == (std::vector<int> { 20, 40, 60, 80 }) );
+	BOOST_CHECK_EQUAL( source.delivered( ), 7u );
+}
+
+BOOST_AUTO_TEST_CASE( stop_ends_the_follow ) {
+	scripted_source source( { 2, 4, -1, 6, 8 } );
+	std::vector<int> output;
+	daw::wmi::follow_events<int>( source, []( int const event ) {
+		if( event < 0 ) {
+			return daw::wmi::row_result<int>::stop( );
+		}
+		return keep_even( event );
+	}, [&output]( int const row ) {
+		output.push_back( row );
+	} );
+	BOOST_CHECK( output == (std::vector<int> { 20, 40 }) );
+	BOOST_CHECK_EQUAL( source.delivered( ), 3u );
+}
+
+BOOST_AUTO_TEST_CASE( throwing_callbacks ) {
+	scripted_source source( { 1, 2, 3, 4, 5, 6 } );
+	std::vector<int> output;
+	daw::wmi::follow_events<int>( source, []( int const event ) -> int {
+		if( 5 == event ) {
+			throw daw::wmi::StopProcessingException( );
+		} else if( 0 != event % 2 ) {
+			throw daw::wmi::SkipRowException( );
+		}
+		return event;
+	}, [&output]( int const row ) {
+		output.push_back( row );
+	} );
+	BOOST_CHECK( output == (std::vector<int> { 2, 4 }) );
+}
+
+BOOST_AUTO_TEST_CASE( queue_delivers_events_pushed_before_close ) {
+	daw::wmi::blocking_queue<int> queue;
+	std::thread producer( [&queue]( ) {
+		for( int n = 0; n < 1000; ++n ) {
+			queue.push( n );
+		}
+		queue.close( );
+	} );
+	std::vector<int> output;
+	daw::wmi::follow_events<int>( queue, keep_even, [&output]( int const row ) {
+		output.push_back( row );
+	} );
+	producer.join( );
+	BOOST_REQUIRE_EQUAL( output.size( ), 500u );
+	for( size_t n = 0; n < output.size( ); ++n ) {
+		BOOST_REQUIRE_EQUAL( output[n], static_cast<int>( n ) * 20 );
+	}
+	BOOST_CHECK( !queue.push( 1000 ) );
+	int value = 0;
+	BOOST_CHECK( !queue.wait_next( value ) );
+}
+
+BOOST_AUTO_TEST_CASE( close_wakes_a_waiting_follow ) {
+	daw::wmi::blocking_queue<int> queue;
+	std::vector<int> output;
+	auto follow = std::async( std::launch::async, [&]( ) {
+		daw::wmi::follow_events<int>( queue, keep_even, [&output]( int const row ) {
+			output.push_back( row );
+		} );
+	} );
+	queue.push( 2 );
+	std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+	BOOST_CHECK( std::future_status::timeout == follow.wait_for( std::chrono::milliseconds( 0 ) ) );
+	// As Ctrl+C does
+	queue.close( );
+	BOOST_REQUIRE( std::future_status::ready == follow.wait_for( std::chrono::seconds( 10 ) ) );
+	follow.get( );
+	BOOST_CHECK( output == (std::vector<int> { 20 }) );
+}
@@ -0,0 +1,332 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "event_replay.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace daw {
+	namespace wmi {
+		namespace {
+			char const file_magic[8] = { 'W', 'I', 'O', 'E', 'V', 'T', 'S', '\0' };
+			uint32_t const file_version = 2;
+			uint32_t const oldest_file_version = 1;
+
+			template<typename T>
+			void append_value( std::vector<unsigned char> & out, T const value ) {
+				auto const first = reinterpret_cast<unsigned char const *>(&value);
+				out.insert( out.end( ), first, first + sizeof( T ) );
+			}
+
+			void append_utf16( std::vector<unsigned char> & out, boost::wstring_ref value ) {
+				auto const length_pos = out.size( );
+				append_value<uint32_t>( out, 0 );
+				uint32_t length = 0;
+				for( auto const c : value ) {
+					auto const code_point = static_cast<uint32_t>(c);
+					if( code_point > 0xFFFF ) {
+						append_value( out, static_cast<uint16_t>(0xD800 + ((code_point - 0x10000) >> 10)) );
+						append_value( out, static_cast<uint16_t>(0xDC00 + ((code_point - 0x10000) & 0x3FF)) );
+						length += 2;
+					} else {
+						append_value( out, static_cast<uint16_t>(code_point) );
+						++length;
+					}
+				}
+				std::memcpy( out.data( ) + length_pos, &length, sizeof( length ) );
+			}
+
+			class input_cursor {
+				unsigned char const * m_first;
+				unsigned char const * m_last;
+				std::string const * m_file_name;
+
+			public:
+				input_cursor( unsigned char const * first, unsigned char const * last, std::string const & file_name ): m_first( first ), m_last( last ), m_file_name( &file_name ) { }
+
+				[[noreturn]] void fail( char const * reason ) const {
+					throw std::runtime_error( "Invalid event recording " + *m_file_name + ": " + reason );
+				}
+
+				unsigned char const * position( ) const {
+					return m_first;
+				}
+
+				void need( size_t const size ) const {
+					if( static_cast<size_t>(m_last - m_first) < size ) {
+						fail( "truncated" );
+					}
+				}
+
+				template<typename T>
+				T read( ) {
+					need( sizeof( T ) );
+					T result;
+					std::memcpy( &result, m_first, sizeof( T ) );
+					m_first += sizeof( T );
+					return result;
+				}
+
+				void read_utf16( std::wstring & out ) {
+					auto const length = static_cast<size_t>(read<uint32_t>( ));
+					need( length * 2 );
+					out.clear( );
+					auto const last = m_first + length * 2;
+					while( m_first != last ) {
+						uint16_t unit;
+						std::memcpy( &unit, m_first, 2 );
+						m_first += 2;
+						uint32_t code_point = unit;
+						if( sizeof( wchar_t ) > 2 && code_point >= 0xD800 && code_point <= 0xDBFF && m_first != last ) {
+							std::memcpy( &unit, m_first, 2 );
+							if( unit >= 0xDC00 && unit <= 0xDFFF ) {
+								code_point = 0x10000 + ((code_point - 0xD800) << 10) + (static_cast<uint32_t>(unit) - 0xDC00);
+								m_first += 2;
+							}
+						}
+						out.push_back( static_cast<wchar_t>(code_point) );
+					}
+				}
+			};	// class input_cursor
+		}	// namespace anonymous
+
+		recorded_event::recorded_event( ): m_names( nullptr ), m_values( ) { }
+
+		recorded_event::recorded_event( property_names_t const & names ): m_names( &names ), m_values( names.size( ) ) { }
+
+		recorded_value const * recorded_event::find( boost::wstring_ref property_name ) const {
+			if( nullptr != m_names ) {
+				for( size_t n = 0; n < m_names->size( ); ++n ) {
+					if( property_name == (*m_names)[n] ) {
+						return &m_values[n];
+					}
+				}
+			}
+			return nullptr;
+		}
+
+		recorded_value * recorded_event::find( boost::wstring_ref property_name ) {
+			return const_cast<recorded_value *>(static_cast<recorded_event const &>(*this).find( property_name ));
+		}
+
+		std::vector<recorded_value> & recorded_event::values( ) {
+			return m_values;
+		}
+
+		std::vector<recorded_value> const & recorded_event::values( ) const {
+			return m_values;
+		}
+
+		bool recorded_event::operator( )( boost::wstring_ref property_name, std::wstring & out_value ) const {
+			auto const value = find( property_name );
+			if( nullptr == value || value_kind::text != value->kind ) {
+				return false;
+			}
+			out_value = value->text;
+			return true;
+		}
+
+		bool recorded_event::operator( )( boost::wstring_ref property_name, std::vector<std::wstring> & out_values ) const {
+			auto const value = find( property_name );
+			if( nullptr == value || value_kind::text_list != value->kind ) {
+				return false;
+			}
+			out_values = value->texts;
+			return true;
+		}
+
+		void recorded_event::set_text( boost::wstring_ref property_name, boost::wstring_ref value ) {
+			auto const result = find( property_name );
+			if( nullptr != result ) {
+				result->kind = value_kind::text;
+				result->text.assign( value.begin( ), value.end( ) );
+			}
+		}
+
+		void recorded_event::set_number( boost::wstring_ref property_name, int64_t const value ) {
+			auto const result = find( property_name );
+			if( nullptr != result ) {
+				result->kind = value_kind::number;
+				result->number = value;
+			}
+		}
+
+		void recorded_event::set_text_list( boost::wstring_ref property_name, std::vector<std::wstring> const & values ) {
+			auto const result = find( property_name );
+			if( nullptr != result ) {
+				result->kind = value_kind::text_list;
+				result->texts = values;
+			}
+		}
+
+		event_recorder::event_recorder( std::string const & file_name, recorded_event::property_names_t names ):
+				m_mutex( ),
+				m_file( std::fopen( file_name.c_str( ), "wb" ) ),
+				m_names( std::move( names ) ),
+				m_buffer( ) {
+
+			if( nullptr == m_file ) {
+				throw std::runtime_error( "Could not create event recording " + file_name );
+			}
+			m_buffer.reserve( 64 * 1024 );
+			m_buffer.insert( m_buffer.end( ), file_magic, file_magic + sizeof( file_magic ) );
+			append_value( m_buffer, file_version );
+			append_value( m_buffer, static_cast<uint32_t>(m_names.size( )) );
+			for( auto const & name : m_names ) {
+				append_utf16( m_buffer, name );
+			}
+			write_buffer( );
+		}
+
+		event_recorder::~event_recorder( ) {
+			if( nullptr != m_file ) {
+				std::fclose( m_file );
+			}
+		}
+
+		void event_recorder::write_buffer( ) {
+			if( nullptr == m_file ) {
+				throw std::runtime_error( "Event recording is closed" );
+			}
+			if( std::fwrite( m_buffer.data( ), 1, m_buffer.size( ), m_file ) != m_buffer.size( ) ) {
+				throw std::runtime_error( "Error writing event recording" );
+			}
+			m_buffer.clear( );
+		}
+
+		recorded_event::property_names_t const & event_recorder::property_names( ) const {
+			return m_names;
+		}
+
+		void event_recorder::write( recorded_event const & event ) {
+			std::lock_guard<std::mutex> lock( m_mutex );
+			for( auto const & value : event.values( ) ) {
+				switch( value.kind ) {
+				case value_kind::number:
+					m_buffer.push_back( 'i' );
+					append_value( m_buffer, value.number );
+					break;
+				case value_kind::text:
+					m_buffer.push_back( 's' );
+					append_utf16( m_buffer, value.text );
+					break;
+				case value_kind::text_list:
+					m_buffer.push_back( 'l' );
+					append_value( m_buffer, static_cast<uint32_t>(value.texts.size( )) );
+					for( auto const & text : value.texts ) {
+						append_utf16( m_buffer, text );
+					}
+					break;
+				default:
+					m_buffer.push_back( 'n' );
+					break;
+				}
+			}
+			// Events are small so write a block of them at a time
+			if( m_buffer.size( ) >= 64 * 1024 ) {
+				write_buffer( );
+			}
+		}
+
+		void event_recorder::close( ) {
+			std::lock_guard<std::mutex> lock( m_mutex );
+			write_buffer( );
+			auto const result = std::fclose( m_file );
+			m_file = nullptr;
+			if( 0 != result ) {
+				throw std::runtime_error( "Error writing event recording" );
+			}
+		}
+
+		event_replay::event_replay( std::string const & file_name ): m_file( ), m_file_name( file_name ), m_names( ), m_position( 0 ) {
+			try {
+				m_file.open( file_name );
+			} catch( std::exception const & ) {
+				throw std::runtime_error( "Could not open event recording " + file_name );
+			}
+			auto const data = reinterpret_cast<unsigned char const *>(m_file.data( ));
+			input_cursor cursor( data, data + m_file.size( ), m_file_name );
+			cursor.need( sizeof( file_magic ) );
+			if( 0 != std::memcmp( data, file_magic, sizeof( file_magic ) ) ) {
+				cursor.fail( "not an event recording" );
+			}
+			cursor = input_cursor( data + sizeof( file_magic ), data + m_file.size( ), m_file_name );
+			// Later versions only add tags, so older files read the same way
+			auto const version = cursor.read<uint32_t>( );
+			if( version < oldest_file_version || version > file_version ) {
+				cursor.fail( "unsupported version" );
+			}
+			auto const count = cursor.read<uint32_t>( );
+			for( uint32_t n = 0; n < count; ++n ) {
+				std::wstring name;
+				cursor.read_utf16( name );
+				m_names.push_back( std::move( name ) );
+			}
+			m_position = static_cast<size_t>(cursor.position( ) - data);
+		}
+
+		recorded_event::property_names_t const & event_replay::property_names( ) const {
+			return m_names;
+		}
+
+		bool event_replay::next_batch( std::vector<recorded_event> & out_values, size_t const max_count ) {
+			auto const data = reinterpret_cast<unsigned char const *>(m_file.data( ));
+			auto const size = m_file.size( );
+			out_values.clear( );
+			while( out_values.size( ) < max_count && m_position < size ) {
+				input_cursor cursor( data + m_position, data + size, m_file_name );
+				out_values.emplace_back( m_names );
+				for( auto & value : out_values.back( ).values( ) ) {
+					switch( cursor.read<unsigned char>( ) ) {
+					case 'n':
+						value.kind = value_kind::missing;
+						break;
+					case 'i':
+						value.kind = value_kind::number;
+						value.number = cursor.read<int64_t>( );
+						break;
+					case 's':
+						value.kind = value_kind::text;
+						cursor.read_utf16( value.text );
+						break;
+					case 'l': {
+						value.kind = value_kind::text_list;
+						auto const count = cursor.read<uint32_t>( );
+						// Each string takes at least its length
+						cursor.need( static_cast<size_t>(count) * sizeof( uint32_t ) );
+						value.texts.resize( count );
+						for( auto & text : value.texts ) {
+							cursor.read_utf16( text );
+						}
+						break;
+					}
+					default:
+						cursor.fail( "bad value" );
+					}
+				}
+				m_position = static_cast<size_t>(cursor.position( ) - data);
+			}
+			return m_position < size;
+		}
+	}	// namespace wmi
+}	// namespace daw
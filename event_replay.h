@@ -0,0 +1,193 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "enumerator.h"
+
+namespace daw {
+	namespace wmi {
+		enum class value_kind: unsigned char { missing, number, text, text_list };
+
+		struct recorded_value {
+			value_kind kind = value_kind::missing;
+			int64_t number = 0;
+			std::wstring text;
+			std::vector<std::wstring> texts;
+		};	// struct recorded_value
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	The properties of one recorded WMI object.  It is read
+		///				by row callbacks the same way as an IWbemWrapper;
+		///				properties that were not recorded are not found.
+		//////////////////////////////////////////////////////////////////////////
+		class recorded_event {
+		public:
+			using property_names_t = std::vector<std::wstring>;
+		private:
+			property_names_t const * m_names;
+			std::vector<recorded_value> m_values;
+
+			recorded_value const * find( boost::wstring_ref property_name ) const;
+			recorded_value * find( boost::wstring_ref property_name );
+
+		public:
+			recorded_event( );
+			explicit recorded_event( property_names_t const & names );
+			~recorded_event( ) = default;
+			recorded_event( recorded_event const & ) = default;
+			recorded_event & operator=( recorded_event const & ) = default;
+			recorded_event( recorded_event && ) = default;
+			recorded_event & operator=( recorded_event && ) = default;
+
+			/// Summary: One value per property name, in the same order
+			std::vector<recorded_value> & values( );
+			std::vector<recorded_value> const & values( ) const;
+
+			bool operator( )( boost::wstring_ref property_name, std::wstring & out_value ) const;
+			bool operator( )( boost::wstring_ref property_name, std::vector<std::wstring> & out_values ) const;
+
+			template<typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+			bool operator( )( boost::wstring_ref property_name, T & out_value ) const {
+				auto const value = find( property_name );
+				if( nullptr == value || value_kind::number != value->kind ) {
+					return false;
+				}
+				out_value = static_cast<T>(value->number);
+				return true;
+			}
+
+			/// Summary: Names that are not one of the recorded properties are ignored
+			void set_text( boost::wstring_ref property_name, boost::wstring_ref value );
+			void set_number( boost::wstring_ref property_name, int64_t value );
+			void set_text_list( boost::wstring_ref property_name, std::vector<std::wstring> const & values );
+		};	// class recorded_event
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	A record that passes each property read through to row
+		///				and copies the values found into event
+		//////////////////////////////////////////////////////////////////////////
+		template<typename Row>
+		class recording_row {
+			Row m_row;
+			recorded_event * m_event;
+
+		public:
+			recording_row( Row row, recorded_event & event ): m_row( std::move( row ) ), m_event( &event ) { }
+
+			bool operator( )( boost::wstring_ref property_name, std::wstring & out_value ) {
+				if( !m_row( property_name, out_value ) ) {
+					return false;
+				}
+				m_event->set_text( property_name, out_value );
+				return true;
+			}
+
+			bool operator( )( boost::wstring_ref property_name, std::vector<std::wstring> & out_values ) {
+				if( !m_row( property_name, out_values ) ) {
+					return false;
+				}
+				m_event->set_text_list( property_name, out_values );
+				return true;
+			}
+
+			template<typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+			bool operator( )( boost::wstring_ref property_name, T & out_value ) {
+				if( !m_row( property_name, out_value ) ) {
+					return false;
+				}
+				m_event->set_number( property_name, static_cast<int64_t>(out_value) );
+				return true;
+			}
+		};	// class recording_row
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Writes recorded events to a file for event_replay.
+		///				Values are little endian
+		///				header:		"WIOEVTS\0", uint32 version, uint32
+		///							properties, then each property name as
+		///							uint32 length and UTF-16 code units
+		///				events:		per property a tag, 'n' for not recorded,
+		///							'i' then int64, 's' then uint32 length
+		///							and UTF-16 code units or 'l' then uint32
+		///							count and that many strings as for 's'.
+		///							Version 1 files have no 'l'
+		///				write may be called from several threads at once.
+		//////////////////////////////////////////////////////////////////////////
+		class event_recorder {
+			std::mutex m_mutex;
+			std::FILE * m_file;
+			recorded_event::property_names_t m_names;
+			std::vector<unsigned char> m_buffer;
+
+			void write_buffer( );
+
+		public:
+			event_recorder( std::string const & file_name, recorded_event::property_names_t names );
+			~event_recorder( );
+			event_recorder( event_recorder const & ) = delete;
+			event_recorder & operator=( event_recorder const & ) = delete;
+
+			recorded_event::property_names_t const & property_names( ) const;
+
+			/// Summary: event must have been made from property_names( )
+			void write( recorded_event const & event );
+
+			/// Summary: Flush and close the file.  Throws std::runtime_error if anything could not be written
+			void close( );
+		};	// class event_recorder
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Serves the events of a file written by event_recorder
+		///				as fast as they can be decoded, so everything after
+		///				the WMI query can be run and timed without Windows.
+		///				Throws std::runtime_error if the file is not a
+		///				recording or is cut short.
+		//////////////////////////////////////////////////////////////////////////
+		class event_replay: public object_enumerator<recorded_event> {
+			boost::iostreams::mapped_file_source m_file;
+			std::string m_file_name;
+			recorded_event::property_names_t m_names;
+			size_t m_position;
+
+		public:
+			explicit event_replay( std::string const & file_name );
+			~event_replay( ) = default;
+			event_replay( event_replay const & ) = delete;
+			event_replay & operator=( event_replay const & ) = delete;
+
+			recorded_event::property_names_t const & property_names( ) const;
+
+			bool next_batch( std::vector<recorded_event> & out_values, size_t max_count ) override;
+		};	// class event_replay
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,543 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#include "evtx_reader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace daw {
+	namespace wmi {
+		namespace {
+			size_t const file_header_size = 4096;
+			size_t const chunk_header_size = 512;	// header, common string and template tables
+			size_t const record_header_size = 24;
+			uint32_t const record_signature = 0x00002a2a;
+			char const file_signature[8] = { 'E', 'l', 'f', 'F', 'i', 'l', 'e', '\0' };
+			char const chunk_signature[8] = { 'E', 'l', 'f', 'C', 'h', 'n', 'k', '\0' };
+
+			// Between 1601-01-01 and 1970-01-01
+			int64_t const filetime_epoch_offset = 11644473600LL * 1000000LL;
+
+			namespace token {
+				unsigned char const end_of_stream = 0x00;
+				unsigned char const open_start_element = 0x01;
+				unsigned char const close_start_element = 0x02;
+				unsigned char const close_empty_element = 0x03;
+				unsigned char const end_element = 0x04;
+				unsigned char const value = 0x05;
+				unsigned char const attribute = 0x06;
+				unsigned char const cdata_section = 0x07;
+				unsigned char const char_reference = 0x08;
+				unsigned char const entity_reference = 0x09;
+				unsigned char const pi_target = 0x0a;
+				unsigned char const pi_data = 0x0b;
+				unsigned char const template_instance = 0x0c;
+				unsigned char const normal_substitution = 0x0d;
+				unsigned char const optional_substitution = 0x0e;
+				unsigned char const fragment_header = 0x0f;
+				unsigned char const has_more = 0x40;	// more attributes or data follow
+			}	// namespace token
+
+			namespace value_type {
+				unsigned char const null = 0x00;
+				unsigned char const string = 0x01;
+				unsigned char const int8 = 0x03;
+				unsigned char const uint8 = 0x04;
+				unsigned char const int16 = 0x05;
+				unsigned char const uint16 = 0x06;
+				unsigned char const int32 = 0x07;
+				unsigned char const uint32 = 0x08;
+				unsigned char const int64 = 0x09;
+				unsigned char const uint64 = 0x0a;
+				unsigned char const filetime = 0x11;
+				unsigned char const sid = 0x13;
+				unsigned char const hex_int32 = 0x14;
+				unsigned char const hex_int64 = 0x15;
+			}	// namespace value_type
+
+			struct parse_error: public std::runtime_error {
+				parse_error( ): std::runtime_error( "Malformed binary XML" ) { }
+			};	// struct parse_error
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Bounds checked little endian reads within [pos, end)
+			///				of a chunk.  Positions are chunk offsets, which is
+			///				what binary XML uses to refer to names and templates
+			//////////////////////////////////////////////////////////////////////////
+			class chunk_cursor {
+				unsigned char const * m_chunk;
+				size_t m_pos;
+				size_t m_end;
+
+			public:
+				chunk_cursor( unsigned char const * chunk, size_t const pos, size_t const end ): m_chunk( chunk ), m_pos( pos ), m_end( end ) {
+					if( pos > end || end > evtx_chunk::chunk_size ) {
+						throw parse_error( );
+					}
+				}
+
+				size_t pos( ) const {
+					return m_pos;
+				}
+
+				bool at_end( ) const {
+					return m_pos == m_end;
+				}
+
+				void need( size_t const size ) const {
+					if( size > m_end - m_pos ) {
+						throw parse_error( );
+					}
+				}
+
+				unsigned char const * data( ) const {
+					return m_chunk + m_pos;
+				}
+
+				void skip( size_t const size ) {
+					need( size );
+					m_pos += size;
+				}
+
+				template<typename T>
+				T read( ) {
+					need( sizeof( T ) );
+					T result;
+					std::memcpy( &result, m_chunk + m_pos, sizeof( T ) );
+					m_pos += sizeof( T );
+					return result;
+				}
+			};	// class chunk_cursor
+
+			template<typename T>
+			T read_at( unsigned char const * chunk, size_t const offset ) {
+				if( offset > evtx_chunk::chunk_size || sizeof( T ) > evtx_chunk::chunk_size - offset ) {
+					throw parse_error( );
+				}
+				T result;
+				std::memcpy( &result, chunk + offset, sizeof( T ) );
+				return result;
+			}
+
+			// A name is referred to by its chunk offset and is stored in place
+			// the first time it is used: next offset, hash, character count,
+			// the UTF-16 characters and a terminator
+			uint32_t read_name( chunk_cursor & cursor ) {
+				auto const offset = cursor.read<uint32_t>( );
+				if( offset == cursor.pos( ) ) {
+					cursor.skip( 6 );
+					auto const length = cursor.read<uint16_t>( );
+					cursor.skip( (static_cast<size_t>(length) + 1) * 2 );
+				}
+				return offset;
+			}
+
+			bool name_is( unsigned char const * chunk, uint32_t const offset, char const * expected ) {
+				auto const length = read_at<uint16_t>( chunk, static_cast<size_t>(offset) + 6 );
+				auto pos = static_cast<size_t>(offset) + 8;
+				if( pos + static_cast<size_t>(length) * 2 > evtx_chunk::chunk_size || std::strlen( expected ) != length ) {
+					return false;
+				}
+				for( size_t n = 0; n < length; ++n, pos += 2 ) {
+					if( read_at<uint16_t>( chunk, pos ) != static_cast<unsigned char>(expected[n]) ) {
+						return false;
+					}
+				}
+				return true;
+			}
+
+			void assign_utf16( std::wstring & out, unsigned char const * first, size_t const size ) {
+				out.clear( );
+				auto const count = size / 2;
+				out.reserve( count );
+				for( size_t n = 0; n < count; ++n ) {
+					uint32_t code_point = static_cast<uint32_t>(first[2 * n]) | (static_cast<uint32_t>(first[2 * n + 1]) << 8);
+					if( sizeof( wchar_t ) > 2 && code_point >= 0xD800 && code_point <= 0xDBFF && n + 1 < count ) {
+						auto const low = static_cast<uint32_t>(first[2 * n + 2]) | (static_cast<uint32_t>(first[2 * n + 3]) << 8);
+						if( low >= 0xDC00 && low <= 0xDFFF ) {
+							code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+							++n;
+						}
+					}
+					out.push_back( static_cast<wchar_t>(code_point) );
+				}
+				// Substituted strings are often written with their terminator
+				while( !out.empty( ) && L'\0' == out.back( ) ) {
+					out.pop_back( );
+				}
+			}
+
+			boost::optional<uint64_t> read_integer( unsigned char const type, unsigned char const * data, size_t const size ) {
+				auto const read_sized = [&]( size_t const expected, bool const is_signed ) -> boost::optional<uint64_t> {
+					if( size < expected ) {
+						return boost::optional<uint64_t>( );
+					}
+					uint64_t result = 0;
+					for( size_t n = 0; n < expected; ++n ) {
+						result |= static_cast<uint64_t>(data[n]) << (8 * n);
+					}
+					if( is_signed && expected < 8 && 0 != (result >> (8 * expected - 1)) ) {
+						result |= ~uint64_t( 0 ) << (8 * expected);
+					}
+					return result;
+				};
+				switch( type ) {
+				case value_type::int8:
+					return read_sized( 1, true );
+				case value_type::uint8:
+					return read_sized( 1, false );
+				case value_type::int16:
+					return read_sized( 2, true );
+				case value_type::uint16:
+					return read_sized( 2, false );
+				case value_type::int32:
+					return read_sized( 4, true );
+				case value_type::uint32:
+				case value_type::hex_int32:
+					return read_sized( 4, false );
+				case value_type::int64:
+				case value_type::uint64:
+				case value_type::hex_int64:
+				case value_type::filetime:
+					return read_sized( 8, false );
+				default:
+					return boost::optional<uint64_t>( );
+				}
+			}
+
+			// S-revision-authority-subauthority...
+			void assign_sid( std::wstring & out, unsigned char const * data, size_t const size ) {
+				out.clear( );
+				if( size < 8 || size < 8 + 4 * static_cast<size_t>(data[1]) ) {
+					return;
+				}
+				uint64_t authority = 0;
+				for( size_t n = 2; n < 8; ++n ) {
+					authority = (authority << 8) | data[n];
+				}
+				out = L"S-" + std::to_wstring( data[0] ) + L"-" + std::to_wstring( authority );
+				for( size_t n = 0; n < data[1]; ++n ) {
+					auto const sub_authority = static_cast<uint32_t>(data[8 + 4 * n]) | (static_cast<uint32_t>(data[9 + 4 * n]) << 8) | (static_cast<uint32_t>(data[10 + 4 * n]) << 16) | (static_cast<uint32_t>(data[11 + 4 * n]) << 24);
+					out += L"-" + std::to_wstring( sub_authority );
+				}
+			}
+
+			// The Data elements of 4624 and 4647 events that rows are made from
+			evtx_chunk::field_t data_field( std::wstring const & name ) {
+				if( name == L"TargetUserSid" ) {
+					return evtx_chunk::target_user_sid_field;
+				} else if( name == L"TargetUserName" ) {
+					return evtx_chunk::target_user_name_field;
+				} else if( name == L"TargetDomainName" ) {
+					return evtx_chunk::target_domain_name_field;
+				} else if( name == L"TargetLogonId" ) {
+					return evtx_chunk::target_logon_id_field;
+				} else if( name == L"LogonType" ) {
+					return evtx_chunk::logon_type_field;
+				}
+				return evtx_chunk::field_count;
+			}
+		}	// namespace anonymous
+
+		size_t const evtx_chunk::chunk_size;
+
+		evtx_chunk::evtx_chunk( unsigned char const * data ): m_data( data ), m_next( chunk_header_size ), m_end( chunk_header_size ), m_skipped( 0 ), m_templates( ) {
+			if( 0 != std::memcmp( data, chunk_signature, sizeof( chunk_signature ) ) ) {
+				throw std::runtime_error( "Not an EVTX chunk" );
+			}
+			auto const free_space_offset = read_at<uint32_t>( data, 48 );
+			if( free_space_offset < chunk_header_size || free_space_offset > chunk_size ) {
+				throw std::runtime_error( "Invalid EVTX chunk header" );
+			}
+			m_end = free_space_offset;
+		}
+
+		evtx_chunk::template_plan const & evtx_chunk::find_template( uint32_t const offset ) {
+			auto pos = m_templates.find( offset );
+			if( m_templates.end( ) != pos ) {
+				return pos->second;
+			}
+
+			// Definition: next definition offset, GUID, body size and the body
+			auto const body_size = read_at<uint32_t>( m_data, static_cast<size_t>(offset) + 20 );
+			auto const body_start = static_cast<size_t>(offset) + 24;
+			if( body_size > chunk_size - body_start ) {
+				throw parse_error( );
+			}
+			chunk_cursor cursor( m_data, body_start, body_start + body_size );
+
+			template_plan plan;
+			plan.fill( -1 );
+			struct element_t {
+				uint32_t name;
+				field_t field;	// set for Data elements by their Name attribute
+			};
+			std::vector<element_t> elements;
+			uint32_t attribute_name = 0;
+			bool in_attributes = false;
+			std::wstring value;
+
+			auto const current_is = [&]( char const * name ) {
+				return !elements.empty( ) && name_is( m_data, elements.back( ).name, name );
+			};
+
+			while( !cursor.at_end( ) ) {
+				auto const current = cursor.read<unsigned char>( );
+				switch( current & ~token::has_more ) {
+				case token::end_of_stream:
+					cursor.skip( body_start + body_size - cursor.pos( ) );
+					break;
+				case token::fragment_header:
+					cursor.skip( 3 );
+					break;
+				case token::open_start_element: {
+					cursor.skip( 2 + 4 );	// dependency id and element size
+					auto const name = read_name( cursor );
+					if( 0 != (current & token::has_more) ) {
+						cursor.skip( 4 );	// attribute list size
+					}
+					elements.push_back( element_t{ name, field_count } );
+					in_attributes = false;
+					break;
+				}
+				case token::close_start_element:
+					in_attributes = false;
+					break;
+				case token::close_empty_element:
+				case token::end_element:
+					if( elements.empty( ) ) {
+						throw parse_error( );
+					}
+					elements.pop_back( );
+					in_attributes = false;
+					break;
+				case token::attribute:
+					attribute_name = read_name( cursor );
+					in_attributes = true;
+					break;
+				case token::value: {
+					if( value_type::string != cursor.read<unsigned char>( ) ) {
+						throw parse_error( );
+					}
+					auto const length = static_cast<size_t>(cursor.read<uint16_t>( ));
+					cursor.need( length * 2 );
+					if( in_attributes && current_is( "Data" ) && name_is( m_data, attribute_name, "Name" ) ) {
+						assign_utf16( value, cursor.data( ), length * 2 );
+						elements.back( ).field = data_field( value );
+					}
+					cursor.skip( length * 2 );
+					break;
+				}
+				case token::normal_substitution:
+				case token::optional_substitution: {
+					auto const index = cursor.read<uint16_t>( );
+					cursor.skip( 1 );	// value type, the instance says what it is
+					auto field = field_count;
+					if( in_attributes ) {
+						if( current_is( "TimeCreated" ) && name_is( m_data, attribute_name, "SystemTime" ) ) {
+							field = time_created_field;
+						}
+					} else if( current_is( "EventID" ) ) {
+						field = event_id_field;
+					} else if( current_is( "Computer" ) ) {
+						field = computer_field;
+					} else if( current_is( "Data" ) ) {
+						field = elements.back( ).field;
+					}
+					if( field_count != field && plan[field] < 0 ) {
+						plan[field] = index;
+					}
+					break;
+				}
+				case token::cdata_section:
+				case token::pi_data:
+					cursor.skip( static_cast<size_t>(cursor.read<uint16_t>( )) * 2 );
+					break;
+				case token::char_reference:
+					cursor.skip( 2 );
+					break;
+				case token::entity_reference:
+				case token::pi_target:
+					read_name( cursor );
+					break;
+				default:
+					throw parse_error( );
+				}
+			}
+			return m_templates.emplace( offset, plan ).first->second;
+		}
+
+		void evtx_chunk::read_record( size_t const offset, size_t const size, evtx_event & out ) {
+			out.record_id = read_at<uint64_t>( m_data, offset + 8 );
+			auto const written = static_cast<int64_t>(read_at<uint64_t>( m_data, offset + 16 ) / 10);
+			out.event_id = 0;
+			out.timestamp = written - filetime_epoch_offset;
+			out.computer.clear( );
+			out.target_user_sid.clear( );
+			out.target_user_name.clear( );
+			out.target_domain_name.clear( );
+			out.target_logon_id = 0;
+			out.logon_type = boost::none;
+
+			// The record is a fragment holding one template instance
+			chunk_cursor cursor( m_data, offset + record_header_size, offset + size - 4 );
+			if( token::fragment_header != cursor.read<unsigned char>( ) ) {
+				throw parse_error( );
+			}
+			cursor.skip( 3 );
+			if( token::template_instance != cursor.read<unsigned char>( ) ) {
+				throw parse_error( );
+			}
+			cursor.skip( 1 + 4 );	// unknown and template id
+			auto const definition = cursor.read<uint32_t>( );
+			if( definition == cursor.pos( ) ) {
+				// First use of the template in this chunk, its definition is here
+				cursor.skip( 20 );
+				cursor.skip( cursor.read<uint32_t>( ) );
+			}
+			auto const & plan = find_template( definition );
+
+			auto const count = cursor.read<uint32_t>( );
+			cursor.need( static_cast<size_t>(count) * 4 );
+			struct value_ref {
+				unsigned char const * data;
+				size_t size;
+				unsigned char type;
+			};
+			std::array<value_ref, field_count> values;
+			values.fill( value_ref{ nullptr, 0, value_type::null } );
+			auto descriptor = cursor.pos( );
+			cursor.skip( static_cast<size_t>(count) * 4 );
+			for( uint32_t n = 0; n < count; ++n, descriptor += 4 ) {
+				auto const value_size = static_cast<size_t>(read_at<uint16_t>( m_data, descriptor ));
+				auto const type = read_at<unsigned char>( m_data, descriptor + 2 );
+				cursor.need( value_size );
+				for( size_t field = 0; field < field_count; ++field ) {
+					if( plan[field] == static_cast<int32_t>(n) ) {
+						values[field] = value_ref{ cursor.data( ), value_size, type };
+					}
+				}
+				cursor.skip( value_size );
+			}
+
+			auto const integer = [&]( field_t const field ) {
+				auto const & value = values[field];
+				return nullptr == value.data ? boost::optional<uint64_t>( ) : read_integer( value.type, value.data, value.size );
+			};
+			auto const text = [&]( field_t const field, std::wstring & result ) {
+				auto const & value = values[field];
+				if( value_type::string == value.type ) {
+					assign_utf16( result, value.data, value.size );
+				} else if( value_type::sid == value.type ) {
+					assign_sid( result, value.data, value.size );
+				}
+			};
+
+			if( auto const event_id = integer( event_id_field ) ) {
+				out.event_id = static_cast<int>(*event_id);
+			}
+			if( value_type::filetime == values[time_created_field].type ) {
+				if( auto const time_created = integer( time_created_field ) ) {
+					out.timestamp = static_cast<int64_t>(*time_created / 10) - filetime_epoch_offset;
+				}
+			}
+			text( computer_field, out.computer );
+			text( target_user_sid_field, out.target_user_sid );
+			text( target_user_name_field, out.target_user_name );
+			text( target_domain_name_field, out.target_domain_name );
+			if( auto const logon_id = integer( target_logon_id_field ) ) {
+				out.target_logon_id = *logon_id;
+			}
+			if( auto const logon_type = integer( logon_type_field ) ) {
+				out.logon_type = static_cast<int>(*logon_type);
+			}
+		}
+
+		bool evtx_chunk::next( evtx_event & out ) {
+			while( m_next + record_header_size <= m_end ) {
+				auto const offset = m_next;
+				auto const size = static_cast<size_t>(read_at<uint32_t>( m_data, offset + 4 ));
+				if( record_signature != read_at<uint32_t>( m_data, offset ) || size < record_header_size + 4 || size > m_end - offset ) {
+					// Nothing to find the next record by
+					m_next = m_end;
+					++m_skipped;
+					return false;
+				}
+				m_next = offset + size;
+				try {
+					read_record( offset, size, out );
+					return true;
+				} catch( parse_error const & ) {
+					++m_skipped;
+				}
+			}
+			return false;
+		}
+
+		size_t evtx_chunk::skipped_records( ) const {
+			return m_skipped;
+		}
+
+		evtx_file::evtx_file( std::string file_name ): m_name( std::move( file_name ) ), m_file( ), m_chunks( 0 ) {
+			try {
+				m_file.open( m_name );
+			} catch( std::exception const & ) {
+				throw std::runtime_error( "Could not open EVTX file " + m_name );
+			}
+			if( m_file.size( ) < file_header_size || 0 != std::memcmp( m_file.data( ), file_signature, sizeof( file_signature ) ) ) {
+				throw std::runtime_error( "Not an EVTX file " + m_name );
+			}
+			m_chunks = (m_file.size( ) - file_header_size) / evtx_chunk::chunk_size;
+		}
+
+		std::string const & evtx_file::name( ) const {
+			return m_name;
+		}
+
+		size_t evtx_file::chunk_count( ) const {
+			return m_chunks;
+		}
+
+		bool evtx_file::has_chunk( size_t const n ) const {
+			if( n >= m_chunks ) {
+				return false;
+			}
+			// Anything but zeros is read, so a damaged chunk is reported
+			auto const signature = m_file.data( ) + file_header_size + n * evtx_chunk::chunk_size;
+			return std::any_of( signature, signature + sizeof( chunk_signature ), []( char const c ) {
+				return '\0' != c;
+			} );
+		}
+
+		evtx_chunk evtx_file::chunk( size_t const n ) const {
+			if( n >= m_chunks ) {
+				throw std::out_of_range( "EVTX chunk out of range" );
+			}
+			return evtx_chunk( reinterpret_cast<unsigned char const *>(m_file.data( )) + file_header_size + n * evtx_chunk::chunk_size );
+		}
+	}	// namespace wmi
+}	// namespace daw
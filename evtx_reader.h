@@ -0,0 +1,197 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#pragma once
+
+#include <array>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/optional.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "host_pool.h"
+
+namespace daw {
+	namespace wmi {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	The System values and logon EventData of one EVTX
+		///				record.  Values the record does not have are empty or
+		///				0.
+		//////////////////////////////////////////////////////////////////////////
+		struct evtx_event {
+			uint64_t record_id;
+			int event_id;
+			int64_t timestamp;	// microseconds since 1970-01-01 UTC
+			std::wstring computer;
+			std::wstring target_user_sid;
+			std::wstring target_user_name;
+			std::wstring target_domain_name;
+			uint64_t target_logon_id;
+			boost::optional<int> logon_type;
+		};	// struct evtx_event
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Reads the records of one 64 KiB chunk of an EVTX file.
+		///				Chunks share nothing, so each can be read on its own
+		///				thread.  Records are binary XML filled in from a
+		///				template kept in the chunk.  Each template is walked
+		///				once to find which of its substitutions hold the
+		///				values above, after that a record is read by indexing
+		///				its substitution array without building any XML.
+		//////////////////////////////////////////////////////////////////////////
+		class evtx_chunk {
+		public:
+			static size_t const chunk_size = 64 * 1024;
+
+			enum field_t: size_t {
+				event_id_field,
+				time_created_field,
+				computer_field,
+				target_user_sid_field,
+				target_user_name_field,
+				target_domain_name_field,
+				target_logon_id_field,
+				logon_type_field,
+				field_count
+			};
+
+		private:
+			using template_plan = std::array<int32_t, field_count>;	// substitution of each field, -1 when none
+
+			unsigned char const * m_data;
+			size_t m_next;
+			size_t m_end;
+			size_t m_skipped;
+			std::unordered_map<uint32_t, template_plan> m_templates;
+
+			template_plan const & find_template( uint32_t const offset );
+			void read_record( size_t const offset, size_t const size, evtx_event & out );
+
+		public:
+			/// Summary: data must hold chunk_size bytes.  Throws std::runtime_error if it is not a chunk
+			explicit evtx_chunk( unsigned char const * data );
+			~evtx_chunk( ) = default;
+			evtx_chunk( evtx_chunk const & ) = delete;
+			evtx_chunk & operator=( evtx_chunk const & ) = delete;
+			evtx_chunk( evtx_chunk && ) = default;
+			evtx_chunk & operator=( evtx_chunk && ) = default;
+
+			/// Summary: Read the next record.  Returns false after the last one
+			bool next( evtx_event & out );
+
+			/// Summary: Records passed over because their binary XML could not be read
+			size_t skipped_records( ) const;
+		};	// class evtx_chunk
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	An EVTX file mapped into memory.  Throws
+		///				std::runtime_error if it is not an EVTX file.
+		//////////////////////////////////////////////////////////////////////////
+		class evtx_file {
+			std::string m_name;
+			boost::iostreams::mapped_file_source m_file;
+			size_t m_chunks;
+
+		public:
+			explicit evtx_file( std::string file_name );
+
+			std::string const & name( ) const;
+			size_t chunk_count( ) const;
+
+			/// Summary: Whether chunk n is in use.  Files are preallocated so trailing chunks can be zero filled
+			bool has_chunk( size_t const n ) const;
+			evtx_chunk chunk( size_t const n ) const;
+		};	// class evtx_file
+
+		struct chunk_error {
+			std::string file_name;
+			size_t chunk;
+			std::string message;
+		};	// struct chunk_error
+
+		template<typename T>
+		struct chunk_results {
+			std::vector<T> rows;
+			std::vector<chunk_error> errors;
+		};	// struct chunk_results
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Run read( chunk ) for every chunk in use in files on at
+		///				most max_workers threads.  Rows are returned in file
+		///				then chunk order.  A chunk that cannot be read is
+		///				reported in errors and does not affect the others.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename T, typename ReadFunction>
+		chunk_results<T> read_chunks( std::vector<evtx_file> const & files, size_t const max_workers, ReadFunction read ) {
+			struct chunk_ref {
+				size_t file;
+				size_t chunk;
+			};
+			std::vector<chunk_ref> chunks;
+			for( size_t file = 0; file < files.size( ); ++file ) {
+				for( size_t chunk = 0; chunk < files[file].chunk_count( ); ++chunk ) {
+					if( files[file].has_chunk( chunk ) ) {
+						chunks.push_back( chunk_ref{ file, chunk } );
+					}
+				}
+			}
+
+			std::vector<std::vector<T>> chunk_rows( chunks.size( ) );
+			std::vector<std::string> chunk_failures( chunks.size( ) );
+			std::vector<char> chunk_failed( chunks.size( ), 0 );
+			run_workers( chunks.size( ), max_workers, [&]( size_t const n ) {
+				try {
+					auto chunk = files[chunks[n].file].chunk( chunks[n].chunk );
+					chunk_rows[n] = read( chunk );
+				} catch( std::exception const & ex ) {
+					chunk_failed[n] = 1;
+					chunk_failures[n] = ex.what( );
+				} catch( ... ) {
+					chunk_failed[n] = 1;
+					chunk_failures[n] = "Unknown error";
+				}
+			} );
+
+			chunk_results<T> result;
+			size_t total = 0;
+			for( auto const & rows : chunk_rows ) {
+				total += rows.size( );
+			}
+			result.rows.reserve( total );
+			for( size_t n = 0; n < chunks.size( ); ++n ) {
+				if( chunk_failed[n] ) {
+					result.errors.push_back( chunk_error{ files[chunks[n].file].name( ), chunks[n].chunk, std::move( chunk_failures[n] ) } );
+					continue;
+				}
+				std::move( chunk_rows[n].begin( ), chunk_rows[n].end( ), std::back_inserter( result.rows ) );
+			}
+			return result;
+		}
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,590 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Unit tests of reading EVTX chunks and files, on chunks built here
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE evtx_reader
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "evtx_reader.h"
+
+namespace {
+	namespace value_type {
+		unsigned char const null = 0x00;
+		unsigned char const string = 0x01;
+		unsigned char const uint16 = 0x06;
+		unsigned char const uint32 = 0x08;
+		unsigned char const filetime = 0x11;
+		unsigned char const sid = 0x13;
+		unsigned char const hex_int64 = 0x15;
+	}	// namespace value_type
+
+	int64_t const filetime_epoch_offset = 11644473600LL * 1000000LL;
+
+	struct substitution_value {
+		unsigned char type;
+		std::vector<unsigned char> data;
+	};	// struct substitution_value
+
+	template<typename T>
+	substitution_value integer_value( unsigned char const type, T const value ) {
+		substitution_value result { type, std::vector<unsigned char>( sizeof( T ) ) };
+		std::memcpy( result.data.data( ), &value, sizeof( T ) );
+		return result;
+	}
+
+	substitution_value filetime_value( int64_t const timestamp ) {
+		return integer_value( value_type::filetime, static_cast<uint64_t>( (timestamp + filetime_epoch_offset) * 10 ) );
+	}
+
+	// UTF-16LE with its terminator, as the event log writes strings
+	substitution_value string_value( std::wstring const & value ) {
+		substitution_value result { value_type::string, { } };
+		auto const push = [&result]( uint32_t const c ) {
+			result.data.push_back( static_cast<unsigned char>( c & 0xFF ) );
+			result.data.push_back( static_cast<unsigned char>( c >> 8 ) );
+		};
+		for( auto const c : value ) {
+			auto const code_point = static_cast<uint32_t>( c );
+			if( code_point > 0xFFFF ) {
+				push( 0xD800 + ((code_point - 0x10000) >> 10) );
+				push( 0xDC00 + ((code_point - 0x10000) & 0x3FF) );
+			} else {
+				push( code_point );
+			}
+		}
+		push( 0 );
+		return result;
+	}
+
+	substitution_value sid_value( uint64_t const authority, std::vector<uint32_t> const & sub_authorities ) {
+		substitution_value result { value_type::sid, { 1, static_cast<unsigned char>( sub_authorities.size( ) ) } };
+		for( int n = 5; n >= 0; --n ) {
+			result.data.push_back( static_cast<unsigned char>( authority >> (8 * n) ) );
+		}
+		for( auto const sub_authority : sub_authorities ) {
+			for( int n = 0; n < 4; ++n ) {
+				result.data.push_back( static_cast<unsigned char>( sub_authority >> (8 * n) ) );
+			}
+		}
+		return result;
+	}
+
+	substitution_value null_value( ) {
+		return substitution_value { value_type::null, { } };
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Summary:	Writes a chunk of binary XML records.  Names are stored
+	///				in place the first time they are used and referred to by
+	///				offset after that, as the event log does.
+	//////////////////////////////////////////////////////////////////////////
+	class chunk_builder {
+		std::vector<unsigned char> m_bytes;
+		std::map<std::string, uint32_t> m_names;
+		size_t m_record;
+
+	public:
+		chunk_builder( ): m_bytes( 512, 0 ), m_names( ), m_record( 0 ) {
+			std::memcpy( m_bytes.data( ), "ElfChnk", 8 );
+		}
+
+		uint32_t pos( ) const {
+			return static_cast<uint32_t>( m_bytes.size( ) );
+		}
+
+		void u8( unsigned char const value ) {
+			m_bytes.push_back( value );
+		}
+
+		void u16( uint16_t const value ) {
+			u8( static_cast<unsigned char>( value & 0xFF ) );
+			u8( static_cast<unsigned char>( value >> 8 ) );
+		}
+
+		void u32( uint32_t const value ) {
+			u16( static_cast<uint16_t>( value & 0xFFFF ) );
+			u16( static_cast<uint16_t>( value >> 16 ) );
+		}
+
+		void u64( uint64_t const value ) {
+			u32( static_cast<uint32_t>( value & 0xFFFFFFFF ) );
+			u32( static_cast<uint32_t>( value >> 32 ) );
+		}
+
+		void patch32( size_t const offset, uint32_t const value ) {
+			for( size_t n = 0; n < 4; ++n ) {
+				m_bytes[offset + n] = static_cast<unsigned char>( value >> (8 * n) );
+			}
+		}
+
+		void name( std::string const & value ) {
+			auto const known = m_names.find( value );
+			if( m_names.end( ) != known ) {
+				u32( known->second );
+				return;
+			}
+			auto const offset = pos( ) + 4;
+			m_names[value] = offset;
+			u32( offset );
+			u32( 0 );	// next name
+			u16( 0 );	// hash, not checked
+			u16( static_cast<uint16_t>( value.size( ) ) );
+			for( auto const c : value ) {
+				u16( static_cast<uint16_t>( c ) );
+			}
+			u16( 0 );
+		}
+
+		void open( std::string const & element, bool const has_attributes = false ) {
+			u8( has_attributes ? 0x41 : 0x01 );
+			u16( 0 );	// dependency id
+			u32( 0 );	// element size, not used
+			name( element );
+			if( has_attributes ) {
+				u32( 0 );	// attribute list size
+			}
+		}
+
+		void attribute( std::string const & attribute_name, bool const more = false ) {
+			u8( more ? 0x46 : 0x06 );
+			name( attribute_name );
+		}
+
+		void text( std::string const & value ) {
+			u8( 0x05 );
+			u8( value_type::string );
+			u16( static_cast<uint16_t>( value.size( ) ) );
+			for( auto const c : value ) {
+				u16( static_cast<uint16_t>( c ) );
+			}
+		}
+
+		void substitution( uint16_t const index, unsigned char const type, bool const optional = false ) {
+			u8( optional ? 0x0e : 0x0d );
+			u16( index );
+			u8( type );
+		}
+
+		void close_start( ) {
+			u8( 0x02 );
+		}
+
+		void close_empty( ) {
+			u8( 0x03 );
+		}
+
+		void end( ) {
+			u8( 0x04 );
+		}
+
+		// <name>{index}</name>
+		void element( std::string const & element_name, uint16_t const index, unsigned char const type ) {
+			open( element_name );
+			close_start( );
+			substitution( index, type );
+			end( );
+		}
+
+		// <Data Name="name">{index}</Data>
+		void data( std::string const & data_name, uint16_t const index, unsigned char const type, bool const optional = false ) {
+			open( "Data", true );
+			attribute( "Name" );
+			text( data_name );
+			close_start( );
+			substitution( index, type, optional );
+			end( );
+		}
+
+		// A definition at pos( ): next definition, GUID, body size and the body
+		template<typename Body>
+		uint32_t define_template( Body body ) {
+			auto const offset = pos( );
+			u32( 0 );
+			for( size_t n = 0; n < 16; ++n ) {
+				u8( static_cast<unsigned char>( n ) );
+			}
+			auto const size_pos = pos( );
+			u32( 0 );
+			auto const body_start = pos( );
+			u8( 0x0f );
+			u8( 1 );
+			u8( 1 );
+			u8( 0 );
+			body( *this );
+			u8( 0x00 );
+			patch32( size_pos, pos( ) - body_start );
+			return offset;
+		}
+
+		void begin_record( uint64_t const record_id, int64_t const written ) {
+			m_record = pos( );
+			u32( 0x00002a2a );
+			u32( 0 );	// size, set by end_record
+			u64( record_id );
+			u64( static_cast<uint64_t>( (written + filetime_epoch_offset) * 10 ) );
+			u8( 0x0f );
+			u8( 1 );
+			u8( 1 );
+			u8( 0 );
+		}
+
+		void begin_instance( ) {
+			u8( 0x0c );
+			u8( 1 );
+			u32( 0 );	// template id
+		}
+
+		// A record using the template defined at offset
+		void template_instance( uint32_t const offset ) {
+			begin_instance( );
+			u32( offset );
+		}
+
+		// A record using a template defined in it, returns the definition's offset
+		template<typename Body>
+		uint32_t inline_template( Body body ) {
+			begin_instance( );
+			u32( pos( ) + 4 );
+			return define_template( body );
+		}
+
+		void values( std::vector<substitution_value> const & substitutions ) {
+			u32( static_cast<uint32_t>( substitutions.size( ) ) );
+			for( auto const & value : substitutions ) {
+				u16( static_cast<uint16_t>( value.data.size( ) ) );
+				u8( value.type );
+				u8( 0 );
+			}
+			for( auto const & value : substitutions ) {
+				m_bytes.insert( m_bytes.end( ), value.data.begin( ), value.data.end( ) );
+			}
+		}
+
+		void end_record( ) {
+			auto const size = pos( ) - m_record + 4;
+			u32( static_cast<uint32_t>( size ) );
+			patch32( m_record + 4, static_cast<uint32_t>( size ) );
+		}
+
+		std::vector<unsigned char> finish( ) {
+			auto result = m_bytes;
+			auto const free_space = static_cast<uint32_t>( m_bytes.size( ) );
+			std::memcpy( result.data( ) + 48, &free_space, sizeof( free_space ) );
+			result.resize( daw::wmi::evtx_chunk::chunk_size, 0 );
+			return result;
+		}
+	};	// class chunk_builder
+
+	// The Security log's logon template with its substitutions out of order
+	void logon_template( chunk_builder & xml ) {
+		xml.open( "Event", true );
+		xml.attribute( "xmlns" );
+		xml.text( "http://schemas.microsoft.com/win/2004/08/events/event" );
+		xml.close_start( );
+		xml.open( "System" );
+		xml.close_start( );
+		xml.element( "EventID", 3, value_type::uint16 );
+		xml.open( "TimeCreated", true );
+		xml.attribute( "SystemTime" );
+		xml.substitution( 0, value_type::filetime );
+		xml.close_empty( );
+		xml.element( "Computer", 7, value_type::string );
+		xml.end( );
+		xml.open( "EventData" );
+		xml.close_start( );
+		xml.data( "SubjectUserName", 8, value_type::string );
+		xml.data( "TargetUserSid", 1, value_type::sid );
+		xml.data( "TargetUserName", 5, value_type::string );
+		xml.data( "TargetDomainName", 2, value_type::string );
+		xml.data( "TargetLogonId", 6, value_type::hex_int64 );
+		xml.data( "LogonType", 4, value_type::uint32, true );
+		xml.end( );
+		xml.end( );
+	}
+
+	std::vector<substitution_value> logon_values( int64_t const timestamp, uint16_t const event_id, std::wstring const & computer, substitution_value const & sid, std::wstring const & user, std::wstring const & domain, uint64_t const logon_id, substitution_value const & logon_type ) {
+		return {
+			filetime_value( timestamp ),
+			sid,
+			string_value( domain ),
+			integer_value( value_type::uint16, event_id ),
+			logon_type,
+			string_value( user ),
+			integer_value( value_type::hex_int64, logon_id ),
+			string_value( computer ),
+			string_value( L"SYSTEM" )
+		};
+	}
+
+	// Another template, without TimeCreated
+	void short_template( chunk_builder & xml ) {
+		xml.open( "Event" );
+		xml.close_start( );
+		xml.open( "System" );
+		xml.close_start( );
+		xml.element( "Computer", 0, value_type::string );
+		xml.element( "EventID", 1, value_type::uint16 );
+		xml.end( );
+		xml.end( );
+	}
+
+	int64_t const logon_time = 1699146600123456LL;	// 2023-11-05 01:10:00.123456 UTC
+	int64_t const logoff_time = 1699150200654321LL;
+	int64_t const written_time = 1699160000000000LL;
+
+	// 4624 and 4647 sharing a template, a record reusing it after two that
+	// cannot be read, a record with a template of its own and a record
+	// whose header is damaged, ending the chunk
+	std::vector<unsigned char> sample_chunk( uint64_t const first_record_id = 100 ) {
+		chunk_builder chunk;
+		chunk.begin_record( first_record_id, written_time );
+		auto const logon = chunk.inline_template( logon_template );
+		chunk.values( logon_values( logon_time, 4624, L"host-日本.example", sid_value( 5, { 21, 1004336348, 1177238915, 682003330, 1001 } ), L"ålice\U0001F600", L"CORP", 0x0000001234567890ULL, integer_value( value_type::uint32, uint32_t( 10 ) ) ) );
+		chunk.end_record( );
+
+		chunk.begin_record( first_record_id + 1, written_time );
+		chunk.template_instance( logon );
+		chunk.values( logon_values( logoff_time, 4647, L"host-日本.example", sid_value( 5, { 18 } ), L"bob", L"NT AUTHORITY", 0x3e7, null_value( ) ) );
+		chunk.end_record( );
+
+		// Not a template instance
+		chunk.begin_record( first_record_id + 2, written_time );
+		chunk.substitution( 0, value_type::string );
+		chunk.values( { } );
+		chunk.end_record( );
+
+		// More substitutions than the record holds
+		chunk.begin_record( first_record_id + 3, written_time );
+		chunk.template_instance( logon );
+		chunk.u32( 0xFFFF );
+		chunk.end_record( );
+
+		chunk.begin_record( first_record_id + 4, written_time );
+		chunk.template_instance( logon );
+		chunk.values( logon_values( logon_time + 1, 4624, L"other", sid_value( 5, { 19 } ), L"carol", L"", 42, integer_value( value_type::uint32, uint32_t( 3 ) ) ) );
+		chunk.end_record( );
+
+		chunk.begin_record( first_record_id + 5, written_time );
+		chunk.inline_template( short_template );
+		chunk.values( { string_value( L"short" ), integer_value( value_type::uint16, uint16_t( 4608 ) ) } );
+		chunk.end_record( );
+
+		chunk.begin_record( first_record_id + 6, written_time );
+		chunk.template_instance( logon );
+		chunk.values( logon_values( logon_time + 2, 4624, L"never", sid_value( 5, { 20 } ), L"dave", L"", 43, null_value( ) ) );
+		chunk.end_record( );
+
+		auto result = chunk.finish( );
+		// Damage the signature of the last record
+		std::vector<unsigned char> signature = { 0x2a, 0x2a, 0x00, 0x00 };
+		auto pos = std::search( result.rbegin( ), result.rend( ), signature.rbegin( ), signature.rend( ) );
+		BOOST_REQUIRE( result.rend( ) != pos );
+		*pos = 0xFF;
+		return result;
+	}
+
+	std::vector<daw::wmi::evtx_event> read_all( daw::wmi::evtx_chunk & chunk ) {
+		std::vector<daw::wmi::evtx_event> result;
+		daw::wmi::evtx_event record;
+		while( chunk.next( record ) ) {
+			result.push_back( record );
+		}
+		return result;
+	}
+
+	// A file name in the temporary directory that is removed at the end of the test
+	struct temp_file {
+		boost::filesystem::path path;
+
+		temp_file( ): path( boost::filesystem::temp_directory_path( ) / boost::filesystem::unique_path( "who_is_on_test-%%%%-%%%%-%%%%.evtx" ) ) { }
+
+		~temp_file( ) {
+			boost::system::error_code ec;
+			boost::filesystem::remove( path, ec );
+		}
+
+		std::string name( ) const {
+			return path.string( );
+		}
+
+		void write( std::vector<std::vector<unsigned char>> const & chunks ) const {
+			std::vector<char> header( 4096, 0 );
+			std::memcpy( header.data( ), "ElfFile", 8 );
+			std::ofstream out( name( ), std::ios::binary | std::ios::trunc );
+			out.write( header.data( ), static_cast<std::streamsize>( header.size( ) ) );
+			for( auto const & chunk : chunks ) {
+				out.write( reinterpret_cast<char const *>( chunk.data( ) ), static_cast<std::streamsize>( chunk.size( ) ) );
+			}
+		}
+	};	// struct temp_file
+}	// namespace anonymous
+
+BOOST_AUTO_TEST_CASE( reads_records_of_a_chunk ) {
+	auto const data = sample_chunk( );
+	daw::wmi::evtx_chunk chunk( data.data( ) );
+	auto const records = read_all( chunk );
+	BOOST_REQUIRE_EQUAL( records.size( ), 4u );
+
+	auto const & logon = records[0];
+	BOOST_CHECK_EQUAL( logon.record_id, 100u );
+	BOOST_CHECK_EQUAL( logon.event_id, 4624 );
+	BOOST_CHECK_EQUAL( logon.timestamp, logon_time );
+	BOOST_CHECK( logon.computer == L"host-日本.example" );
+	BOOST_CHECK( logon.target_user_sid == L"S-1-5-21-1004336348-1177238915-682003330-1001" );
+	BOOST_CHECK( logon.target_user_name == L"ålice\U0001F600" );
+	BOOST_CHECK( logon.target_domain_name == L"CORP" );
+	BOOST_CHECK_EQUAL( logon.target_logon_id, 0x0000001234567890ULL );
+	BOOST_REQUIRE( logon.logon_type );
+	BOOST_CHECK_EQUAL( *logon.logon_type, 10 );
+
+	// Same template as the first, defined earlier in the chunk
+	auto const & logoff = records[1];
+	BOOST_CHECK_EQUAL( logoff.record_id, 101u );
+	BOOST_CHECK_EQUAL( logoff.event_id, 4647 );
+	BOOST_CHECK_EQUAL( logoff.timestamp, logoff_time );
+	BOOST_CHECK( logoff.computer == L"host-日本.example" );
+	BOOST_CHECK( logoff.target_user_sid == L"S-1-5-18" );
+	BOOST_CHECK( logoff.target_user_name == L"bob" );
+	BOOST_CHECK( logoff.target_domain_name == L"NT AUTHORITY" );
+	BOOST_CHECK_EQUAL( logoff.target_logon_id, 0x3e7u );
+	BOOST_CHECK( !logoff.logon_type );
+
+	// Read after the two that could not be
+	auto const & reused = records[2];
+	BOOST_CHECK_EQUAL( reused.record_id, 104u );
+	BOOST_CHECK_EQUAL( reused.timestamp, logon_time + 1 );
+	BOOST_CHECK( reused.target_user_name == L"carol" );
+	BOOST_CHECK( reused.target_domain_name.empty( ) );
+	BOOST_CHECK_EQUAL( reused.target_logon_id, 42u );
+	BOOST_REQUIRE( reused.logon_type );
+	BOOST_CHECK_EQUAL( *reused.logon_type, 3 );
+
+	// A template of its own, the written time stands in for TimeCreated
+	auto const & other = records[3];
+	BOOST_CHECK_EQUAL( other.record_id, 105u );
+	BOOST_CHECK_EQUAL( other.event_id, 4608 );
+	BOOST_CHECK_EQUAL( other.timestamp, written_time );
+	BOOST_CHECK( other.computer == L"short" );
+	BOOST_CHECK( other.target_user_sid.empty( ) );
+	BOOST_CHECK( other.target_user_name.empty( ) );
+	BOOST_CHECK_EQUAL( other.target_logon_id, 0u );
+	BOOST_CHECK( !other.logon_type );
+}
+
+BOOST_AUTO_TEST_CASE( malformed_records_are_skipped ) {
+	auto const data = sample_chunk( );
+	daw::wmi::evtx_chunk chunk( data.data( ) );
+	read_all( chunk );
+	// Two with bad binary XML and the damaged header, which ends the chunk
+	BOOST_CHECK_EQUAL( chunk.skipped_records( ), 3u );
+	daw::wmi::evtx_event record;
+	BOOST_CHECK( !chunk.next( record ) );
+	BOOST_CHECK_EQUAL( chunk.skipped_records( ), 3u );
+}
+
+BOOST_AUTO_TEST_CASE( empty_chunk ) {
+	auto const data = chunk_builder( ).finish( );
+	daw::wmi::evtx_chunk chunk( data.data( ) );
+	BOOST_CHECK( read_all( chunk ).empty( ) );
+	BOOST_CHECK_EQUAL( chunk.skipped_records( ), 0u );
+}
+
+BOOST_AUTO_TEST_CASE( bad_chunk_header_throws ) {
+	auto data = sample_chunk( );
+	data[0] = 'X';
+	BOOST_CHECK_THROW( daw::wmi::evtx_chunk( data.data( ) ), std::runtime_error );
+
+	data = sample_chunk( );
+	uint32_t const free_space = daw::wmi::evtx_chunk::chunk_size + 1;
+	std::memcpy( data.data( ) + 48, &free_space, sizeof( free_space ) );
+	BOOST_CHECK_THROW( daw::wmi::evtx_chunk( data.data( ) ), std::runtime_error );
+}
+
+BOOST_AUTO_TEST_CASE( not_an_evtx_file_throws ) {
+	temp_file file;
+	BOOST_CHECK_THROW( daw::wmi::evtx_file( file.name( ) ), std::runtime_error );
+	{
+		std::ofstream out( file.name( ), std::ios::binary );
+		out << std::string( 8192, 'x' );
+	}
+	BOOST_CHECK_THROW( daw::wmi::evtx_file( file.name( ) ), std::runtime_error );
+}
+
+BOOST_AUTO_TEST_CASE( bad_chunk_does_not_affect_the_others ) {
+	auto bad = sample_chunk( 200 );
+	std::memcpy( bad.data( ), "Garbage!", 8 );
+	temp_file file;
+	// The zero filled chunk at the end is preallocated space, not an error
+	file.write( { sample_chunk( 100 ), bad, sample_chunk( 300 ), std::vector<unsigned char>( daw::wmi::evtx_chunk::chunk_size, 0 ) } );
+
+	std::vector<daw::wmi::evtx_file> files;
+	files.emplace_back( file.name( ) );
+	BOOST_REQUIRE_EQUAL( files.front( ).chunk_count( ), 4u );
+	BOOST_CHECK( files.front( ).has_chunk( 1 ) );
+	BOOST_CHECK( !files.front( ).has_chunk( 3 ) );
+
+	for( size_t const workers : { 1, 3 } ) {
+		auto const results = daw::wmi::read_chunks<uint64_t>( files, workers, []( daw::wmi::evtx_chunk & chunk ) {
+			std::vector<uint64_t> ids;
+			for( auto const & record : read_all( chunk ) ) {
+				ids.push_back( record.record_id );
+			}
+			return ids;
+		} );
+		std::vector<uint64_t> const expected = { 100, 101, 104, 105, 300, 301, 304, 305 };
+		BOOST_CHECK( results.rows == expected );
+		BOOST_REQUIRE_EQUAL( results.errors.size( ), 1u );
+		BOOST_CHECK_EQUAL( results.errors.front( ).file_name, file.name( ) );
+		BOOST_CHECK_EQUAL( results.errors.front( ).chunk, 1u );
+		BOOST_CHECK_EQUAL( results.errors.front( ).message, "Not an EVTX chunk" );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( read_error_does_not_affect_the_others ) {
+	temp_file file;
+	file.write( { sample_chunk( 100 ), sample_chunk( 200 ), sample_chunk( 300 ) } );
+	std::vector<daw::wmi::evtx_file> files;
+	files.emplace_back( file.name( ) );
+	auto const results = daw::wmi::read_chunks<uint64_t>( files, 2, []( daw::wmi::evtx_chunk & chunk ) {
+		auto const records = read_all( chunk );
+		if( 200 == records.front( ).record_id ) {
+			throw std::runtime_error( "read failed" );
+		}
+		return std::vector<uint64_t>( 1, records.front( ).record_id );
+	} );
+	std::vector<uint64_t> const expected = { 100, 300 };
+	BOOST_CHECK( results.rows == expected );
+	BOOST_REQUIRE_EQUAL( results.errors.size( ), 1u );
+	BOOST_CHECK_EQUAL( results.errors.front( ).chunk, 1u );
+	BOOST_CHECK_EQUAL( results.errors.front( ).message, "read failed" );
+}
@@ -0,0 +1,319 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "external_sort.h"
+
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+namespace daw {
+	namespace wmi {
+		namespace {
+			size_t const write_buffer_size = 64 * 1024;
+			size_t const min_rows_in_memory = 1024;
+
+			uint64_t zigzag_encode( int64_t const value ) {
+				return (static_cast<uint64_t>( value ) << 1) ^ static_cast<uint64_t>( value >> 63 );
+			}
+
+			int64_t zigzag_decode( uint64_t const value ) {
+				return static_cast<int64_t>( value >> 1 ) ^ -static_cast<int64_t>( value & 1 );
+			}
+
+			void put_varint( std::vector<unsigned char> & buffer, uint64_t value ) {
+				while( value >= 0x80 ) {
+					buffer.push_back( static_cast<unsigned char>( value | 0x80 ) );
+					value >>= 7;
+				}
+				buffer.push_back( static_cast<unsigned char>( value ) );
+			}
+
+			[[noreturn]] void throw_bad_run( std::string const & file_name ) {
+				throw std::runtime_error( "Sort run file " + file_name + " is truncated" );
+			}
+		}	// namespace anonymous
+
+		namespace impl {
+			run_writer::run_writer( std::string file_name ):
+					m_file( std::fopen( file_name.c_str( ), "wb" ) ),
+					m_file_name( std::move( file_name ) ),
+					m_buffer( ),
+					m_previous_timestamp( 0 ) {
+
+				if( nullptr == m_file ) {
+					throw std::runtime_error( "Could not create sort run file " + m_file_name );
+				}
+				m_buffer.reserve( write_buffer_size + 64 );
+			}
+
+			run_writer::~run_writer( ) {
+				if( nullptr != m_file ) {
+					std::fclose( m_file );
+				}
+			}
+
+			void run_writer::write_buffer( ) {
+				if( !m_buffer.empty( ) && std::fwrite( m_buffer.data( ), 1, m_buffer.size( ), m_file ) != m_buffer.size( ) ) {
+					throw std::runtime_error( "Error writing sort run file " + m_file_name );
+				}
+				m_buffer.clear( );
+			}
+
+			void run_writer::write( result_row const & row ) {
+				// Unsigned so that the difference of far apart times wraps instead of overflowing
+				put_varint( m_buffer, zigzag_encode( static_cast<int64_t>( static_cast<uint64_t>( row.timestamp ) - static_cast<uint64_t>( m_previous_timestamp ) ) ) );
+				put_varint( m_buffer, zigzag_encode( row.utc_offset ) );
+				put_varint( m_buffer, row.user_name );
+				put_varint( m_buffer, row.computer_name );
+				put_varint( m_buffer, row.category );
+				put_varint( m_buffer, zigzag_encode( row.event_code ) );
+				put_varint( m_buffer, row.logon_id );
+				m_previous_timestamp = row.timestamp;
+				if( m_buffer.size( ) >= write_buffer_size ) {
+					write_buffer( );
+				}
+			}
+
+			void run_writer::close( ) {
+				write_buffer( );
+				auto const result = std::fclose( m_file );
+				m_file = nullptr;
+				if( 0 != result ) {
+					throw std::runtime_error( "Error writing sort run file " + m_file_name );
+				}
+			}
+
+			run_reader::run_reader( std::string file_name, uint64_t const rows, size_t const buffer_size ):
+					m_file( std::fopen( file_name.c_str( ), "rb" ) ),
+					m_file_name( std::move( file_name ) ),
+					m_buffer( buffer_size ),
+					m_position( 0 ),
+					m_size( 0 ),
+					m_rows_left( rows ),
+					m_previous_timestamp( 0 ) {
+
+				if( nullptr == m_file ) {
+					throw std::runtime_error( "Could not open sort run file " + m_file_name );
+				}
+			}
+
+			run_reader::~run_reader( ) {
+				std::fclose( m_file );
+			}
+
+			unsigned char run_reader::next_byte( ) {
+				if( m_position == m_size ) {
+					m_size = std::fread( m_buffer.data( ), 1, m_buffer.size( ), m_file );
+					m_position = 0;
+					if( 0 == m_size ) {
+						throw_bad_run( m_file_name );
+					}
+				}
+				return m_buffer[m_position++];
+			}
+
+			uint64_t run_reader::read_varint( ) {
+				uint64_t result = 0;
+				for( int shift = 0; shift < 64; shift += 7 ) {
+					auto const byte = next_byte( );
+					result |= static_cast<uint64_t>( byte & 0x7F ) << shift;
+					if( 0 == (byte & 0x80) ) {
+						return result;
+					}
+				}
+				throw_bad_run( m_file_name );
+			}
+
+			bool run_reader::next( result_row & out_row ) {
+				if( 0 == m_rows_left ) {
+					return false;
+				}
+				--m_rows_left;
+				out_row.timestamp = static_cast<int64_t>( static_cast<uint64_t>( m_previous_timestamp ) + static_cast<uint64_t>( zigzag_decode( read_varint( ) ) ) );
+				out_row.utc_offset = static_cast<int16_t>( zigzag_decode( read_varint( ) ) );
+				out_row.user_name = static_cast<string_pool::id_t>( read_varint( ) );
+				out_row.computer_name = static_cast<string_pool::id_t>( read_varint( ) );
+				out_row.category = static_cast<string_pool::id_t>( read_varint( ) );
+				out_row.event_code = static_cast<int>( zigzag_decode( read_varint( ) ) );
+				out_row.logon_id = read_varint( );
+				m_previous_timestamp = out_row.timestamp;
+				return true;
+			}
+		}	// namespace impl
+
+		size_t const external_row_sort::read_buffer_size;
+
+		external_row_sort::external_row_sort( size_t const memory_limit, std::string const & directory ):
+				m_mutex( ),
+				m_directory( directory.empty( ) ? boost::filesystem::temp_directory_path( ) : boost::filesystem::path( directory ) ),
+				m_max_rows( std::max( min_rows_in_memory, memory_limit / 2 / sizeof( result_row ) ) ),
+				m_max_runs_merged( std::max<size_t>( 2, memory_limit / 2 / read_buffer_size ) ),
+				m_rows_in_memory( 0 ),
+				m_committed( ),
+				m_groups( ),
+				m_next_group( 0 ) { }
+
+		external_row_sort::~external_row_sort( ) {
+			remove_runs( m_committed.runs );
+			for( auto const & group : m_groups ) {
+				remove_runs( group.second.runs );
+			}
+		}
+
+		void external_row_sort::remove_runs( std::vector<run_file> const & runs ) {
+			for( auto const & run : runs ) {
+				boost::system::error_code ec;
+				boost::filesystem::remove( run.file_name, ec );
+			}
+		}
+
+		std::string external_row_sort::new_run_name( ) const {
+			return (m_directory / boost::filesystem::unique_path( "who_is_on-%%%%-%%%%-%%%%-%%%%.run" )).string( );
+		}
+
+		void external_row_sort::add_row( row_group & group, result_row const & row ) {
+			group.rows.push_back( row );
+			if( ++m_rows_in_memory < m_max_rows ) {
+				return;
+			}
+			// Spilling the largest buffer frees the most memory for one run
+			auto largest = &m_committed;
+			for( auto & open_group : m_groups ) {
+				if( open_group.second.rows.size( ) > largest->rows.size( ) ) {
+					largest = &open_group.second;
+				}
+			}
+			spill( *largest );
+		}
+
+		void external_row_sort::spill( row_group & group ) {
+			phase_timer const timer( run_phase::sort );
+			natural_merge_sort( group.rows.begin( ), group.rows.end( ) );
+			run_file run{ new_run_name( ), group.rows.size( ) };
+			// Recorded first so the file is removed even when writing fails
+			group.runs.push_back( run );
+			impl::run_writer writer( run.file_name );
+			for( auto const & row : group.rows ) {
+				writer.write( row );
+			}
+			writer.close( );
+			m_rows_in_memory -= group.rows.size( );
+			std::vector<result_row>( ).swap( group.rows );
+		}
+
+		void external_row_sort::reduce_runs( ) {
+			// Merge the oldest runs together until the rest and the rows in
+			// memory can be merged in one pass
+			auto & runs = m_committed.runs;
+			while( runs.size( ) + 1 > m_max_runs_merged ) {
+				auto const count = std::min( m_max_runs_merged, runs.size( ) + 2 - m_max_runs_merged );
+				std::vector<run_file> const merging( runs.begin( ), runs.begin( ) + static_cast<ptrdiff_t>( count ) );
+				run_file merged{ new_run_name( ), 0 };
+				for( auto const & run : merging ) {
+					merged.rows += run.rows;
+				}
+				// Recorded first so the file is removed even when writing fails
+				runs.push_back( merged );
+				impl::run_writer writer( merged.file_name );
+				merge_runs( merging, std::vector<result_row>( ), [&writer]( result_row const & row ) {
+					writer.write( row );
+				} );
+				writer.close( );
+				remove_runs( merging );
+				// The merged run takes the place of the ones it replaces so
+				// rows with the same time keep their order
+				runs.pop_back( );
+				runs.erase( runs.begin( ), runs.begin( ) + static_cast<ptrdiff_t>( count ) );
+				runs.insert( runs.begin( ), merged );
+			}
+		}
+
+		void external_row_sort::add( result_row const & row ) {
+			std::lock_guard<std::mutex> lock( m_mutex );
+			add_row( m_committed, row );
+		}
+
+		void external_row_sort::add( std::vector<result_row> const & rows ) {
+			std::lock_guard<std::mutex> lock( m_mutex );
+			for( auto const & row : rows ) {
+				add_row( m_committed, row );
+			}
+		}
+
+		external_row_sort::group_id external_row_sort::open_group( ) {
+			std::lock_guard<std::mutex> lock( m_mutex );
+			auto const group = m_next_group++;
+			m_groups[group];
+			return group;
+		}
+
+		void external_row_sort::add( group_id const group, result_row const & row ) {
+			std::lock_guard<std::mutex> lock( m_mutex );
+			add_row( m_groups.at( group ), row );
+		}
+
+		void external_row_sort::add( group_id const group, std::vector<result_row> const & rows ) {
+			std::lock_guard<std::mutex> lock( m_mutex );
+			auto & open_group = m_groups.at( group );
+			for( auto const & row : rows ) {
+				add_row( open_group, row );
+			}
+		}
+
+		void external_row_sort::commit( group_id const group ) {
+			std::lock_guard<std::mutex> lock( m_mutex );
+			auto it = m_groups.find( group );
+			if( m_groups.end( ) == it ) {
+				throw std::invalid_argument( "Row group is not open" );
+			}
+			// The group's rows in memory, being newer than its runs, go after
+			// every run so they stay behind them among rows with the same time
+			auto & rows = it->second.rows;
+			m_committed.rows.insert( m_committed.rows.end( ), rows.begin( ), rows.end( ) );
+			auto & runs = it->second.runs;
+			m_committed.runs.insert( m_committed.runs.end( ), runs.begin( ), runs.end( ) );
+			m_groups.erase( it );
+		}
+
+		void external_row_sort::discard( group_id const group ) {
+			std::lock_guard<std::mutex> lock( m_mutex );
+			auto it = m_groups.find( group );
+			if( m_groups.end( ) == it ) {
+				throw std::invalid_argument( "Row group is not open" );
+			}
+			m_rows_in_memory -= it->second.rows.size( );
+			remove_runs( it->second.runs );
+			m_groups.erase( it );
+		}
+
+		size_t external_row_sort::run_count( ) const {
+			std::lock_guard<std::mutex> lock( m_mutex );
+			auto result = m_committed.runs.size( );
+			for( auto const & group : m_groups ) {
+				result += group.second.runs.size( );
+			}
+			return result;
+		}
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,235 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "natural_sort.h"
+#include "result_row.h"
+#include "run_stats.h"
+
+namespace daw {
+	namespace wmi {
+		namespace impl {
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Writes a sorted run of rows to a file.  Each row is
+			///				its timestamp as a zigzag varint of the difference
+			///				from the row before, then zigzag varints of the UTC
+			///				offset and event code and varints of the three name
+			///				ids and the Logon ID.  Rows in a run are close in
+			///				time so most take 10 to 15 bytes.
+			//////////////////////////////////////////////////////////////////////////
+			class run_writer {
+				std::FILE * m_file;
+				std::string m_file_name;
+				std::vector<unsigned char> m_buffer;
+				int64_t m_previous_timestamp;
+
+				void write_buffer( );
+
+			public:
+				explicit run_writer( std::string file_name );
+				~run_writer( );
+				run_writer( run_writer const & ) = delete;
+				run_writer & operator=( run_writer const & ) = delete;
+				run_writer( run_writer && ) = delete;
+				run_writer & operator=( run_writer && ) = delete;
+
+				void write( result_row const & row );
+
+				/// Summary: Write out what is buffered and close the file.  Throws std::runtime_error on failure
+				void close( );
+			};	// class run_writer
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Reads back the rows of a run_writer file a buffer at a
+			///				time
+			//////////////////////////////////////////////////////////////////////////
+			class run_reader {
+				std::FILE * m_file;
+				std::string m_file_name;
+				std::vector<unsigned char> m_buffer;
+				size_t m_position;
+				size_t m_size;
+				uint64_t m_rows_left;
+				int64_t m_previous_timestamp;
+
+				unsigned char next_byte( );
+				uint64_t read_varint( );
+
+			public:
+				run_reader( std::string file_name, uint64_t const rows, size_t const buffer_size );
+				~run_reader( );
+				run_reader( run_reader const & ) = delete;
+				run_reader & operator=( run_reader const & ) = delete;
+				run_reader( run_reader && ) = delete;
+				run_reader & operator=( run_reader && ) = delete;
+
+				/// Summary: Read the next row into out_row, false once the run is done
+				bool next( result_row & out_row );
+			};	// class run_reader
+		}	// namespace impl
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Sorts more rows than fit in memory.  Rows are added to
+		///				buffers that, once they fill, are sorted and spilled
+		///				to temporary files as runs.  merge_to merges the runs
+		///				and what is left in the buffers into time order.  When
+		///				there are more runs than can be read at once within
+		///				the limit they are first merged into fewer, longer
+		///				ones.  Half of memory_limit holds the buffers and half
+		///				the read buffers of the runs being merged; the strings
+		///				the rows refer to are not counted.  Rows that may yet
+		///				be thrown away, such as those of a host whose query
+		///				has not finished, go in a group of their own that is
+		///				either committed or discarded.  Safe to call from
+		///				several threads.  The files are removed on destruction.
+		//////////////////////////////////////////////////////////////////////////
+		class external_row_sort {
+		public:
+			using group_id = size_t;
+
+		private:
+			struct run_file {
+				std::string file_name;
+				uint64_t rows;
+			};	// struct run_file
+
+			struct row_group {
+				std::vector<result_row> rows;
+				std::vector<run_file> runs;
+			};	// struct row_group
+
+			mutable std::mutex m_mutex;
+			boost::filesystem::path m_directory;
+			size_t m_max_rows;
+			size_t m_max_runs_merged;
+			size_t m_rows_in_memory;
+			row_group m_committed;
+			std::map<group_id, row_group> m_groups;
+			group_id m_next_group;
+
+			static void remove_runs( std::vector<run_file> const & runs );
+			std::string new_run_name( ) const;
+			void add_row( row_group & group, result_row const & row );
+			void spill( row_group & group );
+			void reduce_runs( );
+
+			template<typename Output>
+			void merge_runs( std::vector<run_file> const & runs, std::vector<result_row> const & rows, Output output ) const {
+				std::vector<std::unique_ptr<impl::run_reader>> readers;
+				for( auto const & run : runs ) {
+					readers.push_back( std::make_unique<impl::run_reader>( run.file_name, run.rows, read_buffer_size ) );
+				}
+				// Heads of each run, the rows left in memory are the last source
+				using head_t = std::pair<result_row, size_t>;
+				auto const later = []( head_t const & lhs, head_t const & rhs ) {
+					return rhs.first.timestamp < lhs.first.timestamp || (rhs.first.timestamp == lhs.first.timestamp && rhs.second < lhs.second);
+				};
+				std::priority_queue<head_t, std::vector<head_t>, decltype(later)> heads( later );
+				size_t position = 0;
+				auto const advance = [&]( size_t const source ) {
+					if( source < readers.size( ) ) {
+						result_row row;
+						if( readers[source]->next( row ) ) {
+							heads.emplace( row, source );
+						}
+					} else if( position < rows.size( ) ) {
+						heads.emplace( rows[position++], source );
+					}
+				};
+				for( size_t source = 0; source <= readers.size( ); ++source ) {
+					advance( source );
+				}
+				while( !heads.empty( ) ) {
+					auto const head = heads.top( );
+					heads.pop( );
+					output( head.first );
+					advance( head.second );
+				}
+			}
+
+		public:
+			static size_t const read_buffer_size = 64 * 1024;
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Keep to about memory_limit bytes, spilling runs into
+			///				directory, the system's temporary directory when
+			///				empty
+			//////////////////////////////////////////////////////////////////////////
+			explicit external_row_sort( size_t const memory_limit, std::string const & directory = std::string( ) );
+			~external_row_sort( );
+			external_row_sort( external_row_sort const & ) = delete;
+			external_row_sort & operator=( external_row_sort const & ) = delete;
+			external_row_sort( external_row_sort && ) = delete;
+			external_row_sort & operator=( external_row_sort && ) = delete;
+
+			/// Summary: Add rows that are kept
+			void add( result_row const & row );
+			void add( std::vector<result_row> const & rows );
+
+			/// Summary: Start a group of rows that are only kept once committed
+			group_id open_group( );
+			void add( group_id const group, result_row const & row );
+			void add( group_id const group, std::vector<result_row> const & rows );
+
+			/// Summary: Keep the rows of group, which is then closed
+			void commit( group_id const group );
+
+			/// Summary: Throw away the rows of group, and its runs, and close it
+			void discard( group_id const group );
+
+			/// Summary: Runs spilled to disk and not yet discarded or merged together
+			size_t run_count( ) const;
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Pass every row kept to output in time order.  Rows
+			///				with the same time are in the order they were
+			///				added, among those added with one group or without
+			///				any.  Groups left open are left out.  Call once all
+			///				rows have been added.
+			//////////////////////////////////////////////////////////////////////////
+			template<typename Output>
+			void merge_to( Output output ) {
+				std::lock_guard<std::mutex> lock( m_mutex );
+				{
+					phase_timer const timer( run_phase::sort );
+					natural_merge_sort( m_committed.rows.begin( ), m_committed.rows.end( ) );
+					reduce_runs( );
+				}
+				merge_runs( m_committed.runs, m_committed.rows, output );
+			}
+		};	// class external_row_sort
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,239 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Unit tests of the run files and merging of external_row_sort
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE external_sort
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "external_sort.h"
+
+namespace {
+	// A directory of its own for the run files of one test
+	struct temp_directory {
+		boost::filesystem::path path;
+
+		temp_directory( ): path( boost::filesystem::temp_directory_path( ) / boost::filesystem::unique_path( "who_is_on_test-%%%%-%%%%-%%%%" ) ) {
+			boost::filesystem::create_directory( path );
+		}
+
+		~temp_directory( ) {
+			boost::system::error_code ec;
+			boost::filesystem::remove_all( path, ec );
+		}
+
+		size_t file_count( ) const {
+			return static_cast<size_t>( std::distance( boost::filesystem::directory_iterator( path ), boost::filesystem::directory_iterator( ) ) );
+		}
+	};	// struct temp_directory
+
+	daw::wmi::result_row make_row( int64_t const timestamp, uint64_t const sequence ) {
+		daw::wmi::result_row row;
+		row.timestamp = timestamp;
+		row.utc_offset = static_cast<int16_t>( sequence % 1440 ) - 720;
+		row.user_name = static_cast<daw::wmi::string_pool::id_t>( sequence * 7 );
+		row.computer_name = static_cast<daw::wmi::string_pool::id_t>( sequence % 3 );
+		row.category = static_cast<daw::wmi::string_pool::id_t>( sequence % 2 );
+		row.event_code = 0 == sequence % 2 ? 4624 : 4647;
+		row.logon_id = sequence;
+		return row;
+	}
+
+	void check_equal( daw::wmi::result_row const & lhs, daw::wmi::result_row const & rhs ) {
+		BOOST_CHECK_EQUAL( lhs.timestamp, rhs.timestamp );
+		BOOST_CHECK_EQUAL( lhs.utc_offset, rhs.utc_offset );
+		BOOST_CHECK_EQUAL( lhs.user_name, rhs.user_name );
+		BOOST_CHECK_EQUAL( lhs.computer_name, rhs.computer_name );
+		BOOST_CHECK_EQUAL( lhs.category, rhs.category );
+		BOOST_CHECK_EQUAL( lhs.event_code, rhs.event_code );
+		BOOST_CHECK_EQUAL( lhs.logon_id, rhs.logon_id );
+	}
+
+	// Rows of n distinct times, each time used by several rows that are
+	// added out of time order
+	std::vector<daw::wmi::result_row> make_rows( size_t const count ) {
+		std::vector<daw::wmi::result_row> rows;
+		for( size_t n = 0; n < count; ++n ) {
+			rows.push_back( make_row( static_cast<int64_t>( (n * 7919) % 997 ) * 1000000, n ) );
+		}
+		return rows;
+	}
+
+	std::vector<daw::wmi::result_row> merge_all( daw::wmi::external_row_sort & sorter ) {
+		std::vector<daw::wmi::result_row> result;
+		sorter.merge_to( [&result]( daw::wmi::result_row const & row ) {
+			result.push_back( row );
+		} );
+		return result;
+	}
+
+	// In time order and, as logon_id is the order added, rows at the same
+	// time in the order added
+	void check_sorted( std::vector<daw::wmi::result_row> const & rows ) {
+		for( size_t n = 1; n < rows.size( ); ++n ) {
+			BOOST_REQUIRE( rows[n - 1].timestamp <= rows[n].timestamp );
+			if( rows[n - 1].timestamp == rows[n].timestamp ) {
+				BOOST_REQUIRE( rows[n - 1].logon_id < rows[n].logon_id );
+			}
+		}
+	}
+}	// namespace anonymous
+
+BOOST_AUTO_TEST_CASE( run_round_trip ) {
+	temp_directory directory;
+	auto const file_name = (directory.path / "round_trip.run").string( );
+	std::vector<daw::wmi::result_row> rows;
+	rows.push_back( make_row( 1500000000000000, 1 ) );
+	rows.push_back( make_row( 1400000000000000, 2 ) );	// going back in time
+	rows.push_back( make_row( 1400000000000000, 3 ) );
+	rows.push_back( make_row( -5, 4 ) );
+	rows.push_back( make_row( (std::numeric_limits<int64_t>::max)( ), 5 ) );
+	rows.push_back( make_row( (std::numeric_limits<int64_t>::min)( ), 6 ) );
+	rows[0].utc_offset = -720;
+	rows[1].utc_offset = 840;
+	rows[2].event_code = -1;
+	rows[3].user_name = (std::numeric_limits<daw::wmi::string_pool::id_t>::max)( );
+	rows[4].logon_id = (std::numeric_limits<uint64_t>::max)( );
+	rows[5].utc_offset = (std::numeric_limits<int16_t>::min)( );
+	rows[5].event_code = (std::numeric_limits<int>::min)( );
+	{
+		daw::wmi::impl::run_writer writer( file_name );
+		for( auto const & row : rows ) {
+			writer.write( row );
+		}
+		writer.close( );
+	}
+	// Small read buffers so rows straddle them
+	daw::wmi::impl::run_reader reader( file_name, rows.size( ), 3 );
+	for( auto const & expected : rows ) {
+		daw::wmi::result_row row;
+		BOOST_REQUIRE( reader.next( row ) );
+		check_equal( row, expected );
+	}
+	daw::wmi::result_row row;
+	BOOST_CHECK( !reader.next( row ) );
+}
+
+BOOST_AUTO_TEST_CASE( truncated_run_throws ) {
+	temp_directory directory;
+	auto const file_name = (directory.path / "truncated.run").string( );
+	{
+		daw::wmi::impl::run_writer writer( file_name );
+		for( uint64_t n = 0; n < 100; ++n ) {
+			writer.write( make_row( static_cast<int64_t>( n ) * 1000000, n ) );
+		}
+		writer.close( );
+	}
+	boost::filesystem::resize_file( file_name, boost::filesystem::file_size( file_name ) - 3 );
+
+	daw::wmi::impl::run_reader reader( file_name, 100, daw::wmi::external_row_sort::read_buffer_size );
+	daw::wmi::result_row row;
+	for( size_t n = 0; n < 99; ++n ) {
+		BOOST_REQUIRE( reader.next( row ) );
+	}
+	BOOST_CHECK_THROW( reader.next( row ), std::runtime_error );
+}
+
+BOOST_AUTO_TEST_CASE( fits_in_memory ) {
+	temp_directory directory;
+	daw::wmi::external_row_sort sorter( 64 * 1024 * 1024, directory.path.string( ) );
+	auto const rows = make_rows( 5000 );
+	sorter.add( rows );
+	BOOST_CHECK_EQUAL( sorter.run_count( ), 0u );
+	auto const result = merge_all( sorter );
+	BOOST_CHECK_EQUAL( result.size( ), rows.size( ) );
+	check_sorted( result );
+}
+
+BOOST_AUTO_TEST_CASE( spills_and_merges_in_several_passes ) {
+	temp_directory directory;
+	auto const rows = make_rows( 50000 );
+	{
+		// The smallest limit keeps 1024 rows in memory and merges two runs at a time
+		daw::wmi::external_row_sort sorter( 1, directory.path.string( ) );
+		for( auto const & row : rows ) {
+			sorter.add( row );
+		}
+		BOOST_CHECK_EQUAL( sorter.run_count( ), rows.size( ) / 1024 );
+		BOOST_CHECK_EQUAL( directory.file_count( ), sorter.run_count( ) );
+
+		auto const result = merge_all( sorter );
+		BOOST_REQUIRE_EQUAL( result.size( ), rows.size( ) );
+		check_sorted( result );
+		for( auto const & row : result ) {
+			check_equal( row, rows[row.logon_id] );
+		}
+		// Merged down to the one run merged with the rows in memory
+		BOOST_CHECK_EQUAL( sorter.run_count( ), 1u );
+		BOOST_CHECK_EQUAL( directory.file_count( ), 1u );
+	}
+	BOOST_CHECK_EQUAL( directory.file_count( ), 0u );
+}
+
+BOOST_AUTO_TEST_CASE( run_files_removed_on_destruction ) {
+	temp_directory directory;
+	{
+		daw::wmi::external_row_sort sorter( 1, directory.path.string( ) );
+		sorter.add( make_rows( 10000 ) );
+		auto const group = sorter.open_group( );
+		sorter.add( group, make_rows( 5000 ) );
+		BOOST_CHECK( 0 < directory.file_count( ) );
+	}
+	BOOST_CHECK_EQUAL( directory.file_count( ), 0u );
+}
+
+BOOST_AUTO_TEST_CASE( groups_committed_or_discarded ) {
+	temp_directory directory;
+	daw::wmi::external_row_sort sorter( 1, directory.path.string( ) );
+	auto const rows = make_rows( 12000 );
+	auto const kept = sorter.open_group( );
+	auto const dropped = sorter.open_group( );
+	for( auto const & row : rows ) {
+		if( 0 == row.logon_id % 3 ) {
+			sorter.add( dropped, row );
+		} else {
+			sorter.add( kept, row );
+		}
+	}
+	auto const runs = sorter.run_count( );
+	BOOST_CHECK( 0 < runs );
+	sorter.discard( dropped );
+	BOOST_CHECK( sorter.run_count( ) < runs );
+	BOOST_CHECK_EQUAL( directory.file_count( ), sorter.run_count( ) );
+	sorter.commit( kept );
+	BOOST_CHECK_THROW( sorter.commit( kept ), std::invalid_argument );
+	BOOST_CHECK_THROW( sorter.add( dropped, rows.front( ) ), std::out_of_range );
+
+	auto const result = merge_all( sorter );
+	BOOST_CHECK_EQUAL( result.size( ), rows.size( ) - (rows.size( ) + 2) / 3 );
+	check_sorted( result );
+	for( auto const & row : result ) {
+		BOOST_REQUIRE( 0 != row.logon_id % 3 );
+	}
+}
@@ -46,10 +46,25 @@ namespace daw {
 			ptr = bstr;
 		}
 
-		ComSmartBtr::ComSmartBtr( boost::wstring_ref str ) {
-			assert( std::numeric_limits<int>::max( ) >= str.size( ) );
-			auto bstr = BSTR( str.data( ) );
-			ptr = bstr;
+		ComSmartBtr::ComSmartBtr( boost::wstring_ref str ): ptr( nullptr ) {
+			assert( std::numeric_limits<UINT>::max( ) >= str.size( ) );
+			// A BSTR has its own length prefixed copy, the destructor frees it
+			ptr = SysAllocStringLen( str.data( ), static_cast<UINT>(str.size( )) );
+		}
+
+		ComSmartBtr::ComSmartBtr( ComSmartBtr && other ): ptr( other.ptr ) {
+			other.ptr = nullptr;
+		}
+
+		ComSmartBtr & ComSmartBtr::operator=( ComSmartBtr && rhs ) {
+			if( this != &rhs ) {
+				if( ptr ) {
+					SysFreeString( ptr );
+				}
+				ptr = rhs.ptr;
+				rhs.ptr = nullptr;
+			}
+			return *this;
 		}
 
 		ComSmartBtr::operator BSTR( ) const {
@@ -61,23 +76,6 @@ namespace daw {
 				return VT_NULL == v.vt;
 			}
 
-			boost::optional<int> find_logon_type( std::wstring const & value ) {
-				auto result = daw::wmi::helpers::find_value<int>( value, L"Logon Type:" );
-				return result;
-			}
-
-			boost::optional<std::wstring> find_security_id( std::wstring const & value ) {
-				return daw::wmi::helpers::find_value<std::wstring>( value, L"Security ID:" );
-			}
-
-			boost::optional<std::wstring> find_account_name( std::wstring const & value ) {
-				return daw::wmi::helpers::find_value<std::wstring>( value, L"Account Name:" );
-			}
-
-			boost::optional<std::wstring> find_account_domain( std::wstring const & value ) {
-				return daw::wmi::helpers::find_value<std::wstring>( value, L"Account Domain:" );
-			}
-
 			std::wstring get_string( VARIANT const & v ) {
 				daw::wmi::helpers::validate_variant_type( v, VT_BSTR );
 				return std::wstring( v.bstrVal, SysStringLen( v.bstrVal ) );
@@ -94,6 +92,61 @@ namespace daw {
 				return true;
 			}
 
+			bool get_property( ComSmartPtr<IWbemClassObject> & pclsObj, boost::wstring_ref property_name, std::vector<std::wstring> & out_values ) {
+				CComVariant vtProp;
+				auto hr = pclsObj->Get( property_name.data( ), 0, &vtProp, nullptr, nullptr );
+				if( FAILED( hr ) ) {
+					std::wcerr << L"Error code = 0x" << std::hex << hr << std::endl;
+					return false;
+				}
+				if( VT_NULL == vtProp.vt || VT_EMPTY == vtProp.vt ) {
+					out_values.clear( );
+					return true;
+				}
+				helpers::validate_variant_type( vtProp, VT_ARRAY | VT_BSTR );
+				get_strings( vtProp.parray, out_values );
+				return true;
+			}
+
+			void get_strings( SAFEARRAY * values, std::vector<std::wstring> & out_values ) {
+				if( nullptr == values ) {
+					out_values.clear( );
+					return;
+				}
+				if( 1 != SafeArrayGetDim( values ) ) {
+					throw std::runtime_error( "Expected a one dimensional array" );
+				}
+				VARTYPE type = VT_EMPTY;
+				if( FAILED( SafeArrayGetVartype( values, &type ) ) || VT_BSTR != type ) {
+					throw std::runtime_error( "Expected an array of strings" );
+				}
+				long first = 0;
+				long last = -1;
+				SafeArrayGetLBound( values, 1, &first );
+				SafeArrayGetUBound( values, 1, &last );
+				auto const count = last >= first ? static_cast<size_t>(last - first) + 1 : 0;
+
+				// Reading the elements in place saves SafeArrayGetElement's copy of each BSTR
+				BSTR * elements = nullptr;
+				if( FAILED( SafeArrayAccessData( values, reinterpret_cast<void **>(&elements) ) ) ) {
+					throw std::runtime_error( "Could not access array" );
+				}
+				try {
+					out_values.resize( count );
+					for( size_t n = 0; n < count; ++n ) {
+						if( nullptr == elements[n] ) {
+							out_values[n].clear( );
+						} else {
+							out_values[n].assign( elements[n], SysStringLen( elements[n] ) );
+						}
+					}
+				} catch( ... ) {
+					SafeArrayUnaccessData( values );
+					throw;
+				}
+				SafeArrayUnaccessData( values );
+			}
+
 			bool equal_eh( boost::optional<std::wstring> const & value1, boost::wstring_ref const value2 ) {
 				auto const & v1 = *value1;
 				auto result = static_cast<bool>(value1);
@@ -101,23 +154,6 @@ namespace daw {
 				return result;
 			}
 
-			std::wstring parse_stringtime( boost::wstring_ref time_string ) {
-				std::wstringstream wss;
-
-				auto year = time_string.substr( 0, 4 );
-				auto month = time_string.substr( 4, 2 );
-				auto day = time_string.substr( 6, 2 );
-				auto hour = time_string.substr( 8, 2 );
-				auto minute = time_string.substr( 10, 2 );
-				auto second = time_string.substr( 12, 2 );
-
-				wss << year << L"/" << month;
-				wss << L"/" << day << L"/" << hour;
-				wss << L":" << minute << L":" << second;
-
-				return wss.str( );
-			}
-
 			BOOL is_elevated( ) {				
 				BOOL result = FALSE;
 				HANDLE token = nullptr;
@@ -38,6 +38,7 @@
 #include <sstream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #pragma comment(lib, "wbemuuid.lib")
 #pragma comment(lib, "credui.lib")
@@ -58,8 +59,8 @@ namespace daw {
 			ComSmartBtr( boost::wstring_ref str );
 			ComSmartBtr( ComSmartBtr const & ) = delete;
 			ComSmartBtr & operator=( ComSmartBtr const & ) = delete;
-			ComSmartBtr( ComSmartBtr && ) = default;
-			ComSmartBtr & operator=( ComSmartBtr && ) = default;
+			ComSmartBtr( ComSmartBtr && other );
+			ComSmartBtr & operator=( ComSmartBtr && rhs );
 			operator BSTR( ) const;
 		};
 
@@ -130,21 +131,36 @@ namespace daw {
 				}
 			}
 
-			ComSmartPtr( ComSmartPtr && ) = default;
-			ComSmartPtr & operator=( ComSmartPtr && ) = default;
+			ComSmartPtr( ComSmartPtr && other ): ptr( other.ptr ) {
+				other.ptr = nullptr;
+			}
+
+			ComSmartPtr & operator=( ComSmartPtr && rhs ) {
+				if( this != &rhs ) {
+					Release( );
+					ptr = rhs.ptr;
+					rhs.ptr = nullptr;
+				}
+				return *this;
+			}
 		};
 
 
 		namespace helpers {
 			bool is_null( VARIANT const & v );
-			boost::optional<int> find_logon_type( std::wstring const & value );
-			boost::optional<std::wstring> find_account_name( std::wstring const & value );
-			boost::optional<std::wstring> find_account_domain( std::wstring const & value );
-			boost::optional<std::wstring> find_security_id( std::wstring const & value );
 			bool get_property( ComSmartPtr<IWbemClassObject> & pclsObj, boost::wstring_ref property_name, std::wstring & out_value );
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Read a string array property.  A null value is read as
+			///				no strings.  Strings already in out_values are reused
+			///				so their buffers are too.
+			//////////////////////////////////////////////////////////////////////////
+			bool get_property( ComSmartPtr<IWbemClassObject> & pclsObj, boost::wstring_ref property_name, std::vector<std::wstring> & out_values );
+
+			/// Summary: Copy out a one dimensional SAFEARRAY of BSTR, null elements become empty strings
+			void get_strings( SAFEARRAY * values, std::vector<std::wstring> & out_values );
 			std::wstring get_string( VARIANT const & v );
 			bool equal_eh( boost::optional<std::wstring> const & value1, boost::wstring_ref const value2 );
-			std::wstring parse_stringtime( boost::wstring_ref time_string );
 
 			template<typename T>
 			void validate_variant_type( VARIANT const & v, T vt ) {
@@ -155,32 +171,6 @@ namespace daw {
 				}
 			}
 
-			template<typename T>
-			boost::optional<T> find_value( std::wstring const & value, boost::wstring_ref what ) {
-				auto pos = value.find( what.to_string( ), 0 );
-				if( std::wstring::npos == pos ) {
-					// No login type field
-					return boost::optional<T>( );
-				}
-				pos += what.size( );
-
-				pos = value.find_first_not_of( L" \t\r\n", pos );
-				if( std::wstring::npos == pos ) {
-					// No non-blanks
-					return boost::optional<T>( );
-				}
-				auto pos2 = value.find_first_of( L" \t\r\n", pos );
-				if( std::wstring::npos == pos2 ) {
-					// No non-blanks
-					return boost::optional<T>( );
-				}
-				std::wstringstream wss;
-				wss << value.substr( pos, pos2 - pos );
-				T result;
-				wss >> result;
-				return boost::optional<T>( result );
-			}
-
 			template<typename T, size_t Size>
 			struct secure_wipe_array {
 				T value[Size + 1];
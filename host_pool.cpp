@@ -0,0 +1,44 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "host_pool.h"
+
+#include <istream>
+
+namespace daw {
+	namespace wmi {
+		std::vector<std::wstring> read_host_list( std::wistream & in ) {
+			std::vector<std::wstring> result;
+			std::wstring line;
+			while( std::getline( in, line ) ) {
+				auto const first = line.find_first_not_of( L" \t\r" );
+				if( std::wstring::npos == first || L'#' == line[first] ) {
+					continue;
+				}
+				auto const last = line.find_last_not_of( L" \t\r" );
+				result.push_back( line.substr( first, last - first + 1 ) );
+			}
+			return result;
+		}
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,193 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iosfwd>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "run_stats.h"
+
+namespace daw {
+	namespace wmi {
+		struct host_error {
+			std::wstring host;
+			std::string message;
+		};	// struct host_error
+
+		template<typename T>
+		struct host_results {
+			std::vector<T> rows;
+			std::vector<host_error> errors;
+			size_t hosts_succeeded;
+		};	// struct host_results
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Per thread setup for query_hosts workers that need none
+		//////////////////////////////////////////////////////////////////////////
+		struct no_thread_scope { };
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Call task( n ) for every n in [0, count) on at most
+		///				max_workers threads.  Each thread constructs a
+		///				ThreadScope for its lifetime (e.g. to initialize COM).
+		///				Tasks only start once every thread has its ThreadScope;
+		///				if one throws no task is run and its error is rethrown
+		///				once the threads are done.  task must not throw.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename ThreadScope = no_thread_scope, typename Task>
+		void run_workers( size_t const count, size_t max_workers, Task task ) {
+			max_workers = std::max<size_t>( 1, std::min( max_workers, count ) );
+			std::atomic<size_t> next_task( 0 );
+			std::mutex started_mutex;
+			std::condition_variable all_started;
+			size_t started = 0;
+			std::exception_ptr scope_error;
+
+			auto const worker = [&]( ) {
+				// An exception escaping the thread would end the process
+				std::unique_ptr<ThreadScope const> scope;
+				std::exception_ptr error;
+				try {
+					scope = std::make_unique<ThreadScope const>( );
+				} catch( ... ) {
+					error = std::current_exception( );
+				}
+				{
+					// Callers such as read_rows_parallel need all their tasks
+					// running at once, so none start with a thread missing
+					std::unique_lock<std::mutex> lock( started_mutex );
+					if( error && !scope_error ) {
+						scope_error = error;
+					}
+					if( ++started == max_workers ) {
+						all_started.notify_all( );
+					} else {
+						all_started.wait( lock, [&]( ) {
+							return started == max_workers;
+						} );
+					}
+					if( scope_error ) {
+						return;
+					}
+				}
+				for( auto n = next_task++; n < count; n = next_task++ ) {
+					task( n );
+				}
+			};
+
+			std::vector<std::thread> workers;
+			workers.reserve( max_workers );
+			for( size_t n = 0; n < max_workers; ++n ) {
+				workers.emplace_back( worker );
+			}
+			for( auto & t : workers ) {
+				t.join( );
+			}
+			if( scope_error ) {
+				std::rethrow_exception( scope_error );
+			}
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Run query( host ) for every host on at most max_workers
+		///				threads.  Each thread constructs a ThreadScope for its
+		///				lifetime (e.g. to initialize COM).  Rows are returned
+		///				grouped by host in the order of hosts.  A host whose
+		///				query throws is reported in errors and does not affect
+		///				the others.  When a thread's ThreadScope throws every
+		///				host is reported with its error.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename T, typename ThreadScope = no_thread_scope, typename QueryFunction>
+		host_results<T> query_hosts( std::vector<std::wstring> const & hosts, size_t const max_workers, QueryFunction query ) {
+			std::vector<std::vector<T>> host_rows( hosts.size( ) );
+			std::vector<std::string> host_failures( hosts.size( ) );
+			std::vector<char> host_failed( hosts.size( ), 0 );
+
+			auto const fail_all = [&]( std::string const & message ) {
+				std::fill( host_failed.begin( ), host_failed.end( ), 1 );
+				std::fill( host_failures.begin( ), host_failures.end( ), message );
+				count_run( run_counter::errors, hosts.size( ) );
+			};
+
+			try {
+				run_workers<ThreadScope>( hosts.size( ), max_workers, [&]( size_t const n ) {
+					auto const stats = active_run_stats( );
+					auto const start = nullptr != stats ? run_stats::clock_t::now( ) : run_stats::clock_t::time_point( );
+					try {
+						host_rows[n] = query( hosts[n] );
+					} catch( std::exception const & ex ) {
+						host_failed[n] = 1;
+						host_failures[n] = ex.what( );
+					} catch( ... ) {
+						host_failed[n] = 1;
+						host_failures[n] = "Unknown error";
+					}
+					if( nullptr != stats ) {
+						stats->add_host_latency( hosts[n], run_stats::clock_t::now( ) - start );
+						if( host_failed[n] ) {
+							stats->add( run_counter::errors );
+						}
+					}
+				} );
+			} catch( std::exception const & ex ) {
+				fail_all( ex.what( ) );
+			} catch( ... ) {
+				fail_all( "Unknown error" );
+			}
+
+			host_results<T> result;
+			result.hosts_succeeded = 0;
+			size_t total = 0;
+			for( auto const & rows : host_rows ) {
+				total += rows.size( );
+			}
+			result.rows.reserve( total );
+			for( size_t n = 0; n < hosts.size( ); ++n ) {
+				if( host_failed[n] ) {
+					result.errors.push_back( host_error { hosts[n], std::move( host_failures[n] ) } );
+					continue;
+				}
+				++result.hosts_succeeded;
+				std::move( host_rows[n].begin( ), host_rows[n].end( ), std::back_inserter( result.rows ) );
+			}
+			return result;
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Read host names, one per line.  Blank lines and lines
+		///				starting with # are ignored
+		//////////////////////////////////////////////////////////////////////////
+		std::vector<std::wstring> read_host_list( std::wistream & in );
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,169 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Unit tests of query_hosts and run_workers with stand in hosts
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE host_pool
+#include <algorithm>
+#include <atomic>
+#include <boost/test/unit_test.hpp>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "host_pool.h"
+
+namespace {
+	std::vector<std::wstring> const hosts = { L"alpha", L"bravo", L"charlie", L"delta", L"echo", L"foxtrot" };
+
+	// Each host's rows are its index times 100 plus the row number
+	std::vector<int> host_rows( std::wstring const & host ) {
+		auto const index = static_cast<int>( std::find( hosts.begin( ), hosts.end( ), host ) - hosts.begin( ) );
+		std::vector<int> result;
+		for( int n = 0; n < 1 + index; ++n ) {
+			result.push_back( index * 100 + n );
+		}
+		return result;
+	}
+
+	// Fails setting up the second thread that constructs one
+	struct failing_thread_scope {
+		static std::atomic<int> constructed;
+
+		failing_thread_scope( ) {
+			if( 2 == ++constructed ) {
+				throw std::runtime_error( "CoInitializeEx failed" );
+			}
+		}
+	};	// struct failing_thread_scope
+
+	std::atomic<int> failing_thread_scope::constructed( 0 );
+}	// namespace anonymous
+
+BOOST_AUTO_TEST_CASE( run_workers_runs_every_task_once ) {
+	for( size_t const max_workers : { 1, 3, 8, 64 } ) {
+		std::vector<std::atomic<int>> runs( 50 );
+		for( auto & run : runs ) {
+			run = 0;
+		}
+		daw::wmi::run_workers( runs.size( ), max_workers, [&runs]( size_t const n ) {
+			++runs[n];
+		} );
+		for( auto const & run : runs ) {
+			BOOST_CHECK_EQUAL( run.load( ), 1 );
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE( run_workers_bounds_the_threads ) {
+	std::atomic<int> running( 0 );
+	std::atomic<int> most_running( 0 );
+	daw::wmi::run_workers( 20, 3, [&]( size_t ) {
+		auto const now_running = ++running;
+		auto most = most_running.load( );
+		while( now_running > most && !most_running.compare_exchange_weak( most, now_running ) ) { }
+		std::this_thread::sleep_for( std::chrono::milliseconds( 2 ) );
+		--running;
+	} );
+	BOOST_CHECK( most_running.load( ) <= 3 );
+	BOOST_CHECK( most_running.load( ) >= 1 );
+}
+
+BOOST_AUTO_TEST_CASE( run_workers_rethrows_a_scope_error ) {
+	failing_thread_scope::constructed = 0;
+	std::atomic<int> ran( 0 );
+	BOOST_CHECK_THROW( daw::wmi::run_workers<failing_thread_scope>( 10, 4, [&ran]( size_t ) {
+		++ran;
+	} ), std::runtime_error );
+	BOOST_CHECK_EQUAL( ran.load( ), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( rows_grouped_by_host_in_order ) {
+	for( size_t const max_workers : { 1, 2, 4, 16 } ) {
+		auto const results = daw::wmi::query_hosts<int>( hosts, max_workers, []( std::wstring const & host ) {
+			// Later hosts finish first
+			std::this_thread::sleep_for( std::chrono::milliseconds( 2 * static_cast<int>( hosts.size( ) - host_rows( host ).size( ) ) ) );
+			return host_rows( host );
+		} );
+		std::vector<int> expected;
+		for( auto const & host : hosts ) {
+			auto const rows = host_rows( host );
+			expected.insert( expected.end( ), rows.begin( ), rows.end( ) );
+		}
+		BOOST_CHECK( results.rows == expected );
+		BOOST_CHECK( results.errors.empty( ) );
+		BOOST_CHECK_EQUAL( results.hosts_succeeded, hosts.size( ) );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( failing_hosts_are_isolated ) {
+	auto const results = daw::wmi::query_hosts<int>( hosts, 3, []( std::wstring const & host ) -> std::vector<int> {
+		if( L"charlie" == host ) {
+			throw std::runtime_error( "The RPC server is unavailable." );
+		} else if( L"echo" == host ) {
+			throw 5;
+		}
+		return host_rows( host );
+	} );
+	std::vector<int> expected;
+	for( auto const & host : { L"alpha", L"bravo", L"delta", L"foxtrot" } ) {
+		auto const rows = host_rows( host );
+		expected.insert( expected.end( ), rows.begin( ), rows.end( ) );
+	}
+	BOOST_CHECK( results.rows == expected );
+	BOOST_CHECK_EQUAL( results.hosts_succeeded, 4u );
+	BOOST_REQUIRE_EQUAL( results.errors.size( ), 2u );
+	BOOST_CHECK( L"charlie" == results.errors[0].host );
+	BOOST_CHECK_EQUAL( results.errors[0].message, "The RPC server is unavailable." );
+	BOOST_CHECK( L"echo" == results.errors[1].host );
+	BOOST_CHECK_EQUAL( results.errors[1].message, "Unknown error" );
+}
+
+BOOST_AUTO_TEST_CASE( scope_error_fails_every_host ) {
+	failing_thread_scope::constructed = 0;
+	std::atomic<int> queried( 0 );
+	auto const results = daw::wmi::query_hosts<int, failing_thread_scope>( hosts, 4, [&queried]( std::wstring const & host ) {
+		++queried;
+		return host_rows( host );
+	} );
+	BOOST_CHECK_EQUAL( queried.load( ), 0 );
+	BOOST_CHECK( results.rows.empty( ) );
+	BOOST_CHECK_EQUAL( results.hosts_succeeded, 0u );
+	BOOST_REQUIRE_EQUAL( results.errors.size( ), hosts.size( ) );
+	for( size_t n = 0; n < hosts.size( ); ++n ) {
+		BOOST_CHECK( hosts[n] == results.errors[n].host );
+		BOOST_CHECK_EQUAL( results.errors[n].message, "CoInitializeEx failed" );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( host_list ) {
+	std::wistringstream in( L"alpha\n\n# retired\n  bravo \t\r\n\t# also retired\ncharlie" );
+	auto const result = daw::wmi::read_host_list( in );
+	BOOST_REQUIRE_EQUAL( result.size( ), 3u );
+	BOOST_CHECK( L"alpha" == result[0] );
+	BOOST_CHECK( L"bravo" == result[1] );
+	BOOST_CHECK( L"charlie" == result[2] );
+}
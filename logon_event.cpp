@@ -0,0 +1,74 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#include "logon_event.h"
+
+#include <string>
+
+namespace daw {
+	namespace wmi {
+		namespace {
+			template<typename Names>
+			row_result<result_row> make_row( logon_event const & event, Names & names ) {
+				// If logon(event ID 4624) make sure we are interactive(logon type 2)
+				if( 4624 == event.event_code && (!event.logon_type || 2 != *event.logon_type) ) {
+					return row_result<result_row>::skip( );
+				}
+
+				// We don't want the SYSTEM account
+				if( event.security_id == L"S-1-5-18" ) {
+					return row_result<result_row>::skip( );
+				}
+
+				result_row result;
+				result.event_code = event.event_code;
+				result.timestamp = event.timestamp;
+				result.utc_offset = event.utc_offset;
+				result.logon_id = event.logon_id;
+				result.computer_name = names.intern( event.computer_name );
+				result.category = names.intern( event.category );
+
+				// A boot is not about an account, only when and where it happened
+				if( 4608 == event.event_code ) {
+					return result;
+				}
+
+				thread_local std::wstring user_name;
+				user_name.assign( event.account_domain.data( ), event.account_domain.size( ) );
+				user_name += L'\\';
+				user_name.append( event.account_name.data( ), event.account_name.size( ) );
+				result.user_name = names.intern( user_name );
+				return result;
+			}
+		}	// namespace anonymous
+
+		row_result<result_row> make_logon_row( logon_event const & event, string_pool & names ) {
+			return make_row( event, names );
+		}
+
+		row_result<result_row> make_logon_row( logon_event const & event, string_pool_cache & names ) {
+			return make_row( event, names );
+		}
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,67 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cstdint>
+
+#include "result_row.h"
+#include "row_disposition.h"
+#include "string_pool.h"
+
+namespace daw {
+	namespace wmi {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	The parts of a 4624 logon, 4647 logoff or 4608 boot
+		///				that a row is made from, whichever source they were
+		///				read from.  The account is the one the event is
+		///				about.  Views are only needed until make_logon_row
+		///				returns.
+		//////////////////////////////////////////////////////////////////////////
+		struct logon_event {
+			int event_code = 0;
+			int64_t timestamp = 0;	// microseconds since 1970-01-01 UTC
+			int16_t utc_offset = 0;
+			boost::optional<int> logon_type;
+			boost::wstring_ref security_id;
+			boost::wstring_ref account_name;
+			boost::wstring_ref account_domain;
+			uint64_t logon_id = 0;
+			boost::wstring_ref computer_name;
+			boost::wstring_ref category;
+		};	// struct logon_event
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	The row for event, with its names interned in names,
+		///				or through a worker's cache of them.
+		///				Skips logons that are not interactive (logon type 2)
+		///				and events for the SYSTEM account.  A 4608 boot event
+		///				has no account and its row has no user_name.
+		//////////////////////////////////////////////////////////////////////////
+		row_result<result_row> make_logon_row( logon_event const & event, string_pool & names );
+		row_result<result_row> make_logon_row( logon_event const & event, string_pool_cache & names );
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,152 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "logon_statistics.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+#ifdef max
+#undef max
+#endif
+
+#ifdef min
+#undef min
+#endif
+
+namespace daw {
+	namespace wmi {
+		namespace {
+			int64_t const microseconds_per_hour = 3600LL * 1000000LL;
+			uint32_t const no_user = std::numeric_limits<uint32_t>::max( );
+
+			int64_t floor_div( int64_t const value, int64_t const divisor ) {
+				auto result = value / divisor;
+				if( value % divisor < 0 ) {
+					--result;
+				}
+				return result;
+			}
+		}	// namespace anonymous
+
+		logon_statistics::logon_statistics( ): m_user_index( ), m_users( ), m_events( ), m_logons( ), m_logoffs( ), m_first_seen( ), m_last_seen( ), m_hosts( ), m_user_hours( ), m_hour_of_day( ) {
+			m_hour_of_day.fill( 0 );
+		}
+
+		uint32_t logon_statistics::user_index( string_pool::id_t const user_name ) {
+			if( user_name >= m_user_index.size( ) ) {
+				m_user_index.resize( static_cast<size_t>(user_name) + 1, no_user );
+			}
+			auto & index = m_user_index[user_name];
+			if( no_user == index ) {
+				index = static_cast<uint32_t>(m_users.size( ));
+				m_users.push_back( user_name );
+				m_events.push_back( 0 );
+				m_logons.push_back( 0 );
+				m_logoffs.push_back( 0 );
+				m_first_seen.push_back( std::numeric_limits<int64_t>::max( ) );
+				m_last_seen.push_back( std::numeric_limits<int64_t>::min( ) );
+				m_hosts.emplace_back( );
+			}
+			return index;
+		}
+
+		void logon_statistics::add_host( uint32_t const user, string_pool::id_t const computer_name ) {
+			auto & hosts = m_hosts[user];
+			auto pos = std::lower_bound( hosts.begin( ), hosts.end( ), computer_name );
+			if( hosts.end( ) == pos || *pos != computer_name ) {
+				hosts.insert( pos, computer_name );
+			}
+		}
+
+		void logon_statistics::add( result_row const & row ) {
+			auto const user = user_index( row.user_name );
+			++m_events[user];
+			m_first_seen[user] = std::min( m_first_seen[user], row.timestamp );
+			m_last_seen[user] = std::max( m_last_seen[user], row.timestamp );
+			add_host( user, row.computer_name );
+			if( 4624 != row.event_code ) {
+				++m_logoffs[user];
+				return;
+			}
+			++m_logons[user];
+			auto const hour = floor_div( row.timestamp, microseconds_per_hour );
+			++m_user_hours[(static_cast<uint64_t>(user) << 32) | static_cast<uint32_t>(hour)];
+			auto const local_hour = floor_div( row.timestamp + row.utc_offset * 60LL * 1000000LL, microseconds_per_hour );
+			++m_hour_of_day[static_cast<size_t>(((local_hour % 24) + 24) % 24)];
+		}
+
+		void logon_statistics::merge( logon_statistics const & other ) {
+			std::vector<uint32_t> remap( other.m_users.size( ) );
+			for( size_t n = 0; n < other.m_users.size( ); ++n ) {
+				auto const user = user_index( other.m_users[n] );
+				remap[n] = user;
+				m_events[user] += other.m_events[n];
+				m_logons[user] += other.m_logons[n];
+				m_logoffs[user] += other.m_logoffs[n];
+				m_first_seen[user] = std::min( m_first_seen[user], other.m_first_seen[n] );
+				m_last_seen[user] = std::max( m_last_seen[user], other.m_last_seen[n] );
+				std::vector<string_pool::id_t> hosts;
+				std::set_union( m_hosts[user].begin( ), m_hosts[user].end( ), other.m_hosts[n].begin( ), other.m_hosts[n].end( ), std::back_inserter( hosts ) );
+				m_hosts[user] = std::move( hosts );
+			}
+			for( auto const & user_hour : other.m_user_hours ) {
+				auto const user = remap[static_cast<size_t>(user_hour.first >> 32)];
+				m_user_hours[(static_cast<uint64_t>(user) << 32) | (user_hour.first & 0xFFFFFFFFu)] += user_hour.second;
+			}
+			for( size_t n = 0; n < m_hour_of_day.size( ); ++n ) {
+				m_hour_of_day[n] += other.m_hour_of_day[n];
+			}
+		}
+
+		std::vector<user_summary> logon_statistics::users( ) const {
+			std::vector<user_summary> result;
+			result.reserve( m_users.size( ) );
+			for( size_t n = 0; n < m_users.size( ); ++n ) {
+				result.push_back( user_summary { m_users[n], m_events[n], m_logons[n], m_logoffs[n], m_hosts[n].size( ), m_first_seen[n], m_last_seen[n] } );
+			}
+			std::sort( result.begin( ), result.end( ), []( user_summary const & lhs, user_summary const & rhs ) {
+				return lhs.first_seen < rhs.first_seen;
+			} );
+			return result;
+		}
+
+		std::vector<user_hour_count> logon_statistics::user_hours( ) const {
+			std::vector<user_hour_count> result;
+			result.reserve( m_user_hours.size( ) );
+			for( auto const & user_hour : m_user_hours ) {
+				auto const hour = static_cast<int32_t>(user_hour.first & 0xFFFFFFFFu);
+				result.push_back( user_hour_count { m_users[static_cast<size_t>(user_hour.first >> 32)], hour * microseconds_per_hour, user_hour.second } );
+			}
+			std::sort( result.begin( ), result.end( ), []( user_hour_count const & lhs, user_hour_count const & rhs ) {
+				return lhs.hour < rhs.hour || (lhs.hour == rhs.hour && lhs.user_name < rhs.user_name);
+			} );
+			return result;
+		}
+
+		std::array<uint64_t, 24> const & logon_statistics::hour_of_day( ) const {
+			return m_hour_of_day;
+		}
+	}	// namespace wmi
+}	// namespace daw
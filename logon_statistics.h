@@ -0,0 +1,95 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "result_row.h"
+#include "string_pool.h"
+
+namespace daw {
+	namespace wmi {
+		struct user_summary {
+			string_pool::id_t user_name;
+			uint64_t events;
+			uint64_t logons;
+			uint64_t logoffs;
+			uint64_t distinct_hosts;
+			int64_t first_seen;
+			int64_t last_seen;
+		};	// struct user_summary
+
+		struct user_hour_count {
+			string_pool::id_t user_name;
+			int64_t hour;	// start of the UTC hour, microseconds since 1970-01-01 UTC
+			uint64_t logons;
+		};	// struct user_hour_count
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Logon statistics accumulated one row at a time.  Per user
+		///				values are kept as columns indexed by a dense user index
+		///				so memory grows with the number of users, user hours
+		///				and user hosts seen, never with the number of rows.
+		///				Instances built from different rows can be merged.
+		//////////////////////////////////////////////////////////////////////////
+		class logon_statistics {
+			std::vector<uint32_t> m_user_index;	// user id to dense index
+			std::vector<string_pool::id_t> m_users;
+			std::vector<uint64_t> m_events;
+			std::vector<uint64_t> m_logons;
+			std::vector<uint64_t> m_logoffs;
+			std::vector<int64_t> m_first_seen;
+			std::vector<int64_t> m_last_seen;
+			std::vector<std::vector<string_pool::id_t>> m_hosts;	// sorted
+			std::unordered_map<uint64_t, uint64_t> m_user_hours;	// dense index << 32 | hour
+			std::array<uint64_t, 24> m_hour_of_day;
+
+			uint32_t user_index( string_pool::id_t const user_name );
+			void add_host( uint32_t const user, string_pool::id_t const computer_name );
+
+		public:
+			logon_statistics( );
+			~logon_statistics( ) = default;
+			logon_statistics( logon_statistics const & ) = default;
+			logon_statistics & operator=( logon_statistics const & ) = default;
+			logon_statistics( logon_statistics && ) = default;
+			logon_statistics & operator=( logon_statistics && ) = default;
+
+			void add( result_row const & row );
+			void merge( logon_statistics const & other );
+
+			/// Summary: One entry per user, ordered by first seen
+			std::vector<user_summary> users( ) const;
+
+			/// Summary: Logons per user per UTC hour, ordered by hour then user
+			std::vector<user_hour_count> user_hours( ) const;
+
+			/// Summary: Logons by hour of the day in each host's local time
+			std::array<uint64_t, 24> const & hour_of_day( ) const;
+		};	// class logon_statistics
+	}	// namespace wmi
+}	// namespace daw
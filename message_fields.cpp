@@ -0,0 +1,302 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "message_fields.h"
+
+#include <cstdint>
+#include <limits>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || (defined( _M_IX86_FP ) && _M_IX86_FP >= 2)
+#define DAW_WMI_USE_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#ifdef max
+#undef max
+#endif
+
+namespace daw {
+	namespace wmi {
+		namespace {
+			using char_ptr = wchar_t const *;
+
+#ifdef DAW_WMI_USE_SSE2
+			inline unsigned lowest_set_bit( unsigned mask ) {
+#ifdef _MSC_VER
+				unsigned long result;
+				_BitScanForward( &result, mask );
+				return static_cast<unsigned>(result);
+#else
+				return static_cast<unsigned>(__builtin_ctz( mask ));
+#endif
+			}
+
+			inline __m128i compare_chars( __m128i block, __m128i c ) {
+				static_assert( sizeof( wchar_t ) == 2 || sizeof( wchar_t ) == 4, "Unsupported wchar_t size" );
+				return sizeof( wchar_t ) == 2 ? _mm_cmpeq_epi16( block, c ) : _mm_cmpeq_epi32( block, c );
+			}
+
+			inline __m128i splat_char( wchar_t c ) {
+				return sizeof( wchar_t ) == 2 ? _mm_set1_epi16( static_cast<short>(c) ) : _mm_set1_epi32( static_cast<int>(c) );
+			}
+#endif
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	First position in [first, last) holding c1 or c2, or last.
+			///				Messages are mostly long runs of text between the
+			///				delimiters, so compare a 16 byte block at a time
+			//////////////////////////////////////////////////////////////////////////
+			char_ptr find_either( char_ptr first, char_ptr const last, wchar_t const c1, wchar_t const c2 ) {
+#ifdef DAW_WMI_USE_SSE2
+				size_t const chars_per_block = sizeof( __m128i ) / sizeof( wchar_t );
+				auto const v1 = splat_char( c1 );
+				auto const v2 = splat_char( c2 );
+				while( static_cast<size_t>(last - first) >= chars_per_block ) {
+					auto const block = _mm_loadu_si128( reinterpret_cast<__m128i const *>(first) );
+					auto const matches = _mm_or_si128( compare_chars( block, v1 ), compare_chars( block, v2 ) );
+					auto const mask = static_cast<unsigned>(_mm_movemask_epi8( matches ));
+					if( 0 != mask ) {
+						return first + lowest_set_bit( mask ) / sizeof( wchar_t );
+					}
+					first += chars_per_block;
+				}
+#endif
+				for( ; first != last; ++first ) {
+					if( c1 == *first || c2 == *first ) {
+						break;
+					}
+				}
+				return first;
+			}
+
+			char_ptr find_char( char_ptr first, char_ptr const last, wchar_t const c ) {
+				return find_either( first, last, c, c );
+			}
+
+			bool is_blank( wchar_t const c ) {
+				return L' ' == c || L'\t' == c || L'\r' == c || L'\n' == c;
+			}
+
+			boost::wstring_ref trim( char_ptr first, char_ptr last ) {
+				while( first != last && is_blank( *first ) ) {
+					++first;
+				}
+				while( first != last && is_blank( *(last - 1) ) ) {
+					--last;
+				}
+				return boost::wstring_ref( first, static_cast<size_t>(last - first) );
+			}
+
+			enum class section_t { none, subject, new_logon, other };
+
+			section_t find_section( boost::wstring_ref const label ) {
+				if( label == L"Subject" ) {
+					return section_t::subject;
+				} else if( label == L"New Logon" ) {
+					return section_t::new_logon;
+				}
+				return section_t::other;
+			}
+
+			void set_once( boost::wstring_ref & field, boost::wstring_ref const value ) {
+				if( field.empty( ) ) {
+					field = value;
+				}
+			}
+
+			void set_account_field( account_fields & account, boost::wstring_ref const label, boost::wstring_ref const value ) {
+				if( label == L"Security ID" ) {
+					set_once( account.security_id, value );
+				} else if( label == L"Account Name" ) {
+					set_once( account.account_name, value );
+				} else if( label == L"Account Domain" ) {
+					set_once( account.account_domain, value );
+				} else if( label == L"Logon ID" ) {
+					set_once( account.logon_id, value );
+				}
+			}
+
+			// Positions in InsertionStrings of the event data of a 4624 logon
+			// and a 4647 logoff
+			namespace logon_data {
+				size_t const subject_user_sid = 0;
+				size_t const subject_user_name = 1;
+				size_t const subject_domain_name = 2;
+				size_t const subject_logon_id = 3;
+				size_t const target_user_sid = 4;
+				size_t const target_user_name = 5;
+				size_t const target_domain_name = 6;
+				size_t const target_logon_id = 7;
+				size_t const logon_type = 8;
+			}	// namespace logon_data
+
+			namespace logoff_data {
+				size_t const target_user_sid = 0;
+				size_t const target_user_name = 1;
+				size_t const target_domain_name = 2;
+				size_t const target_logon_id = 3;
+			}	// namespace logoff_data
+
+			boost::wstring_ref insertion_string( std::vector<std::wstring> const & insertion_strings, size_t const index ) {
+				if( index < insertion_strings.size( ) ) {
+					return insertion_strings[index];
+				}
+				return boost::wstring_ref( );
+			}
+
+			account_fields insertion_account( std::vector<std::wstring> const & insertion_strings, size_t const security_id, size_t const account_name, size_t const account_domain, size_t const logon_id ) {
+				account_fields result;
+				result.security_id = insertion_string( insertion_strings, security_id );
+				result.account_name = insertion_string( insertion_strings, account_name );
+				result.account_domain = insertion_string( insertion_strings, account_domain );
+				result.logon_id = insertion_string( insertion_strings, logon_id );
+				return result;
+			}
+
+			void set_section_field( message_fields & fields, section_t const section, boost::wstring_ref const label, boost::wstring_ref const value ) {
+				if( section_t::subject == section ) {
+					set_account_field( fields.subject, label, value );
+				} else if( section_t::new_logon == section ) {
+					set_account_field( fields.new_logon, label, value );
+				}
+			}
+		}	// namespace anonymous
+
+		account_fields const & message_fields::target_account( int const event_code ) const {
+			if( 4624 == event_code ) {
+				return new_logon;
+			}
+			return subject;
+		}
+
+		message_fields extract_message_fields( boost::wstring_ref message ) {
+			message_fields result;
+			auto section = section_t::none;
+			auto pos = message.data( );
+			auto const last = message.data( ) + message.size( );
+
+			while( pos != last ) {
+				auto const line_first = pos;
+				auto const delim = find_either( pos, last, L':', L'\n' );
+				if( delim == last ) {
+					break;
+				}
+				if( L'\n' == *delim ) {
+					// Line without a label, e.g. the event description
+					pos = delim + 1;
+					continue;
+				}
+				auto const line_last = find_char( delim + 1, last, L'\n' );
+				pos = line_last == last ? last : line_last + 1;
+
+				auto const label = trim( line_first, delim );
+				if( label.empty( ) ) {
+					continue;
+				}
+				auto const value = trim( delim + 1, line_last );
+				if( value.empty( ) ) {
+					// "Label:" alone starts a new section
+					section = find_section( label );
+					continue;
+				}
+				// Only labels starting with these can be fields we want
+				switch( label.front( ) ) {
+				case L'S':
+				case L'A':
+					set_section_field( result, section, label, value );
+					break;
+				case L'L':
+					// Top level before Windows 10, under "Logon Information:" since
+					if( label == L"Logon Type" ) {
+						set_once( result.logon_type, value );
+					} else {
+						set_section_field( result, section, label, value );
+					}
+					break;
+				default:
+					break;
+				}
+			}
+			return result;
+		}
+
+		message_fields extract_insertion_fields( int const event_code, std::vector<std::wstring> const & insertion_strings ) {
+			message_fields result;
+			if( 4624 == event_code ) {
+				using namespace logon_data;
+				result.subject = insertion_account( insertion_strings, subject_user_sid, subject_user_name, subject_domain_name, subject_logon_id );
+				result.new_logon = insertion_account( insertion_strings, target_user_sid, target_user_name, target_domain_name, target_logon_id );
+				result.logon_type = insertion_string( insertion_strings, logon_type );
+			} else if( 4647 == event_code ) {
+				using namespace logoff_data;
+				result.subject = insertion_account( insertion_strings, target_user_sid, target_user_name, target_domain_name, target_logon_id );
+			}
+			return result;
+		}
+
+		boost::optional<int> parse_int( boost::wstring_ref value ) {
+			if( value.empty( ) ) {
+				return boost::optional<int>( );
+			}
+			int result = 0;
+			for( auto const c : value ) {
+				if( c < L'0' || c > L'9' ) {
+					return boost::optional<int>( );
+				}
+				auto const digit = static_cast<int>(c - L'0');
+				if( result > (std::numeric_limits<int>::max( ) - digit) / 10 ) {
+					return boost::optional<int>( );
+				}
+				result = result * 10 + digit;
+			}
+			return boost::optional<int>( result );
+		}
+
+		boost::optional<uint64_t> parse_hex( boost::wstring_ref value ) {
+			if( value.size( ) > 2 && L'0' == value[0] && (L'x' == value[1] || L'X' == value[1]) ) {
+				value.remove_prefix( 2 );
+			}
+			if( value.empty( ) || value.size( ) > 2 * sizeof( uint64_t ) ) {
+				return boost::optional<uint64_t>( );
+			}
+			uint64_t result = 0;
+			for( auto const c : value ) {
+				uint64_t digit = 0;
+				if( c >= L'0' && c <= L'9' ) {
+					digit = static_cast<uint64_t>(c - L'0');
+				} else if( c >= L'a' && c <= L'f' ) {
+					digit = static_cast<uint64_t>(c - L'a' + 10);
+				} else if( c >= L'A' && c <= L'F' ) {
+					digit = static_cast<uint64_t>(c - L'A' + 10);
+				} else {
+					return boost::optional<uint64_t>( );
+				}
+				result = (result << 4) | digit;
+			}
+			return boost::optional<uint64_t>( result );
+		}
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,93 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace daw {
+	namespace wmi {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	The account lines of one section of an event Message.
+		///				Empty when the section or line was not present
+		//////////////////////////////////////////////////////////////////////////
+		struct account_fields {
+			boost::wstring_ref security_id;
+			boost::wstring_ref account_name;
+			boost::wstring_ref account_domain;
+			boost::wstring_ref logon_id;
+		};	// struct account_fields
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Fields of a logon/logoff event Message.  All values are
+		///				views into the message passed to extract_message_fields
+		///				and are only valid while it is.
+		//////////////////////////////////////////////////////////////////////////
+		struct message_fields {
+			account_fields subject;
+			account_fields new_logon;
+			boost::wstring_ref logon_type;
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	The account the event is about.  A 4624 logon names
+			///				the account under "New Logon:", its "Subject:" is
+			///				the process that requested the logon
+			//////////////////////////////////////////////////////////////////////////
+			account_fields const & target_account( int const event_code ) const;
+		};	// struct message_fields
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Find all the fields above in a single pass over message
+		///				without allocating.  Only the first occurrence of a
+		///				label within each section is kept.
+		//////////////////////////////////////////////////////////////////////////
+		message_fields extract_message_fields( boost::wstring_ref message );
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	The same fields from the InsertionStrings of an event,
+		///				its event data in the order the event code defines.
+		///				Unlike the Message they do not depend on the language
+		///				of the host.  A 4647 logoff's account is put in
+		///				subject, where its Message shows it.  Values are views
+		///				into insertion_strings; fields past its end are empty.
+		//////////////////////////////////////////////////////////////////////////
+		message_fields extract_insertion_fields( int const event_code, std::vector<std::wstring> const & insertion_strings );
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Parse a non-negative decimal integer that makes up all of
+		///				value.
+		//////////////////////////////////////////////////////////////////////////
+		boost::optional<int> parse_int( boost::wstring_ref value );
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Parse a hexadecimal integer with an optional 0x prefix,
+		///				as Logon ID values are written, that makes up all of
+		///				value.
+		//////////////////////////////////////////////////////////////////////////
+		boost::optional<uint64_t> parse_hex( boost::wstring_ref value );
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,134 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace daw {
+	namespace wmi {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Fixed size queue that any number of threads can push to
+		///				and pop from without locks.  Each cell carries a
+		///				sequence number saying whether it is ready to be
+		///				written or read in the current lap, so threads only
+		///				contend on the head or tail counter they advance.
+		///				capacity must be a power of 2.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename T>
+		class bounded_mpmc_queue {
+			struct cell_t {
+				std::atomic<size_t> sequence;
+				T value;
+			};
+
+			std::unique_ptr<cell_t[]> m_cells;
+			size_t m_mask;
+			alignas(64) std::atomic<size_t> m_tail;
+			alignas(64) std::atomic<size_t> m_head;
+
+		public:
+			explicit bounded_mpmc_queue( size_t const capacity ): m_cells( new cell_t[capacity] ), m_mask( capacity - 1 ), m_tail( 0 ), m_head( 0 ) {
+				assert( capacity >= 2 && 0 == (capacity & (capacity - 1)) );
+				for( size_t n = 0; n < capacity; ++n ) {
+					m_cells[n].sequence.store( n, std::memory_order_relaxed );
+				}
+			}
+			~bounded_mpmc_queue( ) = default;
+			bounded_mpmc_queue( bounded_mpmc_queue const & ) = delete;
+			bounded_mpmc_queue & operator=( bounded_mpmc_queue const & ) = delete;
+
+			/// Summary: Move value in unless the queue is full, then value is left alone
+			bool try_push( T & value ) {
+				auto pos = m_tail.load( std::memory_order_relaxed );
+				for( ;; ) {
+					auto & cell = m_cells[pos & m_mask];
+					auto const sequence = cell.sequence.load( std::memory_order_acquire );
+					auto const lap = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+					if( 0 == lap ) {
+						if( m_tail.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) {
+							cell.value = std::move( value );
+							cell.sequence.store( pos + 1, std::memory_order_release );
+							return true;
+						}
+					} else if( lap < 0 ) {
+						return false;
+					} else {
+						pos = m_tail.load( std::memory_order_relaxed );
+					}
+				}
+			}
+
+			/// Summary: Move the oldest value out, false when the queue is empty
+			bool try_pop( T & out_value ) {
+				auto pos = m_head.load( std::memory_order_relaxed );
+				for( ;; ) {
+					auto & cell = m_cells[pos & m_mask];
+					auto const sequence = cell.sequence.load( std::memory_order_acquire );
+					auto const lap = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+					if( 0 == lap ) {
+						if( m_head.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) {
+							out_value = std::move( cell.value );
+							cell.sequence.store( pos + m_mask + 1, std::memory_order_release );
+							return true;
+						}
+					} else if( lap < 0 ) {
+						return false;
+					} else {
+						pos = m_head.load( std::memory_order_relaxed );
+					}
+				}
+			}
+		};	// class bounded_mpmc_queue
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Waiting for a lock free queue.  Yields for a short while
+		///				then sleeps, so threads waiting through a slow network
+		///				round trip do not hold a core.
+		//////////////////////////////////////////////////////////////////////////
+		class spin_backoff {
+			unsigned m_count;
+
+		public:
+			spin_backoff( ): m_count( 0 ) { }
+
+			void wait( ) {
+				if( m_count < 64 ) {
+					++m_count;
+					std::this_thread::yield( );
+				} else {
+					std::this_thread::sleep_for( std::chrono::microseconds( 200 ) );
+				}
+			}
+
+			void reset( ) {
+				m_count = 0;
+			}
+		};	// class spin_backoff
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,128 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Unit tests of the lock free bounded_mpmc_queue
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE mpmc_queue
+#include <atomic>
+#include <boost/test/unit_test.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "mpmc_queue.h"
+
+BOOST_AUTO_TEST_CASE( full_and_empty ) {
+	daw::wmi::bounded_mpmc_queue<int> queue( 4 );
+	int value = 0;
+	BOOST_CHECK( !queue.try_pop( value ) );
+	// Around the ring several times
+	for( int lap = 0; lap < 5; ++lap ) {
+		for( int n = 0; n < 4; ++n ) {
+			int in = lap * 10 + n;
+			BOOST_REQUIRE( queue.try_push( in ) );
+		}
+		int extra = -1;
+		BOOST_CHECK( !queue.try_push( extra ) );
+		BOOST_CHECK_EQUAL( extra, -1 );
+		for( int n = 0; n < 4; ++n ) {
+			BOOST_REQUIRE( queue.try_pop( value ) );
+			BOOST_CHECK_EQUAL( value, lap * 10 + n );
+		}
+		BOOST_CHECK( !queue.try_pop( value ) );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( moves_values ) {
+	daw::wmi::bounded_mpmc_queue<std::unique_ptr<int>> queue( 2 );
+	auto in = std::make_unique<int>( 42 );
+	BOOST_REQUIRE( queue.try_push( in ) );
+	BOOST_CHECK( !in );
+	std::unique_ptr<int> out;
+	BOOST_REQUIRE( queue.try_pop( out ) );
+	BOOST_REQUIRE( out );
+	BOOST_CHECK_EQUAL( *out, 42 );
+}
+
+BOOST_AUTO_TEST_CASE( many_producers_and_consumers ) {
+	size_t const producers = 4;
+	size_t const consumers = 4;
+	uint64_t const per_producer = 50000;
+	daw::wmi::bounded_mpmc_queue<uint64_t> queue( 16 );
+	std::atomic<uint64_t> popped( 0 );
+	// What each consumer saw, so that every value is seen exactly once and
+	// each producer's values in the order pushed
+	std::vector<std::vector<uint64_t>> seen( consumers );
+
+	std::vector<std::thread> threads;
+	for( size_t producer = 0; producer < producers; ++producer ) {
+		threads.emplace_back( [&queue, producer, per_producer]( ) {
+			daw::wmi::spin_backoff backoff;
+			for( uint64_t n = 0; n < per_producer; ++n ) {
+				auto value = producer * per_producer + n;
+				while( !queue.try_push( value ) ) {
+					backoff.wait( );
+				}
+				backoff.reset( );
+			}
+		} );
+	}
+	for( size_t consumer = 0; consumer < consumers; ++consumer ) {
+		threads.emplace_back( [&, consumer]( ) {
+			daw::wmi::spin_backoff backoff;
+			uint64_t value = 0;
+			while( popped.load( ) < producers * per_producer ) {
+				if( queue.try_pop( value ) ) {
+					++popped;
+					seen[consumer].push_back( value );
+					backoff.reset( );
+				} else {
+					backoff.wait( );
+				}
+			}
+		} );
+	}
+	for( auto & t : threads ) {
+		t.join( );
+	}
+
+	std::vector<char> found( producers * per_producer, 0 );
+	for( auto const & values : seen ) {
+		std::vector<int64_t> last( producers, -1 );
+		for( auto const value : values ) {
+			BOOST_REQUIRE( value < found.size( ) );
+			BOOST_REQUIRE( 0 == found[value] );
+			found[value] = 1;
+			auto const producer = value / per_producer;
+			BOOST_REQUIRE( last[producer] < static_cast<int64_t>( value ) );
+			last[producer] = static_cast<int64_t>( value );
+		}
+	}
+	for( auto const f : found ) {
+		BOOST_REQUIRE( 1 == f );
+	}
+	uint64_t value = 0;
+	BOOST_CHECK( !queue.try_pop( value ) );
+}
@@ -0,0 +1,145 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace daw {
+	namespace wmi {
+		namespace impl {
+			size_t const min_run_length = 32;
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Split [first, last) into ascending runs and return the
+			///				offset of the end of each run.  Strictly descending
+			///				runs are reversed in place, which keeps the sort
+			///				stable.  Runs shorter than min_run_length are extended
+			///				with an insertion sort so random input does not
+			///				degenerate into many tiny runs.
+			//////////////////////////////////////////////////////////////////////////
+			template<typename Iterator, typename Compare>
+			std::vector<size_t> find_runs( Iterator first, Iterator last, Compare comp ) {
+				std::vector<size_t> run_ends;
+				auto const size = static_cast<size_t>(std::distance( first, last ));
+				size_t run_first = 0;
+				while( run_first < size ) {
+					auto run_last = run_first + 1;
+					if( run_last < size ) {
+						if( comp( first[run_last], first[run_first] ) ) {
+							while( run_last < size && comp( first[run_last], first[run_last - 1] ) ) {
+								++run_last;
+							}
+							std::reverse( first + run_first, first + run_last );
+						} else {
+							while( run_last < size && !comp( first[run_last], first[run_last - 1] ) ) {
+								++run_last;
+							}
+						}
+					}
+					auto const forced_last = std::min( size, run_first + min_run_length );
+					for( ; run_last < forced_last; ++run_last ) {
+						auto const pos = std::upper_bound( first + run_first, first + run_last, first[run_last], comp );
+						std::rotate( pos, first + run_last, first + run_last + 1 );
+					}
+					run_ends.push_back( run_last );
+					run_first = run_last;
+				}
+				return run_ends;
+			}
+		}	// namespace impl
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Stable sort that takes close to linear time when the input
+		///				is made of a few ascending or descending runs, such as
+		///				events returned newest first.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename Iterator, typename Compare = std::less<typename std::iterator_traits<Iterator>::value_type>>
+		void natural_merge_sort( Iterator first, Iterator last, Compare comp = Compare( ) ) {
+			auto run_ends = impl::find_runs( first, last, comp );
+			// Merge neighbouring runs pairwise until one is left
+			while( run_ends.size( ) > 1 ) {
+				std::vector<size_t> merged_ends;
+				merged_ends.reserve( run_ends.size( ) / 2 + 1 );
+				size_t run_first = 0;
+				for( size_t n = 0; n + 1 < run_ends.size( ); n += 2 ) {
+					std::inplace_merge( first + run_first, first + run_ends[n], first + run_ends[n + 1], comp );
+					run_first = run_ends[n + 1];
+					merged_ends.push_back( run_first );
+				}
+				if( run_ends.size( ) % 2 != 0 ) {
+					merged_ends.push_back( run_ends.back( ) );
+				}
+				run_ends = std::move( merged_ends );
+			}
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Pass the elements of [first, last) to output in stable
+		///				sorted order.  Output starts as soon as the runs are
+		///				known, after one linear pass, instead of after the whole
+		///				range is sorted.  The range is left partially reordered.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename Iterator, typename Output, typename Compare = std::less<typename std::iterator_traits<Iterator>::value_type>>
+		void merge_runs_to( Iterator first, Iterator last, Output output, Compare comp = Compare( ) ) {
+			auto const run_ends = impl::find_runs( first, last, comp );
+
+			using cursor_t = std::pair<size_t, size_t>;	// position, run end
+			// std heaps are max heaps, so order by greater.  Ties go to the earlier run
+			auto const heap_order = [&first, &comp]( cursor_t const & lhs, cursor_t const & rhs ) {
+				auto const & l = first[lhs.first];
+				auto const & r = first[rhs.first];
+				if( comp( r, l ) ) {
+					return true;
+				} else if( comp( l, r ) ) {
+					return false;
+				}
+				return lhs.first > rhs.first;
+			};
+			std::vector<cursor_t> heap;
+			heap.reserve( run_ends.size( ) );
+			size_t run_first = 0;
+			for( auto const run_end : run_ends ) {
+				heap.emplace_back( run_first, run_end );
+				run_first = run_end;
+			}
+			std::make_heap( heap.begin( ), heap.end( ), heap_order );
+
+			while( !heap.empty( ) ) {
+				std::pop_heap( heap.begin( ), heap.end( ), heap_order );
+				auto & cursor = heap.back( );
+				output( first[cursor.first] );
+				if( ++cursor.first < cursor.second ) {
+					std::push_heap( heap.begin( ), heap.end( ), heap_order );
+				} else {
+					heap.pop_back( );
+				}
+			}
+		}
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,368 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#include "output_writer.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "cim_datetime.h"
+
+namespace daw {
+	namespace wmi {
+		namespace {
+			size_t const max_int_digits = 20;
+
+			// Digits of value at the end of out, returns where they start
+			char * format_int( int64_t const value, char * const out_last ) {
+				auto pos = out_last;
+				auto magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+				do {
+					*(--pos) = static_cast<char>('0' + magnitude % 10);
+					magnitude /= 10;
+				} while( 0 != magnitude );
+				if( value < 0 ) {
+					*(--pos) = '-';
+				}
+				return pos;
+			}
+
+			bool is_high_surrogate( uint32_t const c ) {
+				return c >= 0xD800 && c <= 0xDBFF;
+			}
+
+			bool is_low_surrogate( uint32_t const c ) {
+				return c >= 0xDC00 && c <= 0xDFFF;
+			}
+
+			uint32_t const replacement_char = 0xFFFD;
+		}	// namespace anonymous
+
+		boost::optional<output_format> parse_output_format( boost::string_ref name ) {
+			if( name == "csv" ) {
+				return output_format::csv;
+			} else if( name == "json" ) {
+				return output_format::json;
+			} else if( name == "binary" ) {
+				return output_format::binary;
+			}
+			return boost::optional<output_format>( );
+		}
+
+		size_t const output_writer::default_buffer_size;
+
+		output_writer::output_writer( std::FILE * out, output_format const format, size_t const buffer_size ):
+				m_out( out ),
+				m_format( format ),
+				m_flush_size( buffer_size ),
+				m_buffer( ),
+				m_record_start( 0 ),
+				m_field_count( 0 ),
+				m_names_pool( nullptr ),
+				m_names( ),
+				m_names_cached( ) {
+
+			// Room for the last record to run past the flush size without moving
+			m_buffer.reserve( buffer_size + buffer_size / 4 );
+		}
+
+		output_writer::~output_writer( ) {
+			try {
+				flush( );
+			} catch( ... ) {
+				// Nowhere to report it from a destructor
+			}
+		}
+
+		output_format output_writer::format( ) const {
+			return m_format;
+		}
+
+		void output_writer::append( char const * first, size_t const size ) {
+			m_buffer.insert( m_buffer.end( ), first, first + size );
+		}
+
+		void output_writer::append( char const c ) {
+			m_buffer.push_back( c );
+		}
+
+		void output_writer::append_raw( void const * value, size_t const size ) {
+			// The binary format is little endian, as is every platform this runs on
+			append( static_cast<char const *>(value), size );
+		}
+
+		void output_writer::append_utf8( boost::wstring_ref value, bool const escape ) {
+			auto pos = value.begin( );
+			auto const last = value.end( );
+			while( pos != last ) {
+				auto code_point = static_cast<uint32_t>(*pos++);
+				if( code_point < 0x80 ) {
+					if( escape && ('"' == code_point || '\\' == code_point || code_point < 0x20) ) {
+						char const c = static_cast<char>(code_point);
+						append_escaped( boost::string_ref( &c, 1 ) );
+					} else {
+						append( static_cast<char>(code_point) );
+					}
+					continue;
+				}
+				if( is_high_surrogate( code_point ) ) {
+					if( pos != last && is_low_surrogate( static_cast<uint32_t>(*pos) ) ) {
+						code_point = 0x10000 + ((code_point - 0xD800) << 10) + (static_cast<uint32_t>(*pos++) - 0xDC00);
+					} else {
+						code_point = replacement_char;
+					}
+				} else if( is_low_surrogate( code_point ) || code_point > 0x10FFFF ) {
+					code_point = replacement_char;
+				}
+				char encoded[4];
+				size_t size = 0;
+				if( code_point < 0x800 ) {
+					encoded[0] = static_cast<char>(0xC0 | (code_point >> 6));
+					encoded[1] = static_cast<char>(0x80 | (code_point & 0x3F));
+					size = 2;
+				} else if( code_point < 0x10000 ) {
+					encoded[0] = static_cast<char>(0xE0 | (code_point >> 12));
+					encoded[1] = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+					encoded[2] = static_cast<char>(0x80 | (code_point & 0x3F));
+					size = 3;
+				} else {
+					encoded[0] = static_cast<char>(0xF0 | (code_point >> 18));
+					encoded[1] = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+					encoded[2] = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+					encoded[3] = static_cast<char>(0x80 | (code_point & 0x3F));
+					size = 4;
+				}
+				append( encoded, size );
+			}
+		}
+
+		void output_writer::append_escaped( boost::string_ref value ) {
+			if( output_format::binary == m_format ) {
+				append( value.data( ), value.size( ) );
+				return;
+			}
+			for( auto const c : value ) {
+				if( output_format::csv == m_format ) {
+					// Line breaks are fine inside a quoted field
+					if( '"' == c ) {
+						append( '"' );
+					}
+					append( c );
+					continue;
+				}
+				switch( c ) {
+				case '"':
+					append( "\\\"", 2 );
+					break;
+				case '\\':
+					append( "\\\\", 2 );
+					break;
+				case '\n':
+					append( "\\n", 2 );
+					break;
+				case '\r':
+					append( "\\r", 2 );
+					break;
+				case '\t':
+					append( "\\t", 2 );
+					break;
+				default:
+					if( static_cast<unsigned char>(c) < 0x20 ) {
+						static char const hex_digits[] = "0123456789abcdef";
+						char const escaped[] = { '\\', 'u', '0', '0', hex_digits[(c >> 4) & 0xF], hex_digits[c & 0xF] };
+						append( escaped, sizeof( escaped ) );
+					} else {
+						append( c );
+					}
+					break;
+				}
+			}
+		}
+
+		void output_writer::write_header( std::initializer_list<char const *> names ) {
+			if( output_format::csv != m_format ) {
+				return;
+			}
+			begin_record( );
+			for( auto const name : names ) {
+				string_field( name, boost::string_ref( name ) );
+			}
+			end_record( );
+		}
+
+		void output_writer::begin_record( ) {
+			m_record_start = m_buffer.size( );
+			m_field_count = 0;
+			switch( m_format ) {
+			case output_format::csv:
+				break;
+			case output_format::json:
+				append( '{' );
+				break;
+			case output_format::binary:
+				append_raw( "\0\0\0\0", sizeof( uint32_t ) );	// filled in by end_record
+				break;
+			}
+		}
+
+		void output_writer::begin_field( char const * name, char const binary_type ) {
+			switch( m_format ) {
+			case output_format::csv:
+				if( 0 != m_field_count ) {
+					append( ',' );
+				}
+				break;
+			case output_format::json:
+				if( 0 != m_field_count ) {
+					append( ',' );
+				}
+				append( '"' );
+				append_escaped( boost::string_ref( name ) );
+				append( "\":", 2 );
+				break;
+			case output_format::binary:
+				append( binary_type );
+				break;
+			}
+			++m_field_count;
+		}
+
+		void output_writer::begin_string_field( char const * name ) {
+			begin_field( name, 's' );
+			if( output_format::binary == m_format ) {
+				append_raw( "\0\0\0\0", sizeof( uint32_t ) );	// filled in by end_string_field
+			} else {
+				append( '"' );
+			}
+		}
+
+		void output_writer::end_string_field( size_t const value_start ) {
+			if( output_format::binary == m_format ) {
+				auto const size = static_cast<uint32_t>(m_buffer.size( ) - value_start);
+				std::memcpy( &m_buffer[value_start - sizeof( uint32_t )], &size, sizeof( size ) );
+			} else {
+				append( '"' );
+			}
+		}
+
+		void output_writer::string_field( char const * name, boost::wstring_ref value ) {
+			begin_string_field( name );
+			auto const value_start = m_buffer.size( );
+			append_utf8( value, true );
+			end_string_field( value_start );
+		}
+
+		void output_writer::string_field( char const * name, boost::string_ref value ) {
+			begin_string_field( name );
+			auto const value_start = m_buffer.size( );
+			append_escaped( value );
+			end_string_field( value_start );
+		}
+
+		void output_writer::name_field( char const * name, string_pool const & names, string_pool::id_t const id ) {
+			if( &names != m_names_pool ) {
+				m_names_pool = &names;
+				m_names.clear( );
+				m_names_cached.clear( );
+			}
+			if( id >= m_names.size( ) ) {
+				m_names.resize( static_cast<size_t>(id) + 1 );
+				m_names_cached.resize( static_cast<size_t>(id) + 1, false );
+			}
+			if( !m_names_cached[id] ) {
+				// Convert once, unescaped, and escape for the format each time it is written
+				auto const buffer_size = m_buffer.size( );
+				append_utf8( names.get( id ), false );
+				m_names[id].assign( m_buffer.begin( ) + static_cast<std::ptrdiff_t>(buffer_size), m_buffer.end( ) );
+				m_buffer.resize( buffer_size );
+				m_names_cached[id] = true;
+			}
+			string_field( name, boost::string_ref( m_names[id] ) );
+		}
+
+		void output_writer::int_field( char const * name, int64_t const value ) {
+			begin_field( name, 'i' );
+			if( output_format::binary == m_format ) {
+				append_raw( &value, sizeof( value ) );
+				return;
+			}
+			char digits[max_int_digits];
+			auto const digits_last = digits + max_int_digits;
+			auto const first = format_int( value, digits_last );
+			append( first, static_cast<size_t>(digits_last - first) );
+		}
+
+		void output_writer::time_field( char const * name, int64_t const timestamp, int16_t const utc_offset ) {
+			if( output_format::binary == m_format ) {
+				begin_field( name, 't' );
+				append_raw( &timestamp, sizeof( timestamp ) );
+				append_raw( &utc_offset, sizeof( utc_offset ) );
+				return;
+			}
+			begin_string_field( name );
+			char formatted[formatted_timestamp_size];
+			format_timestamp( timestamp, utc_offset, formatted );
+			append( formatted, formatted_timestamp_size );
+			append( '"' );
+		}
+
+		void output_writer::null_field( char const * name ) {
+			begin_field( name, 'n' );
+			if( output_format::json == m_format ) {
+				append( "null", 4 );
+			}
+		}
+
+		void output_writer::end_record( ) {
+			switch( m_format ) {
+			case output_format::csv:
+				append( '\n' );
+				break;
+			case output_format::json:
+				append( "}\n", 2 );
+				break;
+			case output_format::binary: {
+				auto const size = static_cast<uint32_t>(m_buffer.size( ) - m_record_start - sizeof( uint32_t ));
+				std::memcpy( &m_buffer[m_record_start], &size, sizeof( size ) );
+				break;
+			}
+			}
+			if( m_buffer.size( ) >= m_flush_size ) {
+				flush( );
+			}
+		}
+
+		void output_writer::flush( ) {
+			if( m_buffer.empty( ) ) {
+				return;
+			}
+			auto const size = m_buffer.size( );
+			auto const written = std::fwrite( m_buffer.data( ), 1, size, m_out );
+			m_buffer.clear( );
+			if( written != size || 0 != std::fflush( m_out ) ) {
+				throw std::runtime_error( "Error writing output" );
+			}
+		}
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,114 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "string_pool.h"
+
+namespace daw {
+	namespace wmi {
+		enum class output_format { csv, json, binary };
+
+		/// Summary: csv, json or binary
+		boost::optional<output_format> parse_output_format( boost::string_ref name );
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Formats records as UTF-8 into one large buffer and writes
+		///				it out in big blocks.  Records are written a field at a
+		///				time between begin_record and end_record as
+		///				csv:	RFC 4180, strings are always quoted and quotes
+		///						in them doubled.  One record per line
+		///				json:	one object per line, keyed by field name
+		///				binary:	per record a little endian uint32 byte count
+		///						followed by the fields, each a type byte then
+		///						's' uint32 byte count and UTF-8 bytes
+		///						'i' int64
+		///						't' int64 microseconds since 1970-01-01 UTC
+		///							and int16 UTC offset in minutes
+		///						'n' nothing, the value is not known
+		///				Nothing reaches the file until a record ends, so a
+		///				record is never split across writes.
+		//////////////////////////////////////////////////////////////////////////
+		class output_writer {
+			std::FILE * m_out;
+			output_format m_format;
+			size_t m_flush_size;
+			std::vector<char> m_buffer;
+			size_t m_record_start;
+			size_t m_field_count;
+			string_pool const * m_names_pool;
+			std::vector<std::string> m_names;	// UTF-8 of pool ids already written
+			std::vector<bool> m_names_cached;
+
+			void append( char const * first, size_t const size );
+			void append( char const c );
+			void append_raw( void const * value, size_t const size );
+			void append_utf8( boost::wstring_ref value, bool const escape );
+			void append_escaped( boost::string_ref value );
+			void begin_field( char const * name, char const binary_type );
+			void begin_string_field( char const * name );
+			void end_string_field( size_t const value_start );
+
+		public:
+			static size_t const default_buffer_size = 1024 * 1024;
+
+			output_writer( std::FILE * out, output_format const format, size_t const buffer_size = default_buffer_size );
+			~output_writer( );
+			output_writer( output_writer const & ) = delete;
+			output_writer & operator=( output_writer const & ) = delete;
+			output_writer( output_writer && ) = delete;
+			output_writer & operator=( output_writer && ) = delete;
+
+			output_format format( ) const;
+
+			/// Summary: A line of field names for csv, nothing for the other formats
+			void write_header( std::initializer_list<char const *> names );
+
+			void begin_record( );
+			void string_field( char const * name, boost::wstring_ref value );
+			void string_field( char const * name, boost::string_ref value );
+
+			/// Summary: The string with id in names.  Each id is converted to UTF-8 once
+			void name_field( char const * name, string_pool const & names, string_pool::id_t const id );
+			void int_field( char const * name, int64_t const value );
+
+			/// Summary: As YYYY/MM/DD/HH:MM:SS at utc_offset, binary keeps the numbers
+			void time_field( char const * name, int64_t const timestamp, int16_t const utc_offset );
+			void null_field( char const * name );
+			void end_record( );
+
+			/// Summary: Write out everything buffered.  Throws std::runtime_error if the write fails
+			void flush( );
+		};	// class output_writer
+	}	// namespace wmi
+}	// namespace daw
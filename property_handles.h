@@ -0,0 +1,77 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <boost/utility/string_ref.hpp>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace daw {
+	namespace wmi {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Handles to the properties of the objects one query
+		///				returns, which all share a class.  A handle is resolved
+		///				by name the first time a property is asked for and
+		///				reused for every later row.  Callbacks read the same
+		///				few properties in the same order each row, so the name
+		///				is first compared with the one after the last found.
+		///				Not thread safe, use one per query.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename Handle>
+		class property_handle_cache {
+			std::vector<std::pair<std::wstring, Handle>> m_handles;
+			size_t m_next;
+
+		public:
+			property_handle_cache( ): m_handles( ), m_next( 0 ) { }
+			~property_handle_cache( ) = default;
+			property_handle_cache( property_handle_cache const & ) = delete;
+			property_handle_cache & operator=( property_handle_cache const & ) = delete;
+			property_handle_cache( property_handle_cache && ) = default;
+			property_handle_cache & operator=( property_handle_cache && ) = default;
+
+			/// Summary: The handle of property_name, from resolve( property_name ) the first time
+			template<typename Resolve>
+			Handle get( boost::wstring_ref property_name, Resolve resolve ) {
+				if( m_next < m_handles.size( ) && property_name == m_handles[m_next].first ) {
+					return m_handles[m_next++].second;
+				}
+				for( size_t n = 0; n < m_handles.size( ); ++n ) {
+					if( property_name == m_handles[n].first ) {
+						m_next = n + 1;
+						return m_handles[n].second;
+					}
+				}
+				m_handles.emplace_back( property_name.to_string( ), resolve( property_name ) );
+				m_next = m_handles.size( );
+				return m_handles.back( ).second;
+			}
+
+			size_t size( ) const {
+				return m_handles.size( );
+			}
+		};	// class property_handle_cache
+	}	// namespace wmi
+}	// namespace daw
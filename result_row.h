@@ -0,0 +1,51 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <cstdint>
+
+#include "string_pool.h"
+
+namespace daw {
+	namespace wmi {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	One logon or logoff event.  Names are ids in the
+		///				string_pool the row was built with.
+		//////////////////////////////////////////////////////////////////////////
+		struct result_row {
+			int64_t timestamp = 0;	// microseconds since 1970-01-01 UTC
+			int16_t utc_offset = 0;	// minutes, as reported by the host that logged the event
+			string_pool::id_t user_name = 0;
+			string_pool::id_t computer_name = 0;
+			string_pool::id_t category = 0;
+			int event_code = 0;
+			uint64_t logon_id = 0;	// 0 when the event did not carry one
+
+			// operator< for sorting
+			bool operator<( result_row const & rhs ) const {
+				return timestamp < rhs.timestamp;
+			}
+		};	// struct result_row
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,124 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <type_traits>
+#include <utility>
+
+namespace daw {
+	namespace wmi {
+		enum class row_action { emit, skip, stop };
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	What a row callback wants done with a row.  Converting
+		///				from a T emits it, skip( ) drops the row and stop( )
+		///				drops it and ends processing.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename T>
+		class row_result {
+			row_action m_action;
+			boost::optional<T> m_value;
+
+			explicit row_result( row_action const action ): m_action( action ), m_value( ) { }
+
+		public:
+			row_result( T value ): m_action( row_action::emit ), m_value( std::move( value ) ) { }
+			~row_result( ) = default;
+			row_result( row_result const & ) = default;
+			row_result & operator=( row_result const & ) = default;
+			row_result( row_result && ) = default;
+			row_result & operator=( row_result && ) = default;
+
+			static row_result skip( ) {
+				return row_result( row_action::skip );
+			}
+
+			static row_result stop( ) {
+				return row_result( row_action::stop );
+			}
+
+			row_action action( ) const {
+				return m_action;
+			}
+
+			/// Summary: Only valid when action( ) is emit
+			T & value( ) {
+				return *m_value;
+			}
+		};	// class row_result
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Older callbacks return a T and throw these to skip a row
+		///				or stop processing.  They still work but pay for an
+		///				exception on every row they drop; return a row_result
+		///				instead.
+		//////////////////////////////////////////////////////////////////////////
+		struct SkipRowException {
+			SkipRowException( ) = default;
+			~SkipRowException( ) = default;
+			SkipRowException( SkipRowException const & ) = default;
+			SkipRowException( SkipRowException && ) = default;
+			SkipRowException & operator=( SkipRowException const & ) = default;
+			SkipRowException & operator=( SkipRowException && ) = default;
+		};	// struct SkipRowException
+
+		struct StopProcessingException {
+			StopProcessingException( ) = default;
+			~StopProcessingException( ) = default;
+			StopProcessingException( StopProcessingException const & ) = default;
+			StopProcessingException( StopProcessingException && ) = default;
+			StopProcessingException & operator=( StopProcessingException const & ) = default;
+			StopProcessingException & operator=( StopProcessingException && ) = default;
+		};	// struct StopProcessingException
+
+		namespace impl {
+			template<typename T, typename Callback, typename Arg>
+			row_result<T> invoke_row_callback( Callback & callback, Arg && arg, std::true_type ) {
+				return callback( std::forward<Arg>( arg ) );
+			}
+
+			template<typename T, typename Callback, typename Arg>
+			row_result<T> invoke_row_callback( Callback & callback, Arg && arg, std::false_type ) {
+				try {
+					return row_result<T>( callback( std::forward<Arg>( arg ) ) );
+				} catch( SkipRowException const & ) {
+					return row_result<T>::skip( );
+				} catch( StopProcessingException const & ) {
+					return row_result<T>::stop( );
+				}
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Call a row callback and get its row_result, whether it
+			///				returns one or returns a T and throws
+			//////////////////////////////////////////////////////////////////////////
+			template<typename T, typename Callback, typename Arg>
+			row_result<T> invoke_row_callback( Callback & callback, Arg && arg ) {
+				using returns_row_result = std::is_same<std::decay_t<decltype(callback( std::forward<Arg>( arg ) ))>, row_result<T>>;
+				return invoke_row_callback<T>( callback, std::forward<Arg>( arg ), returns_row_result { } );
+			}
+		}	// namespace impl
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,245 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "enumerator.h"
+#include "host_pool.h"
+#include "mpmc_queue.h"
+#include "row_disposition.h"
+#include "run_stats.h"
+
+namespace daw {
+	namespace wmi {
+		namespace impl {
+			/// Summary: invoke_row_callback, timed and counted in the active run_stats
+			template<typename T, typename Callback, typename Object>
+			row_result<T> read_row( Callback & callback, Object && obj ) {
+				auto result = [&]( ) {
+					phase_timer const timer( run_phase::callback );
+					return invoke_row_callback<T>( callback, std::forward<Object>( obj ) );
+				}( );
+				switch( result.action( ) ) {
+				case row_action::emit:
+					count_run( run_counter::rows_emitted );
+					break;
+				case row_action::skip:
+					count_run( run_counter::rows_skipped );
+					break;
+				case row_action::stop:
+					count_run( run_counter::rows_stopped );
+					break;
+				}
+				return result;
+			}
+		}	// namespace impl
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Pull every object from source and collect the rows
+		///				emitted by callback.  The next batch is fetched while
+		///				the callback works on the current one.  Row callbacks
+		///				do not care where their objects come from; they are
+		///				given a record, anything callable as
+		///				record( property_name, out_value ) that returns false
+		///				when it has no such property.  IWbemWrapper reads a
+		///				live WMI object and recorded_event a replayed one.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename T, typename Object, typename Callback>
+		std::vector<T> read_rows( object_enumerator<Object> & source, Callback callback, size_t const batch_size = default_batch_size ) {
+			prefetching_enumerator<Object> objects( source, batch_size );
+
+			std::vector<T> results;
+			Object current_obj;
+
+			while( objects.next( current_obj ) ) {
+				auto result = impl::read_row<T>( callback, std::move( current_obj ) );
+				if( row_action::stop == result.action( ) ) {
+					break;
+				} else if( row_action::emit == result.action( ) ) {
+					results.push_back( std::move( result.value( ) ) );
+				}
+			}
+			return results;
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	read_rows with the callbacks run on several threads.
+		///				One thread reads batches from source into a lock free
+		///				queue while workers take batches off it, so waiting on
+		///				the source overlaps with processing rows.  Worker n
+		///				calls make_callback( n ) once and uses the callback it
+		///				returns for all its rows; callbacks must not share
+		///				state that is not thread safe.  Shared state such as a
+		///				string_pool or external_row_sort takes a lock, so a
+		///				callback should intern through its own
+		///				string_pool_cache and hand rows on a block at a time.
+		///				Each worker keeps its own rows, which are put back in
+		///				source order at the end without locking.  A stop
+		///				keeps the rows that came before it, and
+		///				the first error is rethrown once all threads are done.
+		///				Every thread constructs a ThreadScope for its life.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename T, typename ThreadScope = no_thread_scope, typename Object, typename MakeCallback>
+		std::vector<T> read_rows_parallel( object_enumerator<Object> & source, size_t workers, MakeCallback make_callback, size_t const batch_size = default_batch_size ) {
+			struct batch_t {
+				size_t sequence;
+				std::vector<Object> objects;
+			};
+			struct batch_rows_t {
+				size_t sequence;
+				std::vector<T> rows;
+			};
+
+			workers = std::max<size_t>( 1, workers );
+			// Enough to keep every worker busy while the next batch is read
+			size_t capacity = 4;
+			while( capacity < 2 * workers ) {
+				capacity *= 2;
+			}
+			bounded_mpmc_queue<batch_t> batches( capacity );
+			std::atomic<bool> source_done( false );
+			// First batch that asked to stop or failed, later ones are dropped
+			std::atomic<size_t> stop_sequence( (std::numeric_limits<size_t>::max)( ) );
+			std::vector<std::exception_ptr> errors( workers + 1 );
+			std::vector<std::vector<batch_rows_t>> worker_rows( workers );
+
+			auto const stop_at = [&stop_sequence]( size_t const sequence ) {
+				auto current = stop_sequence.load( );
+				while( sequence < current && !stop_sequence.compare_exchange_weak( current, sequence ) ) { }
+			};
+
+			auto const read_source = [&]( ) {
+				try {
+					size_t sequence = 0;
+					bool more = true;
+					spin_backoff backoff;
+					while( more && sequence <= stop_sequence.load( ) ) {
+						batch_t batch { sequence, { } };
+						{
+							phase_timer const timer( run_phase::enumerate );
+							more = source.next_batch( batch.objects, batch_size );
+						}
+						if( batch.objects.empty( ) ) {
+							continue;
+						}
+						++sequence;
+						backoff.reset( );
+						while( !batches.try_push( batch ) ) {
+							if( batch.sequence > stop_sequence.load( ) ) {
+								break;
+							}
+							backoff.wait( );
+						}
+					}
+				} catch( ... ) {
+					errors[workers] = std::current_exception( );
+					stop_at( 0 );
+				}
+				source_done.store( true, std::memory_order_release );
+			};
+
+			auto const process = [&]( size_t const worker ) {
+				auto & rows = worker_rows[worker];
+				batch_t batch;
+				try {
+					auto callback = make_callback( worker );
+					spin_backoff backoff;
+					for( ;; ) {
+						// Everything was pushed before done was set
+						auto const done = source_done.load( std::memory_order_acquire );
+						if( !batches.try_pop( batch ) ) {
+							if( done ) {
+								break;
+							}
+							backoff.wait( );
+							continue;
+						}
+						backoff.reset( );
+						auto const sequence = batch.sequence;
+						if( sequence > stop_sequence.load( ) ) {
+							continue;
+						}
+						batch_rows_t result { sequence, { } };
+						for( auto & obj : batch.objects ) {
+							auto row = impl::read_row<T>( callback, std::move( obj ) );
+							if( row_action::stop == row.action( ) ) {
+								stop_at( sequence );
+								break;
+							} else if( row_action::emit == row.action( ) ) {
+								result.rows.push_back( std::move( row.value( ) ) );
+							}
+						}
+						rows.push_back( std::move( result ) );
+					}
+				} catch( ... ) {
+					// The reader gives up on a full queue once stopped
+					errors[worker] = std::current_exception( );
+					stop_at( 0 );
+				}
+			};
+
+			run_workers<ThreadScope>( workers + 1, workers + 1, [&]( size_t const n ) {
+				if( 0 == n ) {
+					read_source( );
+				} else {
+					process( n - 1 );
+				}
+			} );
+
+			for( auto const & error : errors ) {
+				if( error ) {
+					std::rethrow_exception( error );
+				}
+			}
+
+			std::vector<batch_rows_t *> ordered;
+			size_t total = 0;
+			auto const last = stop_sequence.load( );
+			for( auto & rows : worker_rows ) {
+				for( auto & batch_rows : rows ) {
+					if( batch_rows.sequence <= last ) {
+						ordered.push_back( &batch_rows );
+						total += batch_rows.rows.size( );
+					}
+				}
+			}
+			std::sort( ordered.begin( ), ordered.end( ), []( batch_rows_t const * lhs, batch_rows_t const * rhs ) {
+				return lhs->sequence < rhs->sequence;
+			} );
+			std::vector<T> results;
+			results.reserve( total );
+			for( auto batch_rows : ordered ) {
+				std::move( batch_rows->rows.begin( ), batch_rows->rows.end( ), std::back_inserter( results ) );
+			}
+			return results;
+		}
+	}	// namespace wmi
+}	// namespace daw
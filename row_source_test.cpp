@@ -0,0 +1,187 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Unit tests of read_rows and read_rows_parallel over a synthetic source
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE row_source
+#include <boost/test/unit_test.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "row_disposition.h"
+#include "row_source.h"
+#include "test_enumerator.h"
+
+namespace {
+	int const row_count = 10000;
+
+	// Keeps the numbers that are not multiples of 3, as their negatives so
+	// it is seen that the callback made the rows
+	daw::wmi::row_result<int> keep_some( int const n ) {
+		if( 0 == n % 3 ) {
+			return daw::wmi::row_result<int>::skip( );
+		}
+		return -n;
+	}
+
+	std::vector<int> expected_rows( int const last ) {
+		std::vector<int> result;
+		for( int n = 0; n < last; ++n ) {
+			auto row = keep_some( n );
+			if( daw::wmi::row_action::emit == row.action( ) ) {
+				result.push_back( row.value( ) );
+			}
+		}
+		return result;
+	}
+
+	size_t const worker_counts[] = { 1, 2, 3, 8 };
+	size_t const batch_sizes[] = { 1, 7, 256 };
+}	// namespace anonymous
+
+BOOST_AUTO_TEST_CASE( read_rows_in_source_order ) {
+	for( auto const batch_size : batch_sizes ) {
+		daw::wmi::counting_enumerator source( row_count );
+		auto const rows = daw::wmi::read_rows<int>( source, keep_some, batch_size );
+		BOOST_CHECK( rows == expected_rows( row_count ) );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( parallel_rows_in_source_order ) {
+	for( auto const workers : worker_counts ) {
+		for( auto const batch_size : batch_sizes ) {
+			for( auto const empty_last_batch : { true, false } ) {
+				daw::wmi::counting_enumerator source( row_count, empty_last_batch );
+				std::vector<size_t> made( workers, 0 );
+				auto const rows = daw::wmi::read_rows_parallel<int>( source, workers, [&made]( size_t const worker ) {
+					++made[worker];
+					return keep_some;
+				}, batch_size );
+				BOOST_CHECK_MESSAGE( rows == expected_rows( row_count ), "workers " << workers << " batch_size " << batch_size );
+				for( auto const count : made ) {
+					BOOST_CHECK_EQUAL( count, 1u );
+				}
+				BOOST_CHECK( !source.overlapped( ) );
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE( parallel_empty_source ) {
+	daw::wmi::counting_enumerator source( 0 );
+	auto const rows = daw::wmi::read_rows_parallel<int>( source, 4, []( size_t ) {
+		return keep_some;
+	} );
+	BOOST_CHECK( rows.empty( ) );
+}
+
+BOOST_AUTO_TEST_CASE( stop_keeps_the_rows_before_it ) {
+	// 5003 is in the middle of a batch for each batch size but 1
+	int const stop_at = 5003;
+	auto const callback = []( int const n ) {
+		if( stop_at == n ) {
+			return daw::wmi::row_result<int>::stop( );
+		}
+		return keep_some( n );
+	};
+	for( auto const batch_size : batch_sizes ) {
+		daw::wmi::counting_enumerator serial_source( row_count );
+		BOOST_CHECK( daw::wmi::read_rows<int>( serial_source, callback, batch_size ) == expected_rows( stop_at ) );
+		for( auto const workers : worker_counts ) {
+			daw::wmi::counting_enumerator source( row_count );
+			auto const rows = daw::wmi::read_rows_parallel<int>( source, workers, [&callback]( size_t ) {
+				return callback;
+			}, batch_size );
+			BOOST_CHECK_MESSAGE( rows == expected_rows( stop_at ), "workers " << workers << " batch_size " << batch_size );
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE( stop_by_exception ) {
+	auto const callback = []( int const n ) {
+		if( 0 == n % 3 ) {
+			throw daw::wmi::SkipRowException( );
+		} else if( 700 == n ) {
+			throw daw::wmi::StopProcessingException( );
+		}
+		return -n;
+	};
+	for( auto const workers : worker_counts ) {
+		daw::wmi::counting_enumerator source( row_count );
+		auto const rows = daw::wmi::read_rows_parallel<int>( source, workers, [&callback]( size_t ) {
+			return callback;
+		}, 64 );
+		BOOST_CHECK( rows == expected_rows( 700 ) );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( source_error_is_rethrown ) {
+	for( auto const workers : worker_counts ) {
+		daw::wmi::counting_enumerator source( row_count, true, 5 );
+		try {
+			daw::wmi::read_rows_parallel<int>( source, workers, []( size_t ) {
+				return keep_some;
+			}, 16 );
+			BOOST_ERROR( "read_rows_parallel did not throw" );
+		} catch( std::runtime_error const & e ) {
+			BOOST_CHECK_EQUAL( std::string( e.what( ) ), "source failed" );
+		}
+		// Reading ends at the error
+		BOOST_CHECK_EQUAL( source.batches( ), 6u );
+	}
+	daw::wmi::counting_enumerator serial_source( row_count, true, 5 );
+	BOOST_CHECK_THROW( daw::wmi::read_rows<int>( serial_source, keep_some, 16 ), std::runtime_error );
+}
+
+BOOST_AUTO_TEST_CASE( worker_error_is_rethrown ) {
+	auto const callback = []( int const n ) {
+		if( 4321 == n ) {
+			throw std::logic_error( "callback failed" );
+		}
+		return keep_some( n );
+	};
+	for( auto const workers : worker_counts ) {
+		for( auto const batch_size : batch_sizes ) {
+			daw::wmi::counting_enumerator source( row_count );
+			try {
+				daw::wmi::read_rows_parallel<int>( source, workers, [&callback]( size_t ) {
+					return callback;
+				}, batch_size );
+				BOOST_ERROR( "read_rows_parallel did not throw" );
+			} catch( std::logic_error const & e ) {
+				BOOST_CHECK_EQUAL( std::string( e.what( ) ), "callback failed" );
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE( make_callback_error_is_rethrown ) {
+	daw::wmi::counting_enumerator source( row_count );
+	BOOST_CHECK_THROW( daw::wmi::read_rows_parallel<int>( source, 3, []( size_t const worker ) {
+		if( 2 == worker ) {
+			throw std::logic_error( "no callback" );
+		}
+		return keep_some;
+	} ), std::logic_error );
+}
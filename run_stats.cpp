@@ -0,0 +1,220 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "run_stats.h"
+
+#include <boost/filesystem.hpp>
+#include <codecvt>
+#include <cstdio>
+#include <locale>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace daw {
+	namespace wmi {
+		namespace {
+#ifdef _WIN32
+			using utf8_convert = std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>>;
+#else
+			using utf8_convert = std::wstring_convert<std::codecvt_utf8<wchar_t>>;
+#endif
+
+			std::array<char const *, run_stats::phase_count> const phase_names = { { "connect", "execute", "enumerate", "callback", "sort", "output" } };
+			std::array<char const *, run_stats::counter_count> const counter_names = { { "rows_emitted", "rows_skipped", "rows_stopped", "errors", "message_bytes" } };
+
+			double to_seconds( uint64_t const nanoseconds ) {
+				return static_cast<double>(nanoseconds) / 1e9;
+			}
+
+			// Host names go in JSON strings and Prometheus label values, both
+			// of which escape \ and " and cannot hold a raw newline
+			std::string escape( std::string const & value ) {
+				std::string result;
+				for( auto const c : value ) {
+					if( '\\' == c || '"' == c ) {
+						result += '\\';
+						result += c;
+					} else if( '\n' == c ) {
+						result += "\\n";
+					} else {
+						result += c;
+					}
+				}
+				return result;
+			}
+
+			std::string bound_label( double const bound ) {
+				std::ostringstream ss;
+				ss << bound;
+				return ss.str( );
+			}
+		}	// namespace anonymous
+
+		namespace impl {
+			run_stats * g_active_run_stats = nullptr;
+		}	// namespace impl
+
+		void set_active_run_stats( run_stats * stats ) {
+			impl::g_active_run_stats = stats;
+		}
+
+		size_t const run_stats::phase_count;
+		size_t const run_stats::counter_count;
+		size_t const run_stats::latency_bucket_count;
+
+		std::array<double, run_stats::latency_bucket_count> const & run_stats::latency_bounds( ) {
+			static std::array<double, latency_bucket_count> const bounds = { { 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0 } };
+			return bounds;
+		}
+
+		run_stats::run_stats( ): m_phase_ns( ), m_phase_calls( ), m_counters( ), m_hosts_mutex( ), m_hosts( ) {
+			for( size_t n = 0; n < phase_count; ++n ) {
+				m_phase_ns[n] = 0;
+				m_phase_calls[n] = 0;
+			}
+			for( auto & counter : m_counters ) {
+				counter = 0;
+			}
+		}
+
+		void run_stats::add_time( run_phase const phase, clock_t::duration const elapsed ) {
+			auto const n = static_cast<size_t>(phase);
+			m_phase_ns[n].fetch_add( static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>( elapsed ).count( )), std::memory_order_relaxed );
+			m_phase_calls[n].fetch_add( 1, std::memory_order_relaxed );
+		}
+
+		void run_stats::add( run_counter const counter, uint64_t const amount ) {
+			m_counters[static_cast<size_t>(counter)].fetch_add( amount, std::memory_order_relaxed );
+		}
+
+		void run_stats::add_host_latency( boost::wstring_ref host, clock_t::duration const elapsed ) {
+			auto const seconds = std::chrono::duration_cast<std::chrono::duration<double>>( elapsed ).count( );
+			auto const & bounds = latency_bounds( );
+			size_t bucket = 0;
+			while( bucket < bounds.size( ) && bounds[bucket] < seconds ) {
+				++bucket;
+			}
+			auto name = utf8_convert( ).to_bytes( host.data( ), host.data( ) + host.size( ) );
+
+			std::lock_guard<std::mutex> lock( m_hosts_mutex );
+			auto position = m_hosts.find( name );
+			if( m_hosts.end( ) == position ) {
+				host_latency latency;
+				latency.buckets.fill( 0 );
+				latency.count = 0;
+				latency.sum_seconds = 0.0;
+				position = m_hosts.emplace( std::move( name ), latency ).first;
+			}
+			++position->second.buckets[bucket];
+			++position->second.count;
+			position->second.sum_seconds += seconds;
+		}
+
+		uint64_t run_stats::phase_nanoseconds( run_phase const phase ) const {
+			return m_phase_ns[static_cast<size_t>(phase)].load( std::memory_order_relaxed );
+		}
+
+		uint64_t run_stats::phase_calls( run_phase const phase ) const {
+			return m_phase_calls[static_cast<size_t>(phase)].load( std::memory_order_relaxed );
+		}
+
+		uint64_t run_stats::count( run_counter const counter ) const {
+			return m_counters[static_cast<size_t>(counter)].load( std::memory_order_relaxed );
+		}
+
+		void run_stats::write_json( std::ostream & out ) const {
+			out << "{\"phases\":{";
+			for( size_t n = 0; n < phase_count; ++n ) {
+				auto const phase = static_cast<run_phase>(n);
+				out << (0 == n ? "" : ",") << '"' << phase_names[n] << "\":{\"seconds\":" << to_seconds( phase_nanoseconds( phase ) ) << ",\"calls\":" << phase_calls( phase ) << '}';
+			}
+			out << '}';
+			for( size_t n = 0; n < counter_count; ++n ) {
+				out << ",\"" << counter_names[n] << "\":" << count( static_cast<run_counter>(n) );
+			}
+			out << ",\"hosts\":{";
+			std::lock_guard<std::mutex> lock( m_hosts_mutex );
+			bool first = true;
+			auto const & bounds = latency_bounds( );
+			for( auto const & host : m_hosts ) {
+				out << (first ? "" : ",") << '"' << escape( host.first ) << "\":{\"count\":" << host.second.count << ",\"sum_seconds\":" << host.second.sum_seconds << ",\"buckets\":{";
+				for( size_t n = 0; n < bounds.size( ); ++n ) {
+					out << '"' << bound_label( bounds[n] ) << "\":" << host.second.buckets[n] << ',';
+				}
+				out << "\"+Inf\":" << host.second.buckets[bounds.size( )] << "}}";
+				first = false;
+			}
+			out << "}}\n";
+		}
+
+		void run_stats::write_prometheus( std::string const & file_name ) const {
+			std::ostringstream ss;
+			ss << "# HELP who_is_on_phase_seconds_total Time spent in each phase of the run.\n";
+			ss << "# TYPE who_is_on_phase_seconds_total counter\n";
+			for( size_t n = 0; n < phase_count; ++n ) {
+				ss << "who_is_on_phase_seconds_total{phase=\"" << phase_names[n] << "\"} " << to_seconds( phase_nanoseconds( static_cast<run_phase>(n) ) ) << '\n';
+			}
+			ss << "# HELP who_is_on_phase_calls_total Times each phase was entered.\n";
+			ss << "# TYPE who_is_on_phase_calls_total counter\n";
+			for( size_t n = 0; n < phase_count; ++n ) {
+				ss << "who_is_on_phase_calls_total{phase=\"" << phase_names[n] << "\"} " << phase_calls( static_cast<run_phase>(n) ) << '\n';
+			}
+			for( size_t n = 0; n < counter_count; ++n ) {
+				ss << "# TYPE who_is_on_" << counter_names[n] << "_total counter\n";
+				ss << "who_is_on_" << counter_names[n] << "_total " << count( static_cast<run_counter>(n) ) << '\n';
+			}
+			ss << "# HELP who_is_on_host_query_seconds Time to query each host.\n";
+			ss << "# TYPE who_is_on_host_query_seconds histogram\n";
+			{
+				std::lock_guard<std::mutex> lock( m_hosts_mutex );
+				auto const & bounds = latency_bounds( );
+				for( auto const & host : m_hosts ) {
+					auto const label = "host=\"" + escape( host.first ) + '"';
+					uint64_t cumulative = 0;
+					for( size_t n = 0; n < bounds.size( ); ++n ) {
+						cumulative += host.second.buckets[n];
+						ss << "who_is_on_host_query_seconds_bucket{" << label << ",le=\"" << bound_label( bounds[n] ) << "\"} " << cumulative << '\n';
+					}
+					ss << "who_is_on_host_query_seconds_bucket{" << label << ",le=\"+Inf\"} " << host.second.count << '\n';
+					ss << "who_is_on_host_query_seconds_sum{" << label << "} " << host.second.sum_seconds << '\n';
+					ss << "who_is_on_host_query_seconds_count{" << label << "} " << host.second.count << '\n';
+				}
+			}
+
+			auto const contents = ss.str( );
+			auto const temp_name = file_name + ".tmp";
+			auto f = std::fopen( temp_name.c_str( ), "wb" );
+			if( nullptr == f ) {
+				throw std::runtime_error( "Could not create stats file " + temp_name );
+			}
+			auto const written = std::fwrite( contents.data( ), 1, contents.size( ), f );
+			auto const closed = 0 == std::fclose( f );
+			if( written != contents.size( ) || !closed ) {
+				boost::filesystem::remove( temp_name );
+				throw std::runtime_error( "Could not write stats file " + temp_name );
+			}
+			boost::filesystem::rename( temp_name, file_name );
+		}
+	}	// namespace wmi
+}	// namespace daw
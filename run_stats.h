@@ -0,0 +1,150 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <boost/utility/string_ref.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace daw {
+	namespace wmi {
+		enum class run_phase { connect, execute, enumerate, callback, sort, output };
+		enum class run_counter { rows_emitted, rows_skipped, rows_stopped, errors, message_bytes };
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Where a run spent its time and what it saw.  Phases
+		///				accumulate monotonic time and call counts, counters
+		///				add up and each host's query time goes into a latency
+		///				histogram.  Safe to add to from several threads.  Only
+		///				collected while it is the active_run_stats; with none
+		///				active every probe is a null check.
+		//////////////////////////////////////////////////////////////////////////
+		class run_stats {
+		public:
+			using clock_t = std::chrono::steady_clock;
+			static size_t const phase_count = 6;
+			static size_t const counter_count = 5;
+			static size_t const latency_bucket_count = 10;
+
+			/// Summary: Upper bounds of the host latency buckets in seconds, there is a last one for the rest
+			static std::array<double, latency_bucket_count> const & latency_bounds( );
+
+		private:
+			struct host_latency {
+				std::array<uint64_t, latency_bucket_count + 1> buckets;
+				uint64_t count;
+				double sum_seconds;
+			};	// struct host_latency
+
+			std::array<std::atomic<uint64_t>, phase_count> m_phase_ns;
+			std::array<std::atomic<uint64_t>, phase_count> m_phase_calls;
+			std::array<std::atomic<uint64_t>, counter_count> m_counters;
+			mutable std::mutex m_hosts_mutex;
+			std::map<std::string, host_latency> m_hosts;	// UTF-8 host names
+
+		public:
+			run_stats( );
+			~run_stats( ) = default;
+			run_stats( run_stats const & ) = delete;
+			run_stats & operator=( run_stats const & ) = delete;
+			run_stats( run_stats && ) = delete;
+			run_stats & operator=( run_stats && ) = delete;
+
+			void add_time( run_phase const phase, clock_t::duration const elapsed );
+			void add( run_counter const counter, uint64_t const amount = 1 );
+			void add_host_latency( boost::wstring_ref host, clock_t::duration const elapsed );
+
+			uint64_t phase_nanoseconds( run_phase const phase ) const;
+			uint64_t phase_calls( run_phase const phase ) const;
+			uint64_t count( run_counter const counter ) const;
+
+			/// Summary: Everything as one JSON object on a line
+			void write_json( std::ostream & out ) const;
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Write a Prometheus text format file for the node
+			///				exporter's textfile collector.  It is written next to
+			///				file_name and renamed over it so a scrape never sees
+			///				half of it.  Throws std::runtime_error on failure.
+			//////////////////////////////////////////////////////////////////////////
+			void write_prometheus( std::string const & file_name ) const;
+		};	// class run_stats
+
+		namespace impl {
+			extern run_stats * g_active_run_stats;
+		}	// namespace impl
+
+		/// Summary: The stats being collected into, nullptr when there are none
+		inline run_stats * active_run_stats( ) {
+			return impl::g_active_run_stats;
+		}
+
+		/// Summary: Collect into stats from now on, nullptr stops.  Set it before starting threads
+		void set_active_run_stats( run_stats * stats );
+
+		/// Summary: Add to counter of the active stats, if any
+		inline void count_run( run_counter const counter, uint64_t const amount = 1 ) {
+			auto const stats = active_run_stats( );
+			if( nullptr != stats ) {
+				stats->add( counter, amount );
+			}
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Adds the time from construction to destruction to phase
+		///				of the stats active when it was constructed.  Does not
+		///				read the clock when there are none.
+		//////////////////////////////////////////////////////////////////////////
+		class phase_timer {
+			run_stats * m_stats;
+			run_phase m_phase;
+			run_stats::clock_t::time_point m_start;
+
+		public:
+			explicit phase_timer( run_phase const phase ): m_stats( active_run_stats( ) ), m_phase( phase ), m_start( ) {
+				if( nullptr != m_stats ) {
+					m_start = run_stats::clock_t::now( );
+				}
+			}
+
+			~phase_timer( ) {
+				if( nullptr != m_stats ) {
+					m_stats->add_time( m_phase, run_stats::clock_t::now( ) - m_start );
+				}
+			}
+
+			phase_timer( phase_timer const & ) = delete;
+			phase_timer & operator=( phase_timer const & ) = delete;
+			phase_timer( phase_timer && ) = delete;
+			phase_timer & operator=( phase_timer && ) = delete;
+		};	// class phase_timer
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,148 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#include "session_tracker.h"
+
+#include <utility>
+
+namespace daw {
+	namespace wmi {
+		namespace {
+			bool is_logon( result_row const & row ) {
+				return 4624 == row.event_code;
+			}
+		}	// namespace anonymous
+
+		int64_t logon_session::sort_time( ) const {
+			return has_start ? start : end;
+		}
+
+		int64_t logon_session::duration( ) const {
+			return has_start && has_end ? end - start : 0;
+		}
+
+		size_t session_tracker::session_key_hash::operator( )( session_key const & key ) const {
+			// Logon IDs are mostly small counters, mix the bits before they meet the buckets
+			auto value = (key.logon_id ^ (static_cast<uint64_t>(key.computer_name) << 48)) * 0x9E3779B97F4A7C15ULL;
+			return static_cast<size_t>(value ^ (value >> 29));
+		}
+
+		int64_t const session_tracker::default_max_open;
+
+		session_tracker::session_tracker( int64_t const max_open ): m_max_open( max_open ), m_next_sequence( 0 ), m_open( ), m_pending( ), m_completed( ) { }
+
+		void session_tracker::close_unpaired( result_row const & row ) {
+			logon_session session;
+			session.user_name = row.user_name;
+			session.computer_name = row.computer_name;
+			session.logon_id = row.logon_id;
+			session.utc_offset = row.utc_offset;
+			session.has_start = is_logon( row );
+			session.has_end = !session.has_start;
+			session.start = session.has_start ? row.timestamp : 0;
+			session.end = session.has_end ? row.timestamp : 0;
+			m_completed.push_back( session );
+		}
+
+		void session_tracker::close_paired( result_row const & logon, result_row const & logoff ) {
+			logon_session session;
+			session.user_name = logon.user_name;
+			session.computer_name = logon.computer_name;
+			session.logon_id = logon.logon_id;
+			session.utc_offset = logon.utc_offset;
+			session.has_start = true;
+			session.has_end = true;
+			session.start = logon.timestamp;
+			session.end = logoff.timestamp;
+			m_completed.push_back( session );
+		}
+
+		void session_tracker::evict_stale( int64_t const now ) {
+			while( !m_pending.empty( ) ) {
+				auto const & oldest = m_pending.front( );
+				auto const age = now > oldest.timestamp ? now - oldest.timestamp : oldest.timestamp - now;
+				if( age <= m_max_open ) {
+					break;
+				}
+				auto pos = m_open.find( oldest.key );
+				// Entries already paired or replaced are left in the queue until they reach the front
+				if( m_open.end( ) != pos && pos->second.sequence == oldest.sequence ) {
+					close_unpaired( pos->second.row );
+					m_open.erase( pos );
+				}
+				m_pending.pop_front( );
+			}
+		}
+
+		void session_tracker::add( result_row const & row ) {
+			evict_stale( row.timestamp );
+			if( 0 == row.logon_id ) {
+				// Nothing to pair it by
+				close_unpaired( row );
+				return;
+			}
+			session_key const key{ row.computer_name, row.logon_id };
+			auto pos = m_open.find( key );
+			if( m_open.end( ) != pos ) {
+				auto const & other = pos->second.row;
+				if( is_logon( row ) != is_logon( other ) ) {
+					auto const & logon = is_logon( row ) ? row : other;
+					auto const & logoff = is_logon( row ) ? other : row;
+					if( logon.timestamp <= logoff.timestamp ) {
+						close_paired( logon, logoff );
+						m_open.erase( pos );
+						return;
+					}
+				}
+				// Same kind twice or out of order, the ID was reused after a reboot
+				close_unpaired( other );
+				m_open.erase( pos );
+			}
+			auto const sequence = m_next_sequence++;
+			m_open.emplace( key, open_event{ row, sequence } );
+			m_pending.push_back( pending{ key, row.timestamp, sequence } );
+		}
+
+		void session_tracker::finish( ) {
+			for( auto const & item : m_pending ) {
+				auto pos = m_open.find( item.key );
+				if( m_open.end( ) != pos && pos->second.sequence == item.sequence ) {
+					close_unpaired( pos->second.row );
+					m_open.erase( pos );
+				}
+			}
+			m_pending.clear( );
+		}
+
+		size_t session_tracker::open_count( ) const {
+			return m_open.size( );
+		}
+
+		std::vector<logon_session> session_tracker::take_completed( ) {
+			std::vector<logon_session> result;
+			std::swap( result, m_completed );
+			return result;
+		}
+	}	// namespace wmi
+}	// namespace daw
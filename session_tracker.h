@@ -0,0 +1,126 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "result_row.h"
+#include "string_pool.h"
+
+namespace daw {
+	namespace wmi {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	A logon paired with its logoff.  A session missing one
+		///				side, because it is still open or the other event was
+		///				not seen before the session went stale, has has_start
+		///				or has_end false and that time is 0.
+		//////////////////////////////////////////////////////////////////////////
+		struct logon_session {
+			string_pool::id_t user_name;
+			string_pool::id_t computer_name;
+			uint64_t logon_id;
+			int64_t start;	// microseconds since 1970-01-01 UTC
+			int64_t end;
+			int16_t utc_offset;	// minutes, of the host that logged the events
+			bool has_start;
+			bool has_end;
+
+			/// Summary: Time to sort sessions by, the start or the end when it is unknown
+			int64_t sort_time( ) const;
+
+			/// Summary: Microseconds between start and end.  0 unless both are known
+			int64_t duration( ) const;
+		};	// struct logon_session
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Pairs 4624 logons with 4647 logoffs by computer and
+		///				Logon ID as rows stream in, in either time order.  Only
+		///				unpaired events are held and one that is further than
+		///				max_open from the newest row is given up on and
+		///				reported on its own, so memory is bounded by the
+		///				sessions open within that window.
+		//////////////////////////////////////////////////////////////////////////
+		class session_tracker {
+			struct session_key {
+				string_pool::id_t computer_name;
+				uint64_t logon_id;
+
+				bool operator==( session_key const & rhs ) const {
+					return computer_name == rhs.computer_name && logon_id == rhs.logon_id;
+				}
+			};	// struct session_key
+
+			struct session_key_hash {
+				size_t operator( )( session_key const & key ) const;
+			};	// struct session_key_hash
+
+			struct open_event {
+				result_row row;
+				uint64_t sequence;
+			};	// struct open_event
+
+			struct pending {
+				session_key key;
+				int64_t timestamp;
+				uint64_t sequence;
+			};	// struct pending
+
+			int64_t m_max_open;
+			uint64_t m_next_sequence;
+			std::unordered_map<session_key, open_event, session_key_hash> m_open;
+			std::deque<pending> m_pending;	// open events in arrival order, may hold replaced ones
+			std::vector<logon_session> m_completed;
+
+			void evict_stale( int64_t const now );
+			void close_unpaired( result_row const & row );
+			void close_paired( result_row const & logon, result_row const & logoff );
+
+		public:
+			static int64_t const default_max_open = 7LL * 24LL * 3600LL * 1000000LL;
+
+			explicit session_tracker( int64_t const max_open = default_max_open );
+			~session_tracker( ) = default;
+			session_tracker( session_tracker const & ) = default;
+			session_tracker & operator=( session_tracker const & ) = default;
+			session_tracker( session_tracker && ) = default;
+			session_tracker & operator=( session_tracker && ) = default;
+
+			void add( result_row const & row );
+
+			/// Summary: Report every event still open as an unpaired session
+			void finish( );
+
+			/// Summary: Number of events waiting for their other half
+			size_t open_count( ) const;
+
+			/// Summary: Sessions closed since the last call, in the order they closed
+			std::vector<logon_session> take_completed( );
+		};	// class session_tracker
+	}	// namespace wmi
+}	// namespace daw
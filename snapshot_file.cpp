@@ -0,0 +1,332 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#include "snapshot_file.h"
+
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace daw {
+	namespace wmi {
+		namespace {
+			char const file_magic[8] = { 'W', 'I', 'O', 'S', 'N', 'A', 'P', '\0' };
+			char const footer_magic[8] = { 'W', 'I', 'O', 'S', 'N', 'A', 'P', 'E' };
+			uint32_t const file_version = 1;
+
+			enum section_kind: uint32_t {
+				timestamps = 1,
+				utc_offsets,
+				event_codes,
+				user_names,
+				computer_names,
+				categories,
+				logon_ids,
+				string_offsets,
+				string_data
+			};
+
+			struct section_entry {
+				uint32_t kind;
+				uint32_t reserved;
+				uint64_t offset;
+				uint64_t size;
+			};	// struct section_entry
+
+			struct footer_t {
+				uint64_t rows;
+				uint64_t strings;
+				uint32_t sections;
+				uint32_t version;
+				uint64_t index_offset;
+				char magic[8];
+			};	// struct footer_t
+
+			static_assert( sizeof( section_entry ) == 24, "section_entry must not be padded" );
+			static_assert( sizeof( footer_t ) == 40, "footer_t must not be padded" );
+
+			void sync_to_disk( std::FILE * f ) {
+#ifdef _WIN32
+				_commit( _fileno( f ) );
+#else
+				fsync( fileno( f ) );
+#endif
+			}
+
+			void append_utf16( std::vector<uint16_t> & out, boost::wstring_ref value ) {
+				for( auto const c : value ) {
+					auto const code_point = static_cast<uint32_t>(c);
+					if( code_point > 0xFFFF ) {
+						out.push_back( static_cast<uint16_t>(0xD800 + ((code_point - 0x10000) >> 10)) );
+						out.push_back( static_cast<uint16_t>(0xDC00 + ((code_point - 0x10000) & 0x3FF)) );
+					} else {
+						out.push_back( static_cast<uint16_t>(code_point) );
+					}
+				}
+			}
+
+			void assign_utf16( std::wstring & out, uint16_t const * first, uint16_t const * const last ) {
+				out.clear( );
+				while( first != last ) {
+					uint32_t code_point = *first++;
+					if( sizeof( wchar_t ) > 2 && code_point >= 0xD800 && code_point <= 0xDBFF && first != last && *first >= 0xDC00 && *first <= 0xDFFF ) {
+						code_point = 0x10000 + ((code_point - 0xD800) << 10) + (static_cast<uint32_t>(*first++) - 0xDC00);
+					}
+					out.push_back( static_cast<wchar_t>(code_point) );
+				}
+			}
+
+			class snapshot_output {
+				std::FILE * m_file;
+				uint64_t m_offset;
+				std::vector<section_entry> m_sections;
+
+				void write( void const * data, size_t const size ) {
+					if( 0 != size && std::fwrite( data, 1, size, m_file ) != size ) {
+						throw std::runtime_error( "Error writing snapshot" );
+					}
+					m_offset += size;
+				}
+
+			public:
+				explicit snapshot_output( std::FILE * f ): m_file( f ), m_offset( 0 ), m_sections( ) {
+					uint32_t const header[2] = { file_version, 0 };
+					write( file_magic, sizeof( file_magic ) );
+					write( header, sizeof( header ) );
+				}
+
+				void align( ) {
+					static char const padding[8] = { };
+					write( padding, static_cast<size_t>((8 - m_offset % 8) % 8) );
+				}
+
+				// One column of rows, gathered a block at a time
+				template<typename T, typename Get>
+				void column( section_kind const kind, std::vector<result_row> const & rows, Get get ) {
+					align( );
+					section_entry entry = { kind, 0, m_offset, rows.size( ) * sizeof( T ) };
+					std::vector<T> block;
+					size_t const block_size = 64 * 1024;
+					block.reserve( std::min( block_size, rows.size( ) ) );
+					for( size_t first = 0; first < rows.size( ); first += block_size ) {
+						auto const last = std::min( first + block_size, rows.size( ) );
+						block.clear( );
+						for( auto pos = first; pos != last; ++pos ) {
+							block.push_back( get( rows[pos] ) );
+						}
+						write( block.data( ), block.size( ) * sizeof( T ) );
+					}
+					m_sections.push_back( entry );
+				}
+
+				template<typename T>
+				void section( section_kind const kind, std::vector<T> const & values ) {
+					align( );
+					m_sections.push_back( section_entry{ kind, 0, m_offset, values.size( ) * sizeof( T ) } );
+					write( values.data( ), values.size( ) * sizeof( T ) );
+				}
+
+				void finish( uint64_t const rows, uint64_t const strings ) {
+					align( );
+					footer_t footer = { rows, strings, static_cast<uint32_t>(m_sections.size( )), file_version, m_offset, { } };
+					std::memcpy( footer.magic, footer_magic, sizeof( footer_magic ) );
+					write( m_sections.data( ), m_sections.size( ) * sizeof( section_entry ) );
+					write( &footer, sizeof( footer ) );
+				}
+			};	// class snapshot_output
+
+			[[noreturn]] void throw_bad_snapshot( std::string const & file_name, char const * reason ) {
+				throw std::runtime_error( "Invalid snapshot file " + file_name + ": " + reason );
+			}
+		}	// namespace anonymous
+
+		void write_snapshot( std::string const & file_name, string_pool const & names, std::vector<result_row> const & rows ) {
+			auto const temp_name = file_name + ".tmp";
+			auto f = std::fopen( temp_name.c_str( ), "wb" );
+			if( nullptr == f ) {
+				throw std::runtime_error( "Could not create snapshot file " + temp_name );
+			}
+			try {
+				snapshot_output out( f );
+				out.column<int64_t>( timestamps, rows, []( result_row const & row ) { return row.timestamp; } );
+				out.column<int16_t>( utc_offsets, rows, []( result_row const & row ) { return row.utc_offset; } );
+				out.column<int32_t>( event_codes, rows, []( result_row const & row ) { return static_cast<int32_t>(row.event_code); } );
+				out.column<uint32_t>( user_names, rows, []( result_row const & row ) { return row.user_name; } );
+				out.column<uint32_t>( computer_names, rows, []( result_row const & row ) { return row.computer_name; } );
+				out.column<uint32_t>( categories, rows, []( result_row const & row ) { return row.category; } );
+				out.column<uint64_t>( logon_ids, rows, []( result_row const & row ) { return row.logon_id; } );
+
+				std::vector<uint32_t> offsets;
+				std::vector<uint16_t> data;
+				offsets.reserve( names.size( ) + 1 );
+				for( string_pool::id_t id = 0; id < names.size( ); ++id ) {
+					offsets.push_back( static_cast<uint32_t>(data.size( )) );
+					append_utf16( data, names.get( id ) );
+				}
+				offsets.push_back( static_cast<uint32_t>(data.size( )) );
+				out.section( string_offsets, offsets );
+				out.section( string_data, data );
+				out.finish( rows.size( ), names.size( ) );
+
+				if( 0 != std::fflush( f ) ) {
+					throw std::runtime_error( "Error writing snapshot" );
+				}
+				sync_to_disk( f );
+			} catch( ... ) {
+				std::fclose( f );
+				boost::filesystem::remove( temp_name );
+				throw;
+			}
+			std::fclose( f );
+			// Replaces file_name atomically
+			boost::filesystem::rename( temp_name, file_name );
+		}
+
+		snapshot_file::snapshot_file( std::string const & file_name ):
+				m_file( ),
+				m_rows( 0 ),
+				m_strings( 0 ),
+				m_timestamps( nullptr ),
+				m_utc_offsets( nullptr ),
+				m_event_codes( nullptr ),
+				m_user_names( nullptr ),
+				m_computer_names( nullptr ),
+				m_categories( nullptr ),
+				m_logon_ids( nullptr ),
+				m_string_offsets( nullptr ),
+				m_string_data( nullptr ),
+				m_string_data_size( 0 ) {
+
+			try {
+				m_file.open( file_name );
+			} catch( std::exception const & ) {
+				throw std::runtime_error( "Could not open snapshot file " + file_name );
+			}
+			auto const data = m_file.data( );
+			auto const file_size = static_cast<uint64_t>(m_file.size( ));
+			if( file_size < sizeof( file_magic ) + 8 + sizeof( footer_t ) || 0 != std::memcmp( data, file_magic, sizeof( file_magic ) ) ) {
+				throw_bad_snapshot( file_name, "not a snapshot" );
+			}
+			footer_t footer;
+			std::memcpy( &footer, data + file_size - sizeof( footer_t ), sizeof( footer_t ) );
+			if( 0 != std::memcmp( footer.magic, footer_magic, sizeof( footer_magic ) ) ) {
+				throw_bad_snapshot( file_name, "truncated" );
+			}
+			if( file_version != footer.version ) {
+				throw_bad_snapshot( file_name, "unsupported version" );
+			}
+			if( footer.index_offset > file_size - sizeof( footer_t ) || footer.sections > (file_size - sizeof( footer_t ) - footer.index_offset) / sizeof( section_entry ) ) {
+				throw_bad_snapshot( file_name, "bad section index" );
+			}
+			m_rows = static_cast<size_t>(footer.rows);
+			m_strings = static_cast<size_t>(footer.strings);
+
+			auto const index = reinterpret_cast<section_entry const *>(data + footer.index_offset);
+			auto const find_section = [&]( uint32_t const kind, uint64_t const element_size, uint64_t const count ) -> void const * {
+				for( uint32_t n = 0; n < footer.sections; ++n ) {
+					auto const & entry = index[n];
+					if( kind != entry.kind ) {
+						continue;
+					}
+					if( entry.offset % 8 != 0 || entry.offset > file_size || entry.size > file_size - entry.offset || entry.size != element_size * count ) {
+						throw_bad_snapshot( file_name, "bad section" );
+					}
+					return data + entry.offset;
+				}
+				throw_bad_snapshot( file_name, "missing section" );
+			};
+			m_timestamps = static_cast<int64_t const *>(find_section( timestamps, sizeof( int64_t ), footer.rows ));
+			m_utc_offsets = static_cast<int16_t const *>(find_section( utc_offsets, sizeof( int16_t ), footer.rows ));
+			m_event_codes = static_cast<int32_t const *>(find_section( event_codes, sizeof( int32_t ), footer.rows ));
+			m_user_names = static_cast<uint32_t const *>(find_section( user_names, sizeof( uint32_t ), footer.rows ));
+			m_computer_names = static_cast<uint32_t const *>(find_section( computer_names, sizeof( uint32_t ), footer.rows ));
+			m_categories = static_cast<uint32_t const *>(find_section( categories, sizeof( uint32_t ), footer.rows ));
+			m_logon_ids = static_cast<uint64_t const *>(find_section( logon_ids, sizeof( uint64_t ), footer.rows ));
+			m_string_offsets = static_cast<uint32_t const *>(find_section( string_offsets, sizeof( uint32_t ), footer.strings + 1 ));
+
+			for( uint32_t n = 0; n < footer.sections; ++n ) {
+				if( string_data == index[n].kind && index[n].offset <= file_size && index[n].size <= file_size - index[n].offset ) {
+					m_string_data = reinterpret_cast<uint16_t const *>(data + index[n].offset);
+					m_string_data_size = static_cast<size_t>(index[n].size / sizeof( uint16_t ));
+				}
+			}
+			if( nullptr == m_string_data && 0 != m_strings ) {
+				throw_bad_snapshot( file_name, "missing section" );
+			}
+			for( size_t n = 0; n < m_strings; ++n ) {
+				if( m_string_offsets[n] > m_string_offsets[n + 1] || m_string_offsets[n + 1] > m_string_data_size ) {
+					throw_bad_snapshot( file_name, "bad dictionary" );
+				}
+			}
+		}
+
+		size_t snapshot_file::size( ) const {
+			return m_rows;
+		}
+
+		std::vector<result_row> snapshot_file::load( string_pool & names, int64_t const first, int64_t const last ) const {
+			// File ids to ids in names, interned as rows first use them
+			auto const not_interned = static_cast<string_pool::id_t>(-1);
+			std::vector<string_pool::id_t> ids( m_strings, not_interned );
+			std::wstring value;
+			auto const get_id = [&]( uint32_t const file_id ) {
+				if( file_id >= m_strings ) {
+					throw std::runtime_error( "Invalid snapshot file: name id out of range" );
+				}
+				auto & id = ids[file_id];
+				if( not_interned == id ) {
+					assign_utf16( value, m_string_data + m_string_offsets[file_id], m_string_data + m_string_offsets[file_id + 1] );
+					id = names.intern( value );
+				}
+				return id;
+			};
+
+			std::vector<result_row> result;
+			for( size_t n = 0; n < m_rows; ++n ) {
+				auto const timestamp = m_timestamps[n];
+				if( timestamp < first || timestamp >= last ) {
+					continue;
+				}
+				result_row row;
+				row.timestamp = timestamp;
+				row.utc_offset = m_utc_offsets[n];
+				row.event_code = m_event_codes[n];
+				row.user_name = get_id( m_user_names[n] );
+				row.computer_name = get_id( m_computer_names[n] );
+				row.category = get_id( m_categories[n] );
+				row.logon_id = m_logon_ids[n];
+				result.push_back( row );
+			}
+			return result;
+		}
+	}	// namespace wmi
+}	// namespace daw
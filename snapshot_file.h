@@ -0,0 +1,95 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#pragma once
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "result_row.h"
+#include "string_pool.h"
+
+namespace daw {
+	namespace wmi {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Write rows, which must be ids in names, as a columnar
+		///				snapshot.  All values are little endian and each
+		///				section starts on an 8 byte boundary
+		///				header:		"WIOSNAP\0", uint32 version, uint32 0
+		///				sections:	timestamp int64[rows], utc_offset int16[rows],
+		///							event_code int32[rows], user_name,
+		///							computer_name and category uint32[rows] as
+		///							ids into the dictionary, logon_id
+		///							uint64[rows], then the dictionary as
+		///							uint32 offsets[strings + 1] into UTF-16
+		///							code units uint16[]
+		///				footer:		per section uint32 kind, uint32 0,
+		///							uint64 offset, uint64 bytes, then uint64
+		///							rows, uint64 strings, uint32 sections,
+		///							uint32 version, uint64 offset of the first
+		///							section entry and "WIOSNAPE"
+		///				The file is written beside file_name and renamed over
+		///				it, so a failed write leaves any previous one alone.
+		//////////////////////////////////////////////////////////////////////////
+		void write_snapshot( std::string const & file_name, string_pool const & names, std::vector<result_row> const & rows );
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	A snapshot mapped into memory.  The columns are used in
+		///				place, only the dictionary is decoded when rows are
+		///				loaded.  Throws std::runtime_error if the file is not a
+		///				snapshot this version can read.
+		//////////////////////////////////////////////////////////////////////////
+		class snapshot_file {
+			boost::iostreams::mapped_file_source m_file;
+			size_t m_rows;
+			size_t m_strings;
+			int64_t const * m_timestamps;
+			int16_t const * m_utc_offsets;
+			int32_t const * m_event_codes;
+			uint32_t const * m_user_names;
+			uint32_t const * m_computer_names;
+			uint32_t const * m_categories;
+			uint64_t const * m_logon_ids;
+			uint32_t const * m_string_offsets;
+			uint16_t const * m_string_data;
+			size_t m_string_data_size;
+
+		public:
+			explicit snapshot_file( std::string const & file_name );
+			~snapshot_file( ) = default;
+			snapshot_file( snapshot_file const & ) = delete;
+			snapshot_file & operator=( snapshot_file const & ) = delete;
+			snapshot_file( snapshot_file && ) = default;
+			snapshot_file & operator=( snapshot_file && ) = default;
+
+			size_t size( ) const;
+
+			/// Summary: The rows with timestamps in [first, last), with their names interned into names
+			std::vector<result_row> load( string_pool & names, int64_t const first, int64_t const last ) const;
+		};	// class snapshot_file
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,277 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Unit tests of writing and loading columnar snapshot files
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE snapshot_file
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "snapshot_file.h"
+
+namespace {
+	// A file name in the temporary directory that is removed at the end of the test
+	struct temp_file {
+		boost::filesystem::path path;
+
+		temp_file( ): path( boost::filesystem::temp_directory_path( ) / boost::filesystem::unique_path( "who_is_on_test-%%%%-%%%%-%%%%.snapshot" ) ) { }
+
+		~temp_file( ) {
+			boost::system::error_code ec;
+			boost::filesystem::remove( path, ec );
+			boost::filesystem::remove( name( ) + ".tmp", ec );
+		}
+
+		std::string name( ) const {
+			return path.string( );
+		}
+
+		std::vector<char> read( ) const {
+			std::ifstream in( name( ), std::ios::binary );
+			return std::vector<char>( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>( ) );
+		}
+
+		void write( std::vector<char> const & data ) const {
+			std::ofstream out( name( ), std::ios::binary | std::ios::trunc );
+			out.write( data.data( ), static_cast<std::streamsize>( data.size( ) ) );
+		}
+	};	// struct temp_file
+
+	std::wstring to_wstring( boost::wstring_ref value ) {
+		return std::wstring( value.begin( ), value.end( ) );
+	}
+
+	daw::wmi::result_row make_row( int64_t const timestamp, daw::wmi::string_pool::id_t const user, daw::wmi::string_pool::id_t const computer, daw::wmi::string_pool::id_t const category ) {
+		daw::wmi::result_row row;
+		row.timestamp = timestamp;
+		row.utc_offset = static_cast<int16_t>( timestamp % 2 == 0 ? -300 : 330 );
+		row.user_name = user;
+		row.computer_name = computer;
+		row.category = category;
+		row.event_code = timestamp % 3 == 0 ? 4647 : 4624;
+		row.logon_id = 0x100000000ULL + static_cast<uint64_t>( timestamp );
+		return row;
+	}
+
+	// A snapshot of rows at timestamps 1000, 2000, ... 8000 over a few names
+	struct sample_snapshot {
+		temp_file file;
+		daw::wmi::string_pool names;
+		std::vector<daw::wmi::result_row> rows;
+
+		sample_snapshot( ) {
+			auto const alice = names.intern( L"CORP\\alice" );
+			auto const bob = names.intern( L"CORP\\böb-\U0001F600" );
+			auto const empty = names.intern( L"" );
+			auto const host = names.intern( L"host-日本.example" );
+			auto const logon = names.intern( L"Logon" );
+			auto const logoff = names.intern( L"Logoff" );
+			for( int64_t n = 1; n <= 8; ++n ) {
+				auto const user = n % 3 == 0 ? empty : (n % 2 == 0 ? bob : alice);
+				rows.push_back( make_row( n * 1000, user, host, n % 3 == 0 ? logoff : logon ) );
+			}
+			rows.back( ).logon_id = std::numeric_limits<uint64_t>::max( );
+			rows.front( ).timestamp = std::numeric_limits<int64_t>::min( ) + 1;
+			daw::wmi::write_snapshot( file.name( ), names, rows );
+		}
+	};	// struct sample_snapshot
+
+	void check_same_row( daw::wmi::result_row const & loaded, daw::wmi::string_pool const & loaded_names, daw::wmi::result_row const & expected, daw::wmi::string_pool const & expected_names ) {
+		BOOST_CHECK_EQUAL( loaded.timestamp, expected.timestamp );
+		BOOST_CHECK_EQUAL( loaded.utc_offset, expected.utc_offset );
+		BOOST_CHECK_EQUAL( loaded.event_code, expected.event_code );
+		BOOST_CHECK_EQUAL( loaded.logon_id, expected.logon_id );
+		BOOST_CHECK( to_wstring( loaded_names.get( loaded.user_name ) ) == to_wstring( expected_names.get( expected.user_name ) ) );
+		BOOST_CHECK( to_wstring( loaded_names.get( loaded.computer_name ) ) == to_wstring( expected_names.get( expected.computer_name ) ) );
+		BOOST_CHECK( to_wstring( loaded_names.get( loaded.category ) ) == to_wstring( expected_names.get( expected.category ) ) );
+	}
+
+	template<typename T>
+	void put( std::vector<char> & data, size_t const offset, T const value ) {
+		BOOST_REQUIRE( offset + sizeof( T ) <= data.size( ) );
+		std::memcpy( data.data( ) + offset, &value, sizeof( T ) );
+	}
+
+	bool rejected( std::string const & file_name, std::string const & reason ) {
+		try {
+			daw::wmi::snapshot_file snapshot( file_name );
+		} catch( std::runtime_error const & ex ) {
+			BOOST_TEST_MESSAGE( ex.what( ) );
+			return std::string( ex.what( ) ).find( reason ) != std::string::npos;
+		}
+		return false;
+	}
+
+	size_t const footer_size = 40;
+	size_t const footer_version = 20;
+	size_t const footer_index_offset = 24;
+}	// namespace anonymous
+
+BOOST_AUTO_TEST_CASE( write_load_round_trip ) {
+	sample_snapshot sample;
+	BOOST_CHECK( !boost::filesystem::exists( sample.file.name( ) + ".tmp" ) );
+
+	daw::wmi::snapshot_file snapshot( sample.file.name( ) );
+	BOOST_CHECK_EQUAL( snapshot.size( ), sample.rows.size( ) );
+
+	// Names already in the pool get other ids than in the file
+	daw::wmi::string_pool names;
+	names.intern( L"Logoff" );
+	names.intern( L"unrelated" );
+	auto const rows = snapshot.load( names, std::numeric_limits<int64_t>::min( ), std::numeric_limits<int64_t>::max( ) );
+	BOOST_REQUIRE_EQUAL( rows.size( ), sample.rows.size( ) );
+	for( size_t n = 0; n < rows.size( ); ++n ) {
+		check_same_row( rows[n], names, sample.rows[n], sample.names );
+	}
+	// Equal names share an id and only the names used were added
+	BOOST_CHECK_EQUAL( names.size( ), 2u + 5u );
+	BOOST_CHECK_EQUAL( rows[0].computer_name, rows[7].computer_name );
+	BOOST_CHECK_EQUAL( rows[2].category, 0u );
+	BOOST_CHECK_EQUAL( rows[1].user_name, rows[3].user_name );
+	BOOST_CHECK( rows[0].user_name != rows[1].user_name );
+	BOOST_CHECK( names.get( rows[2].user_name ).empty( ) );
+	BOOST_CHECK( to_wstring( names.get( rows[1].user_name ) ) == L"CORP\\böb-\U0001F600" );
+
+	// Loading into the same pool again gives the same ids
+	auto const again = snapshot.load( names, std::numeric_limits<int64_t>::min( ), std::numeric_limits<int64_t>::max( ) );
+	BOOST_REQUIRE_EQUAL( again.size( ), rows.size( ) );
+	for( size_t n = 0; n < rows.size( ); ++n ) {
+		BOOST_CHECK_EQUAL( again[n].user_name, rows[n].user_name );
+		BOOST_CHECK_EQUAL( again[n].computer_name, rows[n].computer_name );
+		BOOST_CHECK_EQUAL( again[n].category, rows[n].category );
+	}
+	BOOST_CHECK_EQUAL( names.size( ), 7u );
+}
+
+BOOST_AUTO_TEST_CASE( load_filters_by_time ) {
+	sample_snapshot sample;
+	daw::wmi::snapshot_file snapshot( sample.file.name( ) );
+
+	// since is included and until is not
+	daw::wmi::string_pool names;
+	auto const rows = snapshot.load( names, 3000, 6000 );
+	BOOST_REQUIRE_EQUAL( rows.size( ), 3u );
+	check_same_row( rows[0], names, sample.rows[2], sample.names );
+	check_same_row( rows[1], names, sample.rows[3], sample.names );
+	check_same_row( rows[2], names, sample.rows[4], sample.names );
+	// Only the names of the rows loaded are interned
+	BOOST_CHECK_EQUAL( names.size( ), 6u );
+
+	BOOST_CHECK( snapshot.load( names, 3001, 3002 ).empty( ) );
+	BOOST_CHECK( snapshot.load( names, 6000, 3000 ).empty( ) );
+	BOOST_CHECK_EQUAL( snapshot.load( names, std::numeric_limits<int64_t>::min( ), 2000 ).size( ), 1u );
+	BOOST_CHECK_EQUAL( snapshot.load( names, 8000, std::numeric_limits<int64_t>::max( ) ).size( ), 1u );
+}
+
+BOOST_AUTO_TEST_CASE( empty_snapshot ) {
+	temp_file file;
+	daw::wmi::string_pool empty_names;
+	daw::wmi::write_snapshot( file.name( ), empty_names, { } );
+
+	daw::wmi::snapshot_file snapshot( file.name( ) );
+	BOOST_CHECK_EQUAL( snapshot.size( ), 0u );
+	daw::wmi::string_pool names;
+	BOOST_CHECK( snapshot.load( names, std::numeric_limits<int64_t>::min( ), std::numeric_limits<int64_t>::max( ) ).empty( ) );
+	BOOST_CHECK_EQUAL( names.size( ), 0u );
+}
+
+BOOST_AUTO_TEST_CASE( write_replaces_previous_snapshot ) {
+	sample_snapshot sample;
+	std::vector<daw::wmi::result_row> rows( 1, sample.rows[4] );
+	daw::wmi::write_snapshot( sample.file.name( ), sample.names, rows );
+	BOOST_CHECK( !boost::filesystem::exists( sample.file.name( ) + ".tmp" ) );
+
+	daw::wmi::snapshot_file snapshot( sample.file.name( ) );
+	BOOST_REQUIRE_EQUAL( snapshot.size( ), 1u );
+	daw::wmi::string_pool names;
+	auto const loaded = snapshot.load( names, std::numeric_limits<int64_t>::min( ), std::numeric_limits<int64_t>::max( ) );
+	BOOST_REQUIRE_EQUAL( loaded.size( ), 1u );
+	check_same_row( loaded.front( ), names, rows.front( ), sample.names );
+}
+
+BOOST_AUTO_TEST_CASE( missing_file_throws ) {
+	temp_file file;
+	BOOST_CHECK( rejected( file.name( ), "Could not open" ) );
+}
+
+BOOST_AUTO_TEST_CASE( truncated_file_throws ) {
+	sample_snapshot sample;
+	auto data = sample.file.read( );
+	auto const full_size = data.size( );
+
+	data.resize( full_size - 1 );
+	sample.file.write( data );
+	BOOST_CHECK( rejected( sample.file.name( ), "truncated" ) );
+
+	data.resize( full_size / 2 );
+	sample.file.write( data );
+	BOOST_CHECK( rejected( sample.file.name( ), "truncated" ) );
+
+	data.resize( 12 );
+	sample.file.write( data );
+	BOOST_CHECK( rejected( sample.file.name( ), "not a snapshot" ) );
+}
+
+BOOST_AUTO_TEST_CASE( bad_magic_throws ) {
+	sample_snapshot sample;
+	auto data = sample.file.read( );
+	data[0] = 'X';
+	sample.file.write( data );
+	BOOST_CHECK( rejected( sample.file.name( ), "not a snapshot" ) );
+}
+
+BOOST_AUTO_TEST_CASE( unknown_version_throws ) {
+	sample_snapshot sample;
+	auto data = sample.file.read( );
+	put<uint32_t>( data, 8, 2 );
+	put<uint32_t>( data, data.size( ) - footer_size + footer_version, 2 );
+	sample.file.write( data );
+	BOOST_CHECK( rejected( sample.file.name( ), "unsupported version" ) );
+}
+
+BOOST_AUTO_TEST_CASE( footer_offset_past_end_throws ) {
+	sample_snapshot sample;
+	auto data = sample.file.read( );
+	auto const index_offset = data.size( ) - footer_size + footer_index_offset;
+
+	put<uint64_t>( data, index_offset, data.size( ) + 8 );
+	sample.file.write( data );
+	BOOST_CHECK( rejected( sample.file.name( ), "bad section index" ) );
+
+	put<uint64_t>( data, index_offset, std::numeric_limits<uint64_t>::max( ) );
+	sample.file.write( data );
+	BOOST_CHECK( rejected( sample.file.name( ), "bad section index" ) );
+
+	// Inside the file but leaving no room for the section entries
+	put<uint64_t>( data, index_offset, data.size( ) - footer_size - 8 );
+	sample.file.write( data );
+	BOOST_CHECK( rejected( sample.file.name( ), "bad section index" ) );
+}
@@ -0,0 +1,141 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "string_pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#ifdef max
+#undef max
+#endif
+
+namespace daw {
+	namespace wmi {
+		namespace {
+			size_t const block_chars = 64 * 1024;
+			size_t const initial_index_size = 1024;
+
+			uint32_t hash_string( boost::wstring_ref value ) {
+				// FNV-1a
+				uint32_t result = 2166136261u;
+				for( auto const c : value ) {
+					result ^= static_cast<uint32_t>(c);
+					result *= 16777619u;
+				}
+				return result;
+			}
+
+			bool is_equal( wchar_t const * data, uint32_t const size, boost::wstring_ref value ) {
+				return size == value.size( ) && std::equal( value.begin( ), value.end( ), data );
+			}
+		}	// namespace anonymous
+
+		string_pool::string_pool( ): m_blocks( ), m_block_used( 0 ), m_block_size( 0 ), m_entries( ), m_index( initial_index_size, 0 ), m_mutex( ) { }
+
+		wchar_t const * string_pool::store( boost::wstring_ref value ) {
+			if( value.empty( ) ) {
+				return nullptr;
+			}
+			if( m_block_size - m_block_used < value.size( ) ) {
+				// Strings longer than a block get a block of their own
+				auto const new_size = std::max( block_chars, value.size( ) );
+				m_blocks.emplace_back( new wchar_t[new_size] );
+				m_block_size = new_size;
+				m_block_used = 0;
+			}
+			auto result = m_blocks.back( ).get( ) + m_block_used;
+			std::copy( value.begin( ), value.end( ), result );
+			m_block_used += value.size( );
+			return result;
+		}
+
+		void string_pool::grow_index( ) {
+			std::vector<id_t> index( m_index.size( ) * 2, 0 );
+			auto const mask = index.size( ) - 1;
+			for( id_t id = 0; id < m_entries.size( ); ++id ) {
+				auto pos = m_entries[id].hash & mask;
+				while( 0 != index[pos] ) {
+					pos = (pos + 1) & mask;
+				}
+				index[pos] = id + 1;
+			}
+			m_index = std::move( index );
+		}
+
+		string_pool::id_t string_pool::intern( boost::wstring_ref value ) {
+			if( value.size( ) > std::numeric_limits<uint32_t>::max( ) ) {
+				throw std::length_error( "String too long to intern" );
+			}
+			auto const hash = hash_string( value );
+			std::lock_guard<std::mutex> lock( m_mutex );
+			auto const mask = m_index.size( ) - 1;
+			auto pos = hash & mask;
+			while( 0 != m_index[pos] ) {
+				auto const & entry = m_entries[m_index[pos] - 1];
+				if( entry.hash == hash && is_equal( entry.data, entry.size, value ) ) {
+					return m_index[pos] - 1;
+				}
+				pos = (pos + 1) & mask;
+			}
+			if( m_entries.size( ) >= std::numeric_limits<id_t>::max( ) - 1 ) {
+				throw std::length_error( "string_pool is full" );
+			}
+			auto const id = static_cast<id_t>(m_entries.size( ));
+			m_entries.push_back( entry_t { store( value ), static_cast<uint32_t>(value.size( )), hash } );
+			m_index[pos] = id + 1;
+			// Keep the load factor at or below one half
+			if( m_entries.size( ) * 2 > m_index.size( ) ) {
+				grow_index( );
+			}
+			return id;
+		}
+
+		boost::wstring_ref string_pool::get( id_t const id ) const {
+			assert( id < m_entries.size( ) );
+			auto const & entry = m_entries[id];
+			return boost::wstring_ref( entry.data, entry.size );
+		}
+
+		size_t string_pool::size( ) const {
+			std::lock_guard<std::mutex> lock( m_mutex );
+			return m_entries.size( );
+		}
+
+		string_pool_cache::string_pool_cache( string_pool & pool ): m_pool( &pool ), m_ids( ), m_key( ) { }
+
+		string_pool::id_t string_pool_cache::intern( boost::wstring_ref value ) {
+			m_key.assign( value.begin( ), value.end( ) );
+			auto const pos = m_ids.find( m_key );
+			if( m_ids.end( ) != pos ) {
+				return pos->second;
+			}
+			auto const id = m_pool->intern( value );
+			m_ids.emplace( m_key, id );
+			return id;
+		}
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,99 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <boost/utility/string_ref.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace daw {
+	namespace wmi {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Stores each distinct string once and identifies it by a
+		///				32 bit id.  Equal strings get equal ids, so rows holding
+		///				ids compare and group with integer compares.  The text
+		///				lives in large arena blocks that never move, so views
+		///				from get stay valid for the life of the pool.
+		///				intern may be called from several threads at once; get
+		///				must not race with intern.
+		//////////////////////////////////////////////////////////////////////////
+		class string_pool {
+		public:
+			using id_t = uint32_t;
+
+		private:
+			struct entry_t {
+				wchar_t const * data;
+				uint32_t size;
+				uint32_t hash;
+			};
+
+			std::vector<std::unique_ptr<wchar_t[]>> m_blocks;
+			size_t m_block_used;
+			size_t m_block_size;
+			std::vector<entry_t> m_entries;
+			std::vector<id_t> m_index;	// open addressing, holds id + 1 and 0 when empty
+			mutable std::mutex m_mutex;
+
+			wchar_t const * store( boost::wstring_ref value );
+			void grow_index( );
+
+		public:
+			string_pool( );
+			~string_pool( ) = default;
+			string_pool( string_pool const & ) = delete;
+			string_pool & operator=( string_pool const & ) = delete;
+			string_pool( string_pool && ) = delete;
+			string_pool & operator=( string_pool && ) = delete;
+
+			id_t intern( boost::wstring_ref value );
+			boost::wstring_ref get( id_t const id ) const;
+
+			/// Summary: Number of distinct strings, ids are 0 to size( ) - 1
+			size_t size( ) const;
+		};	// class string_pool
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	The ids one thread has been given by a string_pool.
+		///				Rows repeat the same few names, so a worker interning
+		///				through a cache of its own only locks the pool the
+		///				first time it sees each name.
+		//////////////////////////////////////////////////////////////////////////
+		class string_pool_cache {
+			string_pool * m_pool;
+			std::unordered_map<std::wstring, string_pool::id_t> m_ids;
+			std::wstring m_key;
+
+		public:
+			explicit string_pool_cache( string_pool & pool );
+
+			string_pool::id_t intern( boost::wstring_ref value );
+		};	// class string_pool_cache
+	}	// namespace wmi
+}	// namespace daw
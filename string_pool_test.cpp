@@ -0,0 +1,188 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Unit tests of string_pool and string_pool_cache
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE string_pool
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <cstddef>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "string_pool.h"
+
+namespace {
+	std::wstring to_wstring( boost::wstring_ref value ) {
+		return std::wstring( value.begin( ), value.end( ) );
+	}
+
+	std::wstring name( size_t const n ) {
+		return L"CORP\\user" + std::to_wstring( n );
+	}
+}	// namespace anonymous
+
+BOOST_AUTO_TEST_CASE( equal_strings_equal_ids ) {
+	daw::wmi::string_pool pool;
+	BOOST_CHECK_EQUAL( pool.size( ), 0u );
+	auto const alice = pool.intern( L"alice" );
+	auto const bob = pool.intern( L"bob" );
+	BOOST_CHECK_EQUAL( alice, 0u );
+	BOOST_CHECK_EQUAL( bob, 1u );
+	BOOST_CHECK_EQUAL( pool.intern( std::wstring( L"alice" ) ), alice );
+	BOOST_CHECK_EQUAL( pool.intern( boost::wstring_ref( L"bobby", 3 ) ), bob );
+	BOOST_CHECK( pool.intern( L"Alice" ) != alice );
+	BOOST_CHECK( pool.intern( L"alice\U0001F600" ) != alice );
+	BOOST_CHECK_EQUAL( pool.size( ), 4u );
+	BOOST_CHECK( to_wstring( pool.get( alice ) ) == L"alice" );
+	BOOST_CHECK( to_wstring( pool.get( bob ) ) == L"bob" );
+}
+
+BOOST_AUTO_TEST_CASE( empty_string ) {
+	daw::wmi::string_pool pool;
+	auto const first = pool.intern( L"x" );
+	auto const empty = pool.intern( L"" );
+	BOOST_CHECK( empty != first );
+	BOOST_CHECK_EQUAL( pool.intern( boost::wstring_ref( ) ), empty );
+	BOOST_CHECK_EQUAL( pool.intern( std::wstring( ) ), empty );
+	BOOST_CHECK( pool.get( empty ).empty( ) );
+	BOOST_CHECK_EQUAL( pool.size( ), 2u );
+}
+
+BOOST_AUTO_TEST_CASE( index_grows ) {
+	// Well past the initial 1024 slots at a load factor of one half
+	size_t const count = 10000;
+	daw::wmi::string_pool pool;
+	for( size_t n = 0; n < count; ++n ) {
+		BOOST_REQUIRE_EQUAL( pool.intern( name( n ) ), n );
+	}
+	BOOST_CHECK_EQUAL( pool.size( ), count );
+	for( size_t n = 0; n < count; ++n ) {
+		BOOST_REQUIRE_EQUAL( pool.intern( name( n ) ), n );
+		BOOST_REQUIRE( to_wstring( pool.get( static_cast<daw::wmi::string_pool::id_t>( n ) ) ) == name( n ) );
+	}
+	BOOST_CHECK_EQUAL( pool.size( ), count );
+}
+
+BOOST_AUTO_TEST_CASE( long_string_gets_its_own_block ) {
+	daw::wmi::string_pool pool;
+	auto const before = pool.intern( L"before" );
+	std::wstring const long_string( 200000, L'x' );
+	auto const id = pool.intern( long_string );
+	auto const after = pool.intern( L"after" );
+	BOOST_CHECK( to_wstring( pool.get( id ) ) == long_string );
+	BOOST_CHECK_EQUAL( pool.intern( long_string ), id );
+	BOOST_CHECK( to_wstring( pool.get( before ) ) == L"before" );
+	BOOST_CHECK( to_wstring( pool.get( after ) ) == L"after" );
+
+	// Exactly a block
+	std::wstring const block_string( 64 * 1024, L'y' );
+	auto const block_id = pool.intern( block_string );
+	BOOST_CHECK( to_wstring( pool.get( block_id ) ) == block_string );
+	BOOST_CHECK( to_wstring( pool.get( id ) ) == long_string );
+}
+
+BOOST_AUTO_TEST_CASE( views_stay_valid ) {
+	daw::wmi::string_pool pool;
+	std::vector<boost::wstring_ref> views;
+	for( size_t n = 0; n < 100; ++n ) {
+		views.push_back( pool.get( pool.intern( name( n ) ) ) );
+	}
+	// Enough text for several more blocks and index growth
+	for( size_t n = 100; n < 20000; ++n ) {
+		pool.intern( name( n ) + std::wstring( 20, L'-' ) );
+	}
+	for( size_t n = 0; n < views.size( ); ++n ) {
+		auto const view = pool.get( static_cast<daw::wmi::string_pool::id_t>( n ) );
+		BOOST_CHECK_EQUAL( view.data( ), views[n].data( ) );
+		BOOST_CHECK( to_wstring( views[n] ) == name( n ) );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( concurrent_intern ) {
+	size_t const distinct = 5000;
+	size_t const thread_count = 8;
+	daw::wmi::string_pool pool;
+	std::vector<std::vector<daw::wmi::string_pool::id_t>> ids( thread_count, std::vector<daw::wmi::string_pool::id_t>( distinct ) );
+	std::vector<std::thread> threads;
+	for( size_t t = 0; t < thread_count; ++t ) {
+		threads.emplace_back( [&pool, &ids, t, distinct]( ) {
+			// Each thread walks the names from a different place
+			for( size_t n = 0; n < distinct; ++n ) {
+				auto const index = (n * 7 + t * 613) % distinct;
+				ids[t][index] = pool.intern( name( index ) );
+			}
+		} );
+	}
+	for( auto & thread : threads ) {
+		thread.join( );
+	}
+
+	BOOST_CHECK_EQUAL( pool.size( ), distinct );
+	std::set<daw::wmi::string_pool::id_t> unique;
+	for( size_t n = 0; n < distinct; ++n ) {
+		for( size_t t = 1; t < thread_count; ++t ) {
+			BOOST_REQUIRE_EQUAL( ids[t][n], ids[0][n] );
+		}
+		BOOST_REQUIRE( to_wstring( pool.get( ids[0][n] ) ) == name( n ) );
+		unique.insert( ids[0][n] );
+	}
+	BOOST_CHECK_EQUAL( unique.size( ), distinct );
+}
+
+BOOST_AUTO_TEST_CASE( cache_gives_the_pool_ids ) {
+	daw::wmi::string_pool pool;
+	auto const alice = pool.intern( L"alice" );
+	daw::wmi::string_pool_cache cache( pool );
+	BOOST_CHECK_EQUAL( cache.intern( L"alice" ), alice );
+	auto const bob = cache.intern( L"bob" );
+	BOOST_CHECK_EQUAL( pool.intern( L"bob" ), bob );
+	BOOST_CHECK_EQUAL( cache.intern( L"bob" ), bob );
+	BOOST_CHECK_EQUAL( cache.intern( L"" ), pool.intern( L"" ) );
+	BOOST_CHECK_EQUAL( pool.size( ), 3u );
+
+	// Caches of several threads agree with each other
+	std::vector<std::vector<daw::wmi::string_pool::id_t>> ids( 4, std::vector<daw::wmi::string_pool::id_t>( 1000 ) );
+	std::vector<std::thread> threads;
+	for( size_t t = 0; t < ids.size( ); ++t ) {
+		threads.emplace_back( [&pool, &ids, t]( ) {
+			daw::wmi::string_pool_cache local( pool );
+			for( size_t repeat = 0; repeat < 3; ++repeat ) {
+				for( size_t n = 0; n < ids[t].size( ); ++n ) {
+					ids[t][n] = local.intern( name( (n + t * 250) % ids[t].size( ) ) );
+				}
+			}
+		} );
+	}
+	for( auto & thread : threads ) {
+		thread.join( );
+	}
+	for( size_t t = 0; t < ids.size( ); ++t ) {
+		for( size_t n = 0; n < ids[t].size( ); ++n ) {
+			BOOST_REQUIRE_EQUAL( ids[t][n], pool.intern( name( (n + t * 250) % ids[t].size( ) ) ) );
+		}
+	}
+	BOOST_CHECK_EQUAL( pool.size( ), 3u + 1000u );
+}
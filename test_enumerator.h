@@ -0,0 +1,94 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "enumerator.h"
+
+namespace daw {
+	namespace wmi {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	A stand in for a query in the unit tests, the numbers 0
+		///				to count - 1 a batch at a time.  With empty_last_batch
+		///				the end is reported by an empty batch after the last
+		///				number, as WMI does, else with the last number.  Throws
+		///				std::runtime_error when asked for batch number
+		///				throw_on_batch, counting from 0.
+		//////////////////////////////////////////////////////////////////////////
+		class counting_enumerator: public object_enumerator<int> {
+			int m_count;
+			bool m_empty_last_batch;
+			size_t m_throw_on_batch;
+			int m_next;
+			std::atomic<size_t> m_batches;
+			std::atomic<int> m_active;
+			std::atomic<bool> m_overlapped;
+
+		public:
+			explicit counting_enumerator( int const count, bool const empty_last_batch = true, size_t const throw_on_batch = (std::numeric_limits<size_t>::max)( ) ):
+					m_count( count ),
+					m_empty_last_batch( empty_last_batch ),
+					m_throw_on_batch( throw_on_batch ),
+					m_next( 0 ),
+					m_batches( 0 ),
+					m_active( 0 ),
+					m_overlapped( false ) { }
+
+			bool next_batch( std::vector<int> & out_values, size_t max_count ) override {
+				if( 0 != m_active++ ) {
+					m_overlapped = true;
+				}
+				auto const batch = m_batches++;
+				if( batch == m_throw_on_batch ) {
+					--m_active;
+					throw std::runtime_error( "source failed" );
+				}
+				out_values.clear( );
+				auto const last = std::min( m_count, m_next + static_cast<int>( max_count ) );
+				for( ; m_next < last; ++m_next ) {
+					out_values.push_back( m_next );
+				}
+				auto const more = m_next < m_count || (m_empty_last_batch && !out_values.empty( ));
+				--m_active;
+				return more;
+			}
+
+			/// Summary: Calls to next_batch so far
+			size_t batches( ) const {
+				return m_batches;
+			}
+
+			/// Summary: Was next_batch ever called while another call was running
+			bool overlapped( ) const {
+				return m_overlapped;
+			}
+		};	// class counting_enumerator
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,116 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "time_slicer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace daw {
+	namespace wmi {
+		adaptive_time_slicer::adaptive_time_slicer( int64_t const first, int64_t const last, size_t const workers, size_t const target_rows, int64_t const min_span ):
+				m_mutex( ),
+				m_pending( ),
+				m_finished( ),
+				m_target_rows( std::max<size_t>( 1, target_rows ) ),
+				m_min_span( std::max<int64_t>( 1, min_span ) ),
+				m_cancelled( false ) {
+
+			if( first >= last ) {
+				return;
+			}
+			// More slices than workers so there is something left to resize
+			// once the first ones have finished
+			auto const span = last - first;
+			auto const count = std::max<int64_t>( 1, std::min<int64_t>( static_cast<int64_t>(workers) * 4, span / m_min_span ) );
+			for( int64_t n = 0; n < count; ++n ) {
+				m_pending.push_back( time_slice { first + span * n / count, first + span * (n + 1) / count } );
+			}
+		}
+
+		boost::optional<double> adaptive_time_slicer::estimate_rows( time_slice const & slice ) const {
+			// Event rates follow the working day, so the closest slice in time
+			// is the best guide.  The overall rate is used when higher so a
+			// quiet night does not make a busy day look quiet
+			finished_t const * nearest = nullptr;
+			double nearest_distance = 0.0;
+			double total_rows = 0.0;
+			double total_span = 0.0;
+			auto const middle = (static_cast<double>(slice.first) + static_cast<double>(slice.last)) / 2.0;
+			for( auto const & finished : m_finished ) {
+				auto const distance = std::abs( (static_cast<double>(finished.slice.first) + static_cast<double>(finished.slice.last)) / 2.0 - middle );
+				if( nullptr == nearest || distance < nearest_distance ) {
+					nearest = &finished;
+					nearest_distance = distance;
+				}
+				total_rows += static_cast<double>(finished.rows);
+				total_span += static_cast<double>(finished.slice.last - finished.slice.first);
+			}
+			if( nullptr == nearest ) {
+				return boost::none;
+			}
+			auto const nearest_rate = static_cast<double>(nearest->rows) / static_cast<double>(nearest->slice.last - nearest->slice.first);
+			return std::max( nearest_rate, total_rows / total_span ) * static_cast<double>(slice.last - slice.first);
+		}
+
+		boost::optional<time_slice> adaptive_time_slicer::next( ) {
+			std::lock_guard<std::mutex> lock( m_mutex );
+			if( m_cancelled || m_pending.empty( ) ) {
+				return boost::none;
+			}
+			auto slice = m_pending.back( );
+			m_pending.pop_back( );
+			auto const target = static_cast<double>(m_target_rows);
+			// Split as often as needed but join at most once, a quiet night
+			// says little about the days either side of it.  Never both, the
+			// estimate moves with the nearest finished slice and could go
+			// back and forth
+			bool split = false;
+			bool joined = false;
+			for( auto estimate = estimate_rows( slice ); estimate; estimate = estimate_rows( slice ) ) {
+				if( !joined && *estimate > 2.0 * target && slice.last - slice.first >= 2 * m_min_span ) {
+					auto const middle = slice.first + (slice.last - slice.first) / 2;
+					m_pending.push_back( time_slice { slice.first, middle } );
+					slice.first = middle;
+					split = true;
+				} else if( !split && !joined && *estimate < target / 4.0 && !m_pending.empty( ) && m_pending.back( ).last == slice.first ) {
+					slice.first = m_pending.back( ).first;
+					m_pending.pop_back( );
+					joined = true;
+				} else {
+					break;
+				}
+			}
+			return slice;
+		}
+
+		void adaptive_time_slicer::finished( time_slice const & slice, size_t const rows ) {
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_finished.push_back( finished_t { slice, rows } );
+		}
+
+		void adaptive_time_slicer::cancel( ) {
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_cancelled = true;
+		}
+	}	// namespace wmi
+}	// namespace daw
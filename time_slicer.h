@@ -0,0 +1,147 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "host_pool.h"
+
+namespace daw {
+	namespace wmi {
+		/// Summary: The times [first, last) in microseconds since 1970-01-01 UTC
+		struct time_slice {
+			int64_t first;
+			int64_t last;
+		};	// struct time_slice
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Hands out the slices of a time range to concurrent
+		///				queries and learns from the rows each one returns.
+		///				The range starts cut into four equal slices per
+		///				worker.  Before a slice is handed out its rows are
+		///				estimated from the row rate of the nearest finished
+		///				slice, or of all of them when higher; one expected
+		///				to hold over twice target_rows is split in half and
+		///				one expected to hold under a quarter of it is joined
+		///				with the next.  Slices are handed out
+		///				newest first, the order a single query returns
+		///				events in.  Safe to use from several threads.
+		//////////////////////////////////////////////////////////////////////////
+		class adaptive_time_slicer {
+			struct finished_t {
+				time_slice slice;
+				size_t rows;
+			};
+
+			mutable std::mutex m_mutex;
+			std::deque<time_slice> m_pending;	// oldest first
+			std::vector<finished_t> m_finished;
+			size_t m_target_rows;
+			int64_t m_min_span;
+			bool m_cancelled;
+
+			/// Summary: Rows expected in slice, or none before any slice has finished
+			boost::optional<double> estimate_rows( time_slice const & slice ) const;
+
+		public:
+			static size_t const default_target_rows = 50000;
+			static int64_t const default_min_span = 60 * 1000000LL;
+
+			adaptive_time_slicer( int64_t const first, int64_t const last, size_t const workers, size_t const target_rows = default_target_rows, int64_t const min_span = default_min_span );
+			~adaptive_time_slicer( ) = default;
+			adaptive_time_slicer( adaptive_time_slicer const & ) = delete;
+			adaptive_time_slicer & operator=( adaptive_time_slicer const & ) = delete;
+
+			/// Summary: The next slice to query, or none when all have been handed out
+			boost::optional<time_slice> next( );
+
+			/// Summary: Report the rows a slice from next returned
+			void finished( time_slice const & slice, size_t const rows );
+
+			/// Summary: Hand out no more slices
+			void cancel( );
+		};	// class adaptive_time_slicer
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Run query( worker, slice ) for each slice of slicer on
+		///				workers threads and concatenate the rows of all the
+		///				slices newest slice first.  The first error stops the
+		///				other workers taking new slices and is rethrown once
+		///				they are done.  Each thread constructs a ThreadScope
+		///				for its lifetime.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename T, typename ThreadScope = no_thread_scope, typename QueryFunction>
+		std::vector<T> query_time_slices( adaptive_time_slicer & slicer, size_t const workers, QueryFunction query ) {
+			using slice_rows_t = std::pair<time_slice, std::vector<T>>;
+			std::vector<std::vector<slice_rows_t>> worker_rows( workers );
+			std::vector<std::exception_ptr> errors( workers );
+
+			run_workers<ThreadScope>( workers, workers, [&]( size_t const worker ) {
+				try {
+					while( auto slice = slicer.next( ) ) {
+						auto rows = query( worker, *slice );
+						slicer.finished( *slice, rows.size( ) );
+						worker_rows[worker].emplace_back( *slice, std::move( rows ) );
+					}
+				} catch( ... ) {
+					errors[worker] = std::current_exception( );
+					slicer.cancel( );
+				}
+			} );
+
+			for( auto const & error : errors ) {
+				if( error ) {
+					std::rethrow_exception( error );
+				}
+			}
+
+			std::vector<slice_rows_t *> ordered;
+			size_t total = 0;
+			for( auto & rows : worker_rows ) {
+				for( auto & slice_rows : rows ) {
+					ordered.push_back( &slice_rows );
+					total += slice_rows.second.size( );
+				}
+			}
+			std::sort( ordered.begin( ), ordered.end( ), []( slice_rows_t const * lhs, slice_rows_t const * rhs ) {
+				return lhs->first.first > rhs->first.first;
+			} );
+			std::vector<T> result;
+			result.reserve( total );
+			for( auto slice_rows : ordered ) {
+				std::move( slice_rows->second.begin( ), slice_rows->second.end( ), std::back_inserter( result ) );
+			}
+			return result;
+		}
+	}	// namespace wmi
+}	// namespace daw
@@ -0,0 +1,190 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Unit tests of adaptive_time_slicer and query_time_slices
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE time_slicer
+#include <atomic>
+#include <boost/test/unit_test.hpp>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "time_slicer.h"
+
+namespace {
+	std::vector<daw::wmi::time_slice> drain( daw::wmi::adaptive_time_slicer & slicer ) {
+		std::vector<daw::wmi::time_slice> result;
+		while( auto slice = slicer.next( ) ) {
+			result.push_back( *slice );
+		}
+		return result;
+	}
+
+	void check_slice( daw::wmi::time_slice const & slice, int64_t const first, int64_t const last ) {
+		BOOST_CHECK_EQUAL( slice.first, first );
+		BOOST_CHECK_EQUAL( slice.last, last );
+	}
+
+	// Newest first and together exactly [first, last)
+	void check_covers( std::vector<daw::wmi::time_slice> const & slices, int64_t const first, int64_t const last ) {
+		BOOST_REQUIRE( !slices.empty( ) );
+		BOOST_CHECK_EQUAL( slices.front( ).last, last );
+		BOOST_CHECK_EQUAL( slices.back( ).first, first );
+		for( size_t n = 0; n < slices.size( ); ++n ) {
+			BOOST_CHECK( slices[n].first < slices[n].last );
+			if( 0 < n ) {
+				BOOST_CHECK_EQUAL( slices[n].last, slices[n - 1].first );
+			}
+		}
+	}
+
+	// One row every 10 microseconds, newest first as a query returns them
+	std::vector<int64_t> rows_in( daw::wmi::time_slice const & slice ) {
+		std::vector<int64_t> result;
+		for( auto t = slice.last - 1 - (slice.last - 1) % 10; t >= slice.first; t -= 10 ) {
+			result.push_back( t );
+		}
+		return result;
+	}
+}	// namespace anonymous
+
+BOOST_AUTO_TEST_CASE( starts_with_four_slices_per_worker ) {
+	daw::wmi::adaptive_time_slicer slicer( 0, 8000, 2, 100, 1 );
+	auto const slices = drain( slicer );
+	BOOST_REQUIRE_EQUAL( slices.size( ), 8u );
+	check_slice( slices.front( ), 7000, 8000 );
+	check_covers( slices, 0, 8000 );
+}
+
+BOOST_AUTO_TEST_CASE( min_span_limits_the_slices ) {
+	daw::wmi::adaptive_time_slicer slicer( 0, 10000, 8, 100, 1000 );
+	auto const slices = drain( slicer );
+	BOOST_CHECK_EQUAL( slices.size( ), 10u );
+	check_covers( slices, 0, 10000 );
+
+	daw::wmi::adaptive_time_slicer short_range( 0, 500, 8, 100, 1000 );
+	auto const one = drain( short_range );
+	BOOST_REQUIRE_EQUAL( one.size( ), 1u );
+	check_slice( one.front( ), 0, 500 );
+}
+
+BOOST_AUTO_TEST_CASE( empty_range ) {
+	daw::wmi::adaptive_time_slicer slicer( 1000, 1000, 4 );
+	BOOST_CHECK( !slicer.next( ) );
+	daw::wmi::adaptive_time_slicer backwards( 2000, 1000, 4 );
+	BOOST_CHECK( !backwards.next( ) );
+}
+
+BOOST_AUTO_TEST_CASE( busy_slices_are_split ) {
+	daw::wmi::adaptive_time_slicer slicer( 0, 8000, 2, 100, 1 );
+	auto const first = slicer.next( );
+	BOOST_REQUIRE( first );
+	check_slice( *first, 7000, 8000 );
+	// A row a microsecond makes the next 1000 wide slice 1000 rows, it is
+	// halved until under twice the target
+	slicer.finished( *first, 1000 );
+	auto const split = slicer.next( );
+	BOOST_REQUIRE( split );
+	check_slice( *split, 6875, 7000 );
+	check_covers( drain( slicer ), 0, 6875 );
+}
+
+BOOST_AUTO_TEST_CASE( splits_stop_at_min_span ) {
+	daw::wmi::adaptive_time_slicer slicer( 0, 8000, 2, 100, 400 );
+	auto const first = slicer.next( );
+	BOOST_REQUIRE( first );
+	slicer.finished( *first, 1000 );
+	auto const split = slicer.next( );
+	BOOST_REQUIRE( split );
+	check_slice( *split, 6500, 7000 );
+}
+
+BOOST_AUTO_TEST_CASE( quiet_slices_are_joined_once ) {
+	daw::wmi::adaptive_time_slicer slicer( 0, 8000, 2, 1000, 1 );
+	auto const first = slicer.next( );
+	BOOST_REQUIRE( first );
+	slicer.finished( *first, 10 );
+	auto const joined = slicer.next( );
+	BOOST_REQUIRE( joined );
+	check_slice( *joined, 5000, 7000 );
+	check_covers( drain( slicer ), 0, 5000 );
+}
+
+BOOST_AUTO_TEST_CASE( overall_rate_when_higher ) {
+	daw::wmi::adaptive_time_slicer slicer( 0, 8000, 2, 100, 1 );
+	auto const first = slicer.next( );
+	BOOST_REQUIRE( first );
+	// The nearest slice was quiet but the range as a whole is busy
+	slicer.finished( *first, 0 );
+	slicer.finished( daw::wmi::time_slice { 0, 1000 }, 10000 );
+	auto const split = slicer.next( );
+	BOOST_REQUIRE( split );
+	BOOST_CHECK( split->last - split->first < 1000 );
+	BOOST_CHECK_EQUAL( split->last, 7000 );
+}
+
+BOOST_AUTO_TEST_CASE( cancel_stops_handing_out ) {
+	daw::wmi::adaptive_time_slicer slicer( 0, 8000, 2 );
+	BOOST_CHECK( slicer.next( ) );
+	slicer.cancel( );
+	BOOST_CHECK( !slicer.next( ) );
+}
+
+BOOST_AUTO_TEST_CASE( rows_concatenated_newest_slice_first ) {
+	int64_t const first = 0;
+	int64_t const last = 1000000;
+	std::vector<int64_t> expected;
+	for( auto t = last - 10; t >= first; t -= 10 ) {
+		expected.push_back( t );
+	}
+	for( size_t const workers : { 1, 3, 8 } ) {
+		// Small targets so slices are split and joined as they go
+		for( size_t const target_rows : { 50, 2000, 1000000 } ) {
+			daw::wmi::adaptive_time_slicer slicer( first, last, workers, target_rows, 1 );
+			std::atomic<size_t> queries( 0 );
+			auto const rows = daw::wmi::query_time_slices<int64_t>( slicer, workers, [&queries, workers]( size_t const worker, daw::wmi::time_slice const & slice ) {
+				if( worker >= workers ) {
+					throw std::logic_error( "no such worker" );
+				}
+				++queries;
+				return rows_in( slice );
+			} );
+			BOOST_CHECK_MESSAGE( rows == expected, "workers " << workers << " target_rows " << target_rows );
+			BOOST_CHECK( 0 < queries.load( ) );
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE( query_error_is_rethrown ) {
+	daw::wmi::adaptive_time_slicer slicer( 0, 1000000, 4, 1000, 1 );
+	std::atomic<size_t> queries( 0 );
+	BOOST_CHECK_THROW( daw::wmi::query_time_slices<int64_t>( slicer, 4, [&queries]( size_t, daw::wmi::time_slice const & slice ) {
+		if( 3 == ++queries ) {
+			throw std::runtime_error( "Quota violation" );
+		}
+		return rows_in( slice );
+	} ), std::runtime_error );
+	// Nothing more is handed out after the error
+	BOOST_CHECK( !slicer.next( ) );
+}
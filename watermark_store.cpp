@@ -0,0 +1,153 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "watermark_store.h"
+
+#include <boost/filesystem.hpp>
+#include <codecvt>
+#include <cstdio>
+#include <fstream>
+#include <locale>
+#include <sstream>
+#include <stdexcept>
+
+#include "cim_datetime.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace daw {
+	namespace wmi {
+		namespace {
+			// File format, one host per line:
+			// <record number>\t<time generated>\t<host as UTF-8>
+			char const * const file_header = "# who_is_on watermarks v1";
+
+#ifdef _WIN32
+			using utf8_convert = std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>>;
+#else
+			using utf8_convert = std::wstring_convert<std::codecvt_utf8<wchar_t>>;
+#endif
+
+			void sync_to_disk( std::FILE * f ) {
+#ifdef _WIN32
+				_commit( _fileno( f ) );
+#else
+				fsync( fileno( f ) );
+#endif
+			}
+		}	// namespace anonymous
+
+		watermark::watermark( ): record_number( 0 ), time_generated( ) { }
+
+		watermark::watermark( uint64_t const RecordNumber, std::string TimeGenerated ): record_number( RecordNumber ), time_generated( std::move( TimeGenerated ) ) { }
+
+		bool watermark::is_before( uint64_t const RecordNumber, boost::string_ref TimeGenerated ) const {
+			int64_t event_time = 0;
+			int64_t watermark_time = 0;
+			int16_t utc_offset = 0;
+			if( !parse_cim_datetime( TimeGenerated, event_time, utc_offset ) || !parse_cim_datetime( time_generated, watermark_time, utc_offset ) ) {
+				// Only an empty watermark, one not yet set, fails to parse
+				return !TimeGenerated.empty( ) && (time_generated.empty( ) || TimeGenerated.compare( time_generated ) > 0);
+			}
+			return event_time > watermark_time || (event_time == watermark_time && RecordNumber > record_number);
+		}
+
+		void watermark::update( uint64_t const RecordNumber, boost::string_ref TimeGenerated ) {
+			if( is_before( RecordNumber, TimeGenerated ) ) {
+				record_number = RecordNumber;
+				time_generated = TimeGenerated.to_string( );
+			}
+		}
+
+		watermark_store watermark_store::load( std::string const & file_name ) {
+			watermark_store result;
+			std::ifstream in( file_name, std::ios::binary );
+			if( !in ) {
+				return result;
+			}
+			utf8_convert convert;
+			std::string line;
+			size_t line_number = 0;
+			while( std::getline( in, line ) ) {
+				++line_number;
+				if( line.empty( ) || '#' == line[0] ) {
+					continue;
+				}
+				auto const tab1 = line.find( '\t' );
+				auto const tab2 = std::string::npos == tab1 ? tab1 : line.find( '\t', tab1 + 1 );
+				if( std::string::npos == tab2 ) {
+					std::stringstream ss;
+					ss << "Malformed state file " << file_name << " at line " << line_number;
+					throw std::runtime_error( ss.str( ) );
+				}
+				auto const record_number = std::stoull( line.substr( 0, tab1 ) );
+				auto time_generated = line.substr( tab1 + 1, tab2 - tab1 - 1 );
+				result.set( convert.from_bytes( line.substr( tab2 + 1 ) ), watermark( record_number, std::move( time_generated ) ) );
+			}
+			return result;
+		}
+
+		void watermark_store::save( std::string const & file_name ) const {
+			utf8_convert convert;
+			std::string contents = file_header;
+			contents += '\n';
+			for( auto const & host : m_hosts ) {
+				contents += std::to_string( host.second.record_number ) + '\t' + host.second.time_generated + '\t' + convert.to_bytes( host.first ) + '\n';
+			}
+
+			auto const temp_name = file_name + ".tmp";
+			auto f = std::fopen( temp_name.c_str( ), "wb" );
+			if( nullptr == f ) {
+				throw std::runtime_error( "Could not create state file " + temp_name );
+			}
+			auto const written = std::fwrite( contents.data( ), 1, contents.size( ), f );
+			auto const flushed = 0 == std::fflush( f );
+			if( flushed ) {
+				sync_to_disk( f );
+			}
+			std::fclose( f );
+			if( written != contents.size( ) || !flushed ) {
+				boost::filesystem::remove( temp_name );
+				throw std::runtime_error( "Could not write state file " + temp_name );
+			}
+			// Replaces file_name atomically
+			boost::filesystem::rename( temp_name, file_name );
+		}
+
+		boost::optional<watermark> watermark_store::find( std::wstring const & host ) const {
+			auto it = m_hosts.find( host );
+			if( m_hosts.end( ) == it ) {
+				return boost::optional<watermark>( );
+			}
+			return boost::optional<watermark>( it->second );
+		}
+
+		void watermark_store::set( std::wstring const & host, watermark value ) {
+			m_hosts[host] = std::move( value );
+		}
+	}	// namespace wmi
+}	// namespace daw
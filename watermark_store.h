@@ -0,0 +1,82 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace daw {
+	namespace wmi {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Newest event seen from a host.  time_generated is the
+		///				CIM_DATETIME string as returned by WMI so that it can be
+		///				used directly in a WQL comparison
+		//////////////////////////////////////////////////////////////////////////
+		struct watermark {
+			uint64_t record_number;
+			std::string time_generated;
+
+			watermark( );
+			watermark( uint64_t const RecordNumber, std::string TimeGenerated );
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Is the event newer than the watermark.  Times are
+			///				compared as instants, as the UTC offset WMI writes
+			///				them with changes at DST.  Events at the same time
+			///				are told apart by record number
+			//////////////////////////////////////////////////////////////////////////
+			bool is_before( uint64_t const RecordNumber, boost::string_ref TimeGenerated ) const;
+
+			/// Summary: Advance to the event if it is newer
+			void update( uint64_t const RecordNumber, boost::string_ref TimeGenerated );
+		};	// struct watermark
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Per host watermarks persisted between runs.  save writes
+		///				a temporary file and renames it over the old one so a
+		///				crash leaves either the old or the new state
+		//////////////////////////////////////////////////////////////////////////
+		class watermark_store {
+			std::map<std::wstring, watermark> m_hosts;
+
+		public:
+			watermark_store( ) = default;
+			~watermark_store( ) = default;
+			watermark_store( watermark_store const & ) = default;
+			watermark_store & operator=( watermark_store const & ) = default;
+			watermark_store( watermark_store && ) = default;
+			watermark_store & operator=( watermark_store && ) = default;
+
+			/// Summary: Load state written by save.  A missing file is an empty store
+			static watermark_store load( std::string const & file_name );
+			void save( std::string const & file_name ) const;
+
+			boost::optional<watermark> find( std::wstring const & host ) const;
+			void set( std::wstring const & host, watermark value );
+		};	// class watermark_store
+	}	// namespace wmi
+}	// namespace daw
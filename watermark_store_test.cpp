@@ -0,0 +1,134 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Unit tests of the per host watermarks kept between incremental runs
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE watermark_store
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include "watermark_store.h"
+
+namespace {
+	// A file name in the temporary directory that is removed at the end of the test
+	struct temp_file {
+		boost::filesystem::path path;
+
+		temp_file( ): path( boost::filesystem::temp_directory_path( ) / boost::filesystem::unique_path( "who_is_on_test-%%%%-%%%%-%%%%.state" ) ) { }
+
+		~temp_file( ) {
+			boost::system::error_code ec;
+			boost::filesystem::remove( path, ec );
+		}
+
+		std::string name( ) const {
+			return path.string( );
+		}
+	};	// struct temp_file
+}	// namespace anonymous
+
+BOOST_AUTO_TEST_CASE( save_load_round_trip ) {
+	temp_file file;
+	daw::wmi::watermark_store store;
+	store.set( L".", daw::wmi::watermark( 17, "20230101120000.000000+000" ) );
+	store.set( L"hôte-日本.example", daw::wmi::watermark( 18446744073709551615ULL, "20231105011000.123456-300" ) );
+	store.save( file.name( ) );
+
+	auto const loaded = daw::wmi::watermark_store::load( file.name( ) );
+	auto const local = loaded.find( L"." );
+	BOOST_REQUIRE( local );
+	BOOST_CHECK_EQUAL( local->record_number, 17u );
+	BOOST_CHECK_EQUAL( local->time_generated, "20230101120000.000000+000" );
+	auto const remote = loaded.find( L"hôte-日本.example" );
+	BOOST_REQUIRE( remote );
+	BOOST_CHECK_EQUAL( remote->record_number, 18446744073709551615ULL );
+	BOOST_CHECK_EQUAL( remote->time_generated, "20231105011000.123456-300" );
+	BOOST_CHECK( !loaded.find( L"other" ) );
+	BOOST_CHECK( !boost::filesystem::exists( file.name( ) + ".tmp" ) );
+}
+
+BOOST_AUTO_TEST_CASE( missing_file_is_empty ) {
+	temp_file file;
+	auto const loaded = daw::wmi::watermark_store::load( file.name( ) );
+	BOOST_CHECK( !loaded.find( L"." ) );
+}
+
+BOOST_AUTO_TEST_CASE( malformed_file_throws ) {
+	temp_file file;
+	{
+		std::ofstream out( file.name( ), std::ios::binary );
+		out << "# who_is_on watermarks v1\n";
+		out << "12\t20230101120000.000000+000\thost\n";
+		out << "13 no tabs here\n";
+	}
+	try {
+		daw::wmi::watermark_store::load( file.name( ) );
+		BOOST_ERROR( "load did not throw" );
+	} catch( std::runtime_error const & e ) {
+		BOOST_CHECK_EQUAL( std::string( e.what( ) ), "Malformed state file " + file.name( ) + " at line 3" );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( is_before_orders_by_time_then_record ) {
+	daw::wmi::watermark const mark( 100, "20230101120000.000000+000" );
+	BOOST_CHECK( mark.is_before( 1, "20230101120000.000001+000" ) );
+	BOOST_CHECK( !mark.is_before( 1000, "20230101115959.999999+000" ) );
+	BOOST_CHECK( mark.is_before( 101, "20230101120000.000000+000" ) );
+	BOOST_CHECK( !mark.is_before( 100, "20230101120000.000000+000" ) );
+	BOOST_CHECK( !mark.is_before( 99, "20230101120000.000000+000" ) );
+	// The same instant written at another offset
+	BOOST_CHECK( mark.is_before( 101, "20230101070000.000000-300" ) );
+	BOOST_CHECK( !mark.is_before( 99, "20230101070000.000000-300" ) );
+}
+
+BOOST_AUTO_TEST_CASE( is_before_across_a_utc_offset_change ) {
+	// 01:30 EDT is 05:30 UTC and the later 01:10 EST is 06:10 UTC, though
+	// its string is lower
+	daw::wmi::watermark const summer( 100, "20231105013000.000000-240" );
+	BOOST_CHECK( summer.is_before( 101, "20231105011000.000000-300" ) );
+	BOOST_CHECK( summer.is_before( 50, "20231105011000.000000-300" ) );
+
+	// 01:50 EDT is 05:50 UTC, before 01:10 EST, though its string is higher
+	daw::wmi::watermark const winter( 100, "20231105011000.000000-300" );
+	BOOST_CHECK( !winter.is_before( 101, "20231105015000.000000-240" ) );
+}
+
+BOOST_AUTO_TEST_CASE( update_only_advances ) {
+	daw::wmi::watermark mark;
+	mark.update( 5, "20231105013000.000000-240" );
+	BOOST_CHECK_EQUAL( mark.record_number, 5u );
+	BOOST_CHECK_EQUAL( mark.time_generated, "20231105013000.000000-240" );
+
+	mark.update( 6, "20231105011000.000000-300" );
+	BOOST_CHECK_EQUAL( mark.record_number, 6u );
+	BOOST_CHECK_EQUAL( mark.time_generated, "20231105011000.000000-300" );
+
+	// Older, by time and then by record number at the same time
+	mark.update( 7, "20231105015000.000000-240" );
+	mark.update( 4, "20231105011000.000000-300" );
+	BOOST_CHECK_EQUAL( mark.record_number, 6u );
+	BOOST_CHECK_EQUAL( mark.time_generated, "20231105011000.000000-300" );
+}
@@ -21,24 +21,205 @@
 // SOFTWARE.
 
 #include <algorithm>
+#include <atomic>
 #include <boost/program_options.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
 #include <exception>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <vector>
+#include "cim_datetime.h"
+#include "current_users.h"
+#include "enumerator.h"
+#include "event_replay.h"
+#include "evtx_reader.h"
+#include "external_sort.h"
+#include "host_pool.h"
+#include "logon_event.h"
+#include "logon_statistics.h"
+#include "message_fields.h"
+#include "natural_sort.h"
+#include "output_writer.h"
+#include "result_row.h"
+#include "row_source.h"
+#include "run_stats.h"
+#include "session_tracker.h"
+#include "snapshot_file.h"
+#include "string_pool.h"
+#include "time_slicer.h"
+#include "watermark_store.h"
+#include "wql_query.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
 #include "wmi_query.h"
+#endif
+
+using daw::wmi::result_row;
+
+struct host_state {
+	boost::optional<daw::wmi::watermark> previous;
+	daw::wmi::watermark seen;
+	daw::wmi::logon_statistics statistics;
+	daw::wmi::session_tracker sessions;
+	daw::wmi::current_users current;
+	daw::wmi::external_row_sort::group_id sort_group = 0;	// with memory_limit, where the host's rows wait until its query succeeds
+	std::vector<result_row> sort_buffer;	// rows handed to the sorter a block at a time
+};	// struct host_state
+
+void write_row( daw::wmi::output_writer & out, daw::wmi::string_pool const & names, result_row const & result ) {
+	out.begin_record( );
+	out.time_field( "Timestamp", result.timestamp, result.utc_offset );
+	out.name_field( "User", names, result.user_name );
+	out.name_field( "ComputerName", names, result.computer_name );
+	out.name_field( "Category", names, result.category );
+	out.int_field( "EventCode", result.event_code );
+	out.end_record( );
+}
+
+void write_header( daw::wmi::output_writer & out ) {
+	out.write_header( { "Timestamp", "User", "ComputerName", "Category", "EventCode" } );
+}
+
+void write_statistics( daw::wmi::output_writer & out, daw::wmi::string_pool const & names, daw::wmi::logon_statistics const & statistics, std::string const & report, bool const show_header ) {
+	daw::wmi::phase_timer const timer( daw::wmi::run_phase::output );
+	if( "users" == report ) {
+		if( show_header ) {
+			out.write_header( { "User", "Events", "Logons", "Logoffs", "DistinctComputers", "FirstSeenUTC", "LastSeenUTC" } );
+		}
+		for( auto const & user : statistics.users( ) ) {
+			out.begin_record( );
+			out.name_field( "User", names, user.user_name );
+			out.int_field( "Events", static_cast<int64_t>(user.events) );
+			out.int_field( "Logons", static_cast<int64_t>(user.logons) );
+			out.int_field( "Logoffs", static_cast<int64_t>(user.logoffs) );
+			out.int_field( "DistinctComputers", static_cast<int64_t>(user.distinct_hosts) );
+			out.time_field( "FirstSeenUTC", user.first_seen, 0 );
+			out.time_field( "LastSeenUTC", user.last_seen, 0 );
+			out.end_record( );
+		}
+	} else if( "user_hours" == report ) {
+		if( show_header ) {
+			out.write_header( { "HourUTC", "User", "Logons" } );
+		}
+		for( auto const & user_hour : statistics.user_hours( ) ) {
+			out.begin_record( );
+			out.time_field( "HourUTC", user_hour.hour, 0 );
+			out.name_field( "User", names, user_hour.user_name );
+			out.int_field( "Logons", static_cast<int64_t>(user_hour.logons) );
+			out.end_record( );
+		}
+	} else {
+		if( show_header ) {
+			out.write_header( { "LocalHour", "Logons" } );
+		}
+		auto const & hours = statistics.hour_of_day( );
+		for( size_t hour = 0; hour < hours.size( ); ++hour ) {
+			out.begin_record( );
+			out.int_field( "LocalHour", static_cast<int64_t>(hour) );
+			out.int_field( "Logons", static_cast<int64_t>(hours[hour]) );
+			out.end_record( );
+		}
+	}
+}
 
-struct result_row {
-	double sort_key;
-	std::wstring timestamp = L"";
-	std::wstring user_name = L"";
-	std::wstring computer_name = L"";
-	std::wstring category = L"";
-	int event_code = 0;
-
-	// operator< for sorting
-	bool operator<( result_row const & rhs ) const {
-		return sort_key < rhs.sort_key;
+void write_session( daw::wmi::output_writer & out, daw::wmi::string_pool const & names, daw::wmi::logon_session const & session ) {
+	out.begin_record( );
+	if( session.has_start ) {
+		out.time_field( "Start", session.start, session.utc_offset );
+	} else {
+		out.null_field( "Start" );
+	}
+	if( session.has_end ) {
+		out.time_field( "End", session.end, session.utc_offset );
+	} else {
+		out.null_field( "End" );
 	}
-};	// struct result_row;
+	if( session.has_start && session.has_end ) {
+		out.int_field( "DurationSeconds", session.duration( ) / 1000000 );
+	} else {
+		out.null_field( "DurationSeconds" );
+	}
+	out.name_field( "User", names, session.user_name );
+	out.name_field( "ComputerName", names, session.computer_name );
+	char logon_id[2 + 2 * sizeof( uint64_t ) + 1];
+	std::snprintf( logon_id, sizeof( logon_id ), "0x%llX", static_cast<unsigned long long>(session.logon_id) );
+	out.string_field( "LogonId", boost::string_ref( logon_id ) );
+	out.end_record( );
+}
+
+void write_session_header( daw::wmi::output_writer & out ) {
+	out.write_header( { "Start", "End", "DurationSeconds", "User", "ComputerName", "LogonId" } );
+}
+
+void write_sessions( daw::wmi::output_writer & out, daw::wmi::string_pool const & names, daw::wmi::session_tracker & sessions ) {
+	for( auto const & session : sessions.take_completed( ) ) {
+		write_session( out, names, session );
+	}
+}
+
+void write_all_sessions( daw::wmi::output_writer & out, daw::wmi::string_pool const & names, std::vector<daw::wmi::logon_session> & sessions, bool const show_header ) {
+	{
+		daw::wmi::phase_timer const timer( daw::wmi::run_phase::sort );
+		std::sort( sessions.begin( ), sessions.end( ), []( daw::wmi::logon_session const & lhs, daw::wmi::logon_session const & rhs ) {
+			return lhs.sort_time( ) < rhs.sort_time( );
+		} );
+	}
+	daw::wmi::phase_timer const timer( daw::wmi::run_phase::output );
+	if( show_header ) {
+		write_session_header( out );
+	}
+	for( auto const & session : sessions ) {
+		write_session( out, names, session );
+	}
+}
+
+void write_rows( daw::wmi::output_writer & out, daw::wmi::string_pool const & names, std::vector<result_row> & rows, bool const show_header ) {
+	daw::wmi::phase_timer const timer( daw::wmi::run_phase::output );
+	if( show_header ) {
+		write_header( out );
+	}
+	// Each host returns its events close to newest first, so the rows are
+	// a few long descending runs that can be merged as they are written
+	daw::wmi::merge_runs_to( std::begin( rows ), std::end( rows ), [&out, &names]( result_row const & result ) {
+		write_row( out, names, result );
+	} );
+}
+
+// Rows that did not fit in memory come back from the sort already in order
+void write_sorted_rows( daw::wmi::output_writer & out, daw::wmi::string_pool const & names, daw::wmi::external_row_sort & sorter, bool const show_header ) {
+	daw::wmi::phase_timer const timer( daw::wmi::run_phase::output );
+	if( show_header ) {
+		write_header( out );
+	}
+	sorter.merge_to( [&out, &names]( result_row const & result ) {
+		write_row( out, names, result );
+	} );
+}
+
+void sort_rows( std::vector<result_row> & rows ) {
+	daw::wmi::phase_timer const timer( daw::wmi::run_phase::sort );
+	daw::wmi::natural_merge_sort( std::begin( rows ), std::end( rows ) );
+}
+
+#ifdef _WIN32
+// Closed by Ctrl+C to end follow mode
+daw::wmi::blocking_queue<daw::wmi::ComSmartPtr<IWbemClassObject>> * g_follow_events = nullptr;
+
+BOOL WINAPI console_ctrl_handler( DWORD ctrl_type ) {
+	if( (CTRL_C_EVENT == ctrl_type || CTRL_BREAK_EVENT == ctrl_type) && nullptr != g_follow_events ) {
+		g_follow_events->close( );
+		return TRUE;
+	}
+	return FALSE;
+}
+#endif
 
 template<typename E = std::runtime_error>
 void throw_on_false( bool test, boost::string_ref err_msg ) {
@@ -47,13 +228,41 @@ void throw_on_false( bool test, boost::string_ref err_msg ) {
 	}
 }
 
+#ifdef _WIN32
 int __cdecl wmain( int argc, wchar_t *argv[] ) {
+#else
+int main( int argc, char *argv[] ) {
+#endif
 
 	auto parsed_args = [&argc, &argv]( ) {	// Parse command line
 		struct {
 			bool show_header = false;
 			bool prompt_credentials = false;
-			std::wstring remote_computer_name = L"";
+			std::vector<std::wstring> remote_computer_names;
+			size_t jobs = 8;
+			size_t workers = 1;
+			size_t slices = 1;
+			size_t batch_size = daw::wmi::default_batch_size;
+			bool show_query = false;
+			bool stats = false;
+			std::string stats_file = "";
+			std::string since = "";
+			std::string until = "";
+			std::string state_file = "";
+			bool follow = false;
+			unsigned poll_interval = 5;
+			std::string aggregate = "";
+			bool sessions = false;
+			unsigned session_timeout = 168;
+			bool current = false;
+			unsigned lookback = 168;
+			size_t memory_limit = 0;
+			daw::wmi::output_format format = daw::wmi::output_format::csv;
+			std::string snapshot = "";
+			std::string from_snapshot = "";
+			std::vector<std::string> evtx_files;
+			std::string record = "";
+			std::string replay = "";
 		} result;
 
 		namespace po = boost::program_options;
@@ -62,7 +271,32 @@ int __cdecl wmain( int argc, wchar_t *argv[] ) {
 			("help", "produce help message")
 			("prompt", "prompt for network credentials")
 			("show_header", "show field header in output")
-			("computer_name", po::wvalue<std::wstring>( ), "Host name of remote computer to connect to.");
+			("format", po::value<std::string>( )->default_value( "csv" ), "Output format: csv, json (one object per line) or binary (length prefixed records).")
+			("computer_name", po::wvalue<std::vector<std::wstring>>( )->multitoken( ), "Host names of remote computers to connect to.")
+			("computer_file", po::value<std::string>( ), "File with the host names of remote computers to connect to, one per line.")
+			("jobs", po::value<size_t>( )->default_value( 8 ), "Maximum number of hosts queried, or EVTX chunks read, at once.")
+			("workers", po::value<size_t>( )->default_value( 1 ), "Threads processing the events of each host query, or of replay.  Above 1 one more thread reads the events while these parse them.")
+			("slices", po::value<size_t>( )->default_value( 1 ), "Split each host's query into time ranges queried at once over its connection, resized as their event counts are seen.  Needs since or a state_file watermark.")
+			("batch_size", po::value<size_t>( )->default_value( daw::wmi::default_batch_size ), "Number of events requested from WMI per round trip.")
+			("since", po::value<std::string>( ), "Only events at or after this UTC time, YYYYMMDD[HHMMSS].")
+			("until", po::value<std::string>( ), "Only events before this UTC time, YYYYMMDD[HHMMSS].")
+			("show_query", "print the generated WQL query to stderr")
+			("stats", "When done, print where the run spent its time, counts of rows, errors and Message bytes, and each host's query latencies to stderr as JSON.")
+			("stats_file", po::value<std::string>( ), "Also write the stats to this file in the Prometheus text format, for the node exporter's textfile collector.")
+			("state_file", po::value<std::string>( ), "Only report events newer than those seen by the last run that used this file, then record the newest event from each host in it.")
+			("follow", "keep running and report new events as they are logged, until Ctrl+C")
+			("poll_interval", po::value<unsigned>( )->default_value( 5 ), "With follow, how often in seconds the hosts check for new events.")
+			("aggregate", po::value<std::string>( ), "Output statistics instead of events: users (per user counts, distinct computers, first/last seen), user_hours (logons per user per hour) or hour_of_day (logons by local hour).")
+			("sessions", "Output sessions, each logon paired with its logoff by Logon ID, instead of events.")
+			("session_timeout", po::value<unsigned>( )->default_value( 168 ), "With sessions, hours after which a logon or logoff still waiting for its other half is reported on its own.")
+			("current", "Output who is logged on now, the logon of each user whose newest event is a logon.  Events are read newest first and reading stops at the last boot or the lookback.")
+			("lookback", po::value<unsigned>( )->default_value( 168 ), "With current, hours before until, or now, to look for logons in.")
+			("memory_limit", po::value<size_t>( )->default_value( 0 ), "MiB of rows to keep in memory before sorting them into temporary files that are merged as they are written out, 0 for no limit.")
+			("snapshot", po::value<std::string>( ), "Also save the events collected to this snapshot file.")
+			("from_snapshot", po::value<std::string>( ), "Read events from a snapshot file instead of querying computers.")
+			("evtx", po::value<std::vector<std::string>>( )->multitoken( ), "Read events from exported Security EVTX files instead of querying computers.")
+			("record", po::value<std::string>( ), "Also save the event properties returned by the computers to this file, for replay.")
+			("replay", po::value<std::string>( ), "Read the event properties saved by record instead of querying computers.");
 
 		po::variables_map vm;
 
@@ -77,10 +311,144 @@ int __cdecl wmain( int argc, wchar_t *argv[] ) {
 
 			result.prompt_credentials = vm.count( "prompt" ) != 0;
 			result.show_header = vm.count( "show_header" ) != 0;
+			auto const format = daw::wmi::parse_output_format( vm["format"].as<std::string>( ) );
+			if( !format ) {
+				std::cerr << "ERROR: format must be one of csv, json or binary" << std::endl << std::endl;
+				exit( EXIT_FAILURE );
+			}
+			result.format = *format;
+			result.batch_size = vm["batch_size"].as<size_t>( );
+			if( 0 == result.batch_size ) {
+				std::cerr << "ERROR: batch_size must be greater than 0" << std::endl << std::endl;
+				exit( EXIT_FAILURE );
+			}
+			result.show_query = vm.count( "show_query" ) != 0;
+			result.stats = vm.count( "stats" ) != 0;
+			if( 0 != vm.count( "stats_file" ) ) {
+				result.stats_file = vm["stats_file"].as<std::string>( );
+			}
+			auto const get_time = [&vm]( char const * name ) {
+				if( 0 == vm.count( name ) ) {
+					return std::string( );
+				}
+				auto time_str = daw::wmi::cim_datetime_from_argument( vm[name].as<std::string>( ) );
+				if( !time_str ) {
+					std::cerr << "ERROR: " << name << " must be in the form YYYYMMDD or YYYYMMDDHHMMSS" << std::endl << std::endl;
+					exit( EXIT_FAILURE );
+				}
+				return *time_str;
+			};
+			result.since = get_time( "since" );
+			result.until = get_time( "until" );
+			if( 0 != vm.count( "state_file" ) ) {
+				result.state_file = vm["state_file"].as<std::string>( );
+			}
+			result.follow = vm.count( "follow" ) != 0;
+			result.poll_interval = vm["poll_interval"].as<unsigned>( );
+			if( result.follow && (0 == result.poll_interval || !result.state_file.empty( ) || !result.since.empty( ) || !result.until.empty( )) ) {
+				std::cerr << "ERROR: follow needs a poll_interval greater than 0 and cannot be used with state_file, since or until" << std::endl << std::endl;
+				exit( EXIT_FAILURE );
+			}
+			if( 0 != vm.count( "aggregate" ) ) {
+				result.aggregate = vm["aggregate"].as<std::string>( );
+				if( result.follow || ("users" != result.aggregate && "user_hours" != result.aggregate && "hour_of_day" != result.aggregate) ) {
+					std::cerr << "ERROR: aggregate must be one of users, user_hours or hour_of_day and cannot be used with follow" << std::endl << std::endl;
+					exit( EXIT_FAILURE );
+				}
+			}
+			result.sessions = vm.count( "sessions" ) != 0;
+			result.session_timeout = vm["session_timeout"].as<unsigned>( );
+			if( result.sessions && (0 == result.session_timeout || !result.aggregate.empty( )) ) {
+				std::cerr << "ERROR: sessions needs a session_timeout greater than 0 and cannot be used with aggregate" << std::endl << std::endl;
+				exit( EXIT_FAILURE );
+			}
+			if( 0 != vm.count( "snapshot" ) ) {
+				result.snapshot = vm["snapshot"].as<std::string>( );
+			}
+			if( 0 != vm.count( "from_snapshot" ) ) {
+				result.from_snapshot = vm["from_snapshot"].as<std::string>( );
+			}
+			if( !result.snapshot.empty( ) && (result.follow || result.sessions || !result.aggregate.empty( ) || !result.from_snapshot.empty( )) ) {
+				std::cerr << "ERROR: snapshot cannot be used with follow, aggregate, sessions or from_snapshot" << std::endl << std::endl;
+				exit( EXIT_FAILURE );
+			}
+			if( !result.from_snapshot.empty( ) && (result.follow || !result.state_file.empty( ) || 0 != vm.count( "computer_name" ) || 0 != vm.count( "computer_file" )) ) {
+				std::cerr << "ERROR: from_snapshot cannot be used with follow, state_file, computer_name or computer_file" << std::endl << std::endl;
+				exit( EXIT_FAILURE );
+			}
+			if( 0 != vm.count( "evtx" ) ) {
+				result.evtx_files = vm["evtx"].as<std::vector<std::string>>( );
+				if( result.follow || !result.state_file.empty( ) || !result.from_snapshot.empty( ) || 0 != vm.count( "computer_name" ) || 0 != vm.count( "computer_file" ) ) {
+					std::cerr << "ERROR: evtx cannot be used with follow, state_file, from_snapshot, computer_name or computer_file" << std::endl << std::endl;
+					exit( EXIT_FAILURE );
+				}
+			}
+			if( 0 != vm.count( "record" ) ) {
+				result.record = vm["record"].as<std::string>( );
+				if( result.follow || !result.state_file.empty( ) || !result.from_snapshot.empty( ) || !result.evtx_files.empty( ) ) {
+					std::cerr << "ERROR: record cannot be used with follow, state_file, from_snapshot or evtx" << std::endl << std::endl;
+					exit( EXIT_FAILURE );
+				}
+			}
+			if( 0 != vm.count( "replay" ) ) {
+				result.replay = vm["replay"].as<std::string>( );
+				if( result.follow || !result.state_file.empty( ) || !result.from_snapshot.empty( ) || !result.evtx_files.empty( ) || !result.record.empty( ) || 0 != vm.count( "computer_name" ) || 0 != vm.count( "computer_file" ) ) {
+					std::cerr << "ERROR: replay cannot be used with follow, state_file, from_snapshot, evtx, record, computer_name or computer_file" << std::endl << std::endl;
+					exit( EXIT_FAILURE );
+				}
+			}
+			result.jobs = vm["jobs"].as<size_t>( );
+			if( 0 == result.jobs ) {
+				std::cerr << "ERROR: jobs must be greater than 0" << std::endl << std::endl;
+				exit( EXIT_FAILURE );
+			}
+			result.workers = vm["workers"].as<size_t>( );
+			if( 0 == result.workers ) {
+				std::cerr << "ERROR: workers must be greater than 0" << std::endl << std::endl;
+				exit( EXIT_FAILURE );
+			}
+			result.slices = vm["slices"].as<size_t>( );
+			if( 0 == result.slices || (1 < result.slices && (result.follow || 1 < result.workers)) ) {
+				std::cerr << "ERROR: slices must be greater than 0 and cannot be used with follow or workers" << std::endl << std::endl;
+				exit( EXIT_FAILURE );
+			}
+			// Current stops at the first event that is too old, which only
+			// works while each host's events are read in order
+			result.current = vm.count( "current" ) != 0;
+			result.lookback = vm["lookback"].as<unsigned>( );
+			if( result.current && (0 == result.lookback || result.follow || result.sessions || !result.aggregate.empty( ) || !result.snapshot.empty( ) || !result.state_file.empty( ) || 1 < result.workers || 1 < result.slices) ) {
+				std::cerr << "ERROR: current needs a lookback greater than 0 and cannot be used with follow, aggregate, sessions, snapshot, state_file, workers or slices" << std::endl << std::endl;
+				exit( EXIT_FAILURE );
+			}
+			// Only plain event output keeps every row until the end
+			result.memory_limit = vm["memory_limit"].as<size_t>( );
+			if( 0 != result.memory_limit && (result.follow || result.sessions || result.current || !result.aggregate.empty( ) || !result.snapshot.empty( ) || !result.from_snapshot.empty( )) ) {
+				std::cerr << "ERROR: memory_limit cannot be used with follow, aggregate, sessions, current, snapshot or from_snapshot" << std::endl << std::endl;
+				exit( EXIT_FAILURE );
+			}
 			if( 0 != vm.count( "computer_name" ) ) {
-				result.remote_computer_name = vm["computer_name"].as<std::wstring>( );
-			} else {
-				result.remote_computer_name = L".";
+				result.remote_computer_names = vm["computer_name"].as<std::vector<std::wstring>>( );
+			}
+			if( 0 != vm.count( "computer_file" ) ) {
+				auto const file_name = vm["computer_file"].as<std::string>( );
+				std::wifstream host_file( file_name );
+				if( !host_file ) {
+					std::cerr << "ERROR: Could not open computer_file " << file_name << std::endl << std::endl;
+					exit( EXIT_FAILURE );
+				}
+				auto hosts = daw::wmi::read_host_list( host_file );
+				result.remote_computer_names.insert( result.remote_computer_names.end( ), hosts.begin( ), hosts.end( ) );
+			}
+			// A host listed twice would be queried twice and share its watermark
+			std::vector<std::wstring> unique_names;
+			for( auto & name : result.remote_computer_names ) {
+				if( std::find( unique_names.begin( ), unique_names.end( ), name ) == unique_names.end( ) ) {
+					unique_names.push_back( std::move( name ) );
+				}
+			}
+			result.remote_computer_names = std::move( unique_names );
+			if( result.remote_computer_names.empty( ) ) {
+				result.remote_computer_names.push_back( L"." );
 				if( result.prompt_credentials ) {
 					std::wcerr << "Warning: When connecting locally cannot prompt for credentials\n";
 					result.prompt_credentials = false;
@@ -97,59 +465,595 @@ int __cdecl wmain( int argc, wchar_t *argv[] ) {
 	}();
 
 	try {		
-		std::string const wmi_query_str = "Select * from Win32_NTLogEvent Where Logfile='Security' And (EventCode=4647 Or EventCode=4624)";
-		auto results = daw::wmi::wmi_query<result_row>( parsed_args.remote_computer_name, wmi_query_str, parsed_args.prompt_credentials, []( auto row_items ) {
-			using namespace daw::wmi;
-			using namespace daw::wmi::helpers;			
+		// User, computer and category names repeat across millions of rows so
+		// rows only hold their ids
+		daw::wmi::string_pool names;
+
+#ifdef _WIN32
+		if( daw::wmi::output_format::binary == parsed_args.format ) {
+			_setmode( _fileno( stdout ), _O_BINARY );
+		}
+#endif
+		daw::wmi::output_writer out( stdout, parsed_args.format );
+
+		// Without stats every probe finds no active run_stats and does nothing
+		daw::wmi::run_stats stats;
+		auto const collect_stats = parsed_args.stats || !parsed_args.stats_file.empty( );
+		if( collect_stats ) {
+			daw::wmi::set_active_run_stats( &stats );
+		}
+		auto const report_stats = [&]( ) {
+			if( !collect_stats ) {
+				return;
+			}
+			daw::wmi::set_active_run_stats( nullptr );
+			if( parsed_args.stats ) {
+				stats.write_json( std::cerr );
+			}
+			if( !parsed_args.stats_file.empty( ) ) {
+				stats.write_prometheus( parsed_args.stats_file );
+			}
+		};
+
+		auto const aggregate = !parsed_args.aggregate.empty( );
+		auto const sessions = parsed_args.sessions;
+		auto const session_timeout = static_cast<int64_t>(parsed_args.session_timeout) * 3600LL * 1000000LL;
+
+		auto const to_timestamp = []( std::string const & time_str, int64_t const unset ) {
+			auto timestamp = unset;
+			int16_t utc_offset = 0;
+			if( !time_str.empty( ) ) {
+				throw_on_false( daw::wmi::parse_cim_datetime( time_str, timestamp, utc_offset ), "Invalid time" );
+			}
+			return timestamp;
+		};
+		auto const since = to_timestamp( parsed_args.since, (std::numeric_limits<int64_t>::min)( ) );
+		auto const until = to_timestamp( parsed_args.until, (std::numeric_limits<int64_t>::max)( ) );
+
+		// With current, who was on at until, or now, going back lookback
+		// hours or to since if later
+		auto const current = parsed_args.current;
+		auto const current_cutoff = [&]( ) {
+			auto reference = until;
+			if( (std::numeric_limits<int64_t>::max)( ) == reference ) {
+				reference = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::system_clock::now( ).time_since_epoch( ) ).count( );
+			}
+			return (std::max<int64_t>)( since, reference - static_cast<int64_t>(parsed_args.lookback) * 3600LL * 1000000LL );
+		}( );
 
-			result_row current_result;
-			throw_on_false( row_items( L"EventCode", current_result.event_code ), "Property not found: EventCode" );			
+		// With a memory limit rows go to the sorter as they are made instead
+		// of being kept
+		std::unique_ptr<daw::wmi::external_row_sort> sorter;
+		if( 0 != parsed_args.memory_limit ) {
+			sorter = std::make_unique<daw::wmi::external_row_sort>( parsed_args.memory_limit * 1024 * 1024 );
+		}
 
-			std::wstring msg = L"";
-			throw_on_false( row_items( L"Message", msg ), "Property not found: Message" );
-			
+		// Sources that hand over all their rows at once share one output path
+		auto const write_collected = [&]( std::vector<result_row> & rows ) {
+			if( current ) {
+				sort_rows( rows );
+				daw::wmi::current_users users( current_cutoff );
+				for( auto row = rows.rbegin( ); row != rows.rend( ); ++row ) {
+					users.add( *row );
+				}
+				auto logged_on = users.logged_on( );
+				write_rows( out, names, logged_on, parsed_args.show_header );
+			} else if( aggregate ) {
+				daw::wmi::logon_statistics statistics;
+				for( auto const & row : rows ) {
+					statistics.add( row );
+				}
+				write_statistics( out, names, statistics, parsed_args.aggregate, parsed_args.show_header );
+			} else if( sessions ) {
+				sort_rows( rows );
+				daw::wmi::session_tracker tracker( session_timeout );
+				for( auto const & row : rows ) {
+					tracker.add( row );
+				}
+				tracker.finish( );
+				auto all_sessions = tracker.take_completed( );
+				write_all_sessions( out, names, all_sessions, parsed_args.show_header );
+			} else if( sorter ) {
+				sorter->add( rows );
+				write_sorted_rows( out, names, *sorter, parsed_args.show_header );
+			} else {
+				if( !parsed_args.snapshot.empty( ) ) {
+					// Saved in time order so reading it back needs no sort
+					sort_rows( rows );
+				}
+				write_rows( out, names, rows, parsed_args.show_header );
+				if( !parsed_args.snapshot.empty( ) ) {
+					daw::wmi::write_snapshot( parsed_args.snapshot, names, rows );
+				}
+			}
+			out.flush( );
+		};
 
-			// If logon(event ID 4624) make sure we are interactive(logon type 2)
-			if( 4624 == current_result.event_code && !equal_eh( find_logon_type( msg ), 2 ) ) {
-				throw SkipRowException( );
+		// Rows wait in their worker's state so the sorter's lock is taken
+		// once a block instead of once a row
+		size_t const sort_buffer_rows = 1024;
+		auto const flush_sort_buffer = [&sorter]( host_state & state ) {
+			if( !state.sort_buffer.empty( ) ) {
+				sorter->add( state.sort_group, state.sort_buffer );
+				state.sort_buffer.clear( );
+			}
+		};
+		auto const add_sorted = [&flush_sort_buffer, sort_buffer_rows]( host_state & state, result_row const & row ) {
+			state.sort_buffer.push_back( row );
+			if( state.sort_buffer.size( ) >= sort_buffer_rows ) {
+				flush_sort_buffer( state );
 			}
+		};
+
+		// Turns the properties of a Win32_NTLogEvent, live or replayed, into a
+		// row.  Each callback interns through its own cache of names
+		auto const make_row_callback = [&names]( host_state & state ) {
+			return [&state, local_names = daw::wmi::string_pool_cache( names ), insertion_strings = std::vector<std::wstring>( )]( auto row_items ) mutable -> daw::wmi::row_result<result_row> {
+				using namespace daw::wmi;
+
+				logon_event event;
+				throw_on_false( row_items( L"EventCode", event.event_code ), "Property not found: EventCode" );
 
-			// We don't want the SYSTEM account
-			if( equal_eh( find_security_id( msg ), L"S-1-5-18" ) ) {
-				throw SkipRowException( );
+				// Watermark before any filtering so skipped events are not asked for again
+				uint64_t record_number = 0;
+				throw_on_false( row_items( L"RecordNumber", record_number ), "Property not found: RecordNumber" );
+				std::wstring time_str = L"";
+				throw_on_false( row_items( L"TimeGenerated", time_str ), "Property not found: TimeGenerated" );
+				auto const time_generated = std::string( time_str.begin( ), time_str.end( ) );
+				if( state.previous && !state.previous->is_before( record_number, time_generated ) ) {
+					return row_result<result_row>::skip( );
+				}
+				state.seen.update( record_number, time_generated );
+
+				// InsertionStrings hold the fields by position in any language.
+				// Recordings made before they were asked for only have the
+				// Message text
+				std::wstring msg = L"";
+				message_fields fields;
+				if( row_items( L"InsertionStrings", insertion_strings ) ) {
+					fields = extract_insertion_fields( event.event_code, insertion_strings );
+				} else {
+					throw_on_false( row_items( L"Message", msg ), "Property not found: InsertionStrings" );
+					count_run( run_counter::message_bytes, msg.size( ) * sizeof( wchar_t ) );
+					fields = extract_message_fields( msg );
+				}
+				auto const & account = fields.target_account( event.event_code );
+
+				std::wstring computer_name = L"";
+				throw_on_false( row_items( L"ComputerName", computer_name ), "Property not found: ComputerName" );
+				std::wstring category = L"";
+				throw_on_false( row_items( L"CategoryString", category ), "Property not found: CategoryString" );
+				throw_on_false( parse_cim_datetime( time_str, event.timestamp, event.utc_offset ), "Invalid TimeGenerated" );
+
+				event.logon_type = parse_int( fields.logon_type );
+				event.security_id = account.security_id;
+				event.account_name = account.account_name;
+				event.account_domain = account.account_domain;
+				event.logon_id = parse_hex( account.logon_id ).value_or( 0 );
+				event.computer_name = computer_name;
+				event.category = category;
+				return make_logon_row( event, local_names );
+			};
+		};
+
+		if( !parsed_args.replay.empty( ) ) {
+			daw::wmi::event_replay replay( parsed_args.replay );
+			std::vector<host_state> replay_states( parsed_args.workers );
+			if( sorter ) {
+				auto const group = sorter->open_group( );
+				for( auto & state : replay_states ) {
+					state.sort_group = group;
+				}
+			}
+			// The query did this filtering when the events were recorded
+			auto const make_replay_callback = [&]( size_t const worker ) {
+				return [row_callback = make_row_callback( replay_states[worker] ), &add_sorted, &state = replay_states[worker], &sorter, since, until]( auto row_items ) mutable -> daw::wmi::row_result<result_row> {
+					auto result = row_callback( std::move( row_items ) );
+					if( !sorter || daw::wmi::row_action::emit != result.action( ) ) {
+						return result;
+					}
+					if( since <= result.value( ).timestamp && result.value( ).timestamp < until ) {
+						add_sorted( state, result.value( ) );
+					}
+					return daw::wmi::row_result<result_row>::skip( );
+				};
+			};
+			auto rows = 1 == parsed_args.workers
+				? daw::wmi::read_rows<result_row>( replay, make_replay_callback( 0 ), parsed_args.batch_size )
+				: daw::wmi::read_rows_parallel<result_row>( replay, parsed_args.workers, make_replay_callback, parsed_args.batch_size );
+			if( sorter ) {
+				for( auto & state : replay_states ) {
+					flush_sort_buffer( state );
+				}
+				sorter->commit( replay_states.front( ).sort_group );
 			}
+			rows.erase( std::remove_if( rows.begin( ), rows.end( ), [since, until]( result_row const & row ) {
+				return row.timestamp < since || row.timestamp >= until;
+			} ), rows.end( ) );
+			write_collected( rows );
+			report_stats( );
+			return EXIT_SUCCESS;
+		}
 
-			// User Name
-			current_result.user_name = assign( find_account_domain( msg ), L"" ) + L"\\" + assign( find_account_name( msg ), L"" );
+		if( !parsed_args.from_snapshot.empty( ) ) {
+			daw::wmi::snapshot_file snapshot( parsed_args.from_snapshot );
+			auto rows = snapshot.load( names, since, until );
+			write_collected( rows );
+			report_stats( );
+			return EXIT_SUCCESS;
+		}
 
-			// Computer Name
-						
-			throw_on_false( row_items( L"ComputerName", current_result.computer_name ), "Property not found: ComputerName" );
+		if( !parsed_args.evtx_files.empty( ) ) {
+			std::vector<daw::wmi::evtx_file> files;
+			for( auto const & file_name : parsed_args.evtx_files ) {
+				files.emplace_back( file_name );
+			}
+			std::atomic<size_t> skipped_records( 0 );
+			auto results = daw::wmi::read_chunks<result_row>( files, parsed_args.jobs, [&]( daw::wmi::evtx_chunk & chunk ) {
+				std::vector<result_row> rows;
+				daw::wmi::string_pool_cache chunk_names( names );
+				daw::wmi::evtx_event record;
+				while( chunk.next( record ) ) {
+					auto const is_boot = current && daw::wmi::current_users::boot_event_code == record.event_id;
+					if( (4624 != record.event_id && 4647 != record.event_id && !is_boot) || record.timestamp < since || record.timestamp >= until ) {
+						continue;
+					}
+					// EVTX keeps the event data fields, not the rendered Message
+					daw::wmi::logon_event event;
+					event.event_code = record.event_id;
+					event.timestamp = record.timestamp;
+					event.logon_type = record.logon_type;
+					event.security_id = record.target_user_sid;
+					event.account_name = record.target_user_name;
+					event.account_domain = record.target_domain_name;
+					event.logon_id = record.target_logon_id;
+					event.computer_name = record.computer;
+					event.category = is_boot ? L"Security State Change" : 4624 == record.event_id ? L"Logon" : L"Logoff";
+					auto row = daw::wmi::make_logon_row( event, chunk_names );
+					if( daw::wmi::row_action::emit == row.action( ) ) {
+						rows.push_back( row.value( ) );
+						daw::wmi::count_run( daw::wmi::run_counter::rows_emitted );
+					} else {
+						daw::wmi::count_run( daw::wmi::run_counter::rows_skipped );
+					}
+				}
+				skipped_records += chunk.skipped_records( );
+				if( sorter ) {
+					sorter->add( rows );
+					rows.clear( );
+				}
+				return rows;
+			} );
+			count_run( daw::wmi::run_counter::errors, results.errors.size( ) );
+			for( auto const & error : results.errors ) {
+				std::cerr << "Error reading " << error.file_name << " chunk " << error.chunk << ":\n" << error.message << std::endl;
+			}
+			if( 0 != skipped_records ) {
+				std::cerr << "Warning: " << skipped_records << " unreadable EVTX records were skipped" << std::endl;
+			}
+			write_collected( results.rows );
+			report_stats( );
+			return EXIT_SUCCESS;
+		}
 
-			//Time Generated
-			throw_on_false( row_items( L"TimeGenerated", current_result.timestamp ), "Property not found: TimeGenerated" );
-			current_result.sort_key = boost::lexical_cast<double>(current_result.timestamp.substr( 0, current_result.timestamp.size( ) - 4 ));
-			current_result.timestamp = parse_stringtime( current_result.timestamp );
+#ifdef _WIN32
+		// Only ask for the properties the callback reads and let the server do
+		// all the filtering WQL can express.  Logon type and account are in
+		// the InsertionStrings so those checks stay in the callback.  The
+		// rendered Message, the largest property, is not needed
+		auto query = daw::wmi::wql_query( "Win32_NTLogEvent" )
+			.select( { "EventCode", "RecordNumber", "InsertionStrings", "ComputerName", "TimeGenerated", "CategoryString" } )
+			.where_equal( "Logfile", "Security" )
+			.where_any_of( "EventCode", current ? std::vector<int64_t> { 4624, 4647, daw::wmi::current_users::boot_event_code } : std::vector<int64_t> { 4624, 4647 } );
+		if( current ) {
+			query.where_compare( "TimeGenerated", ">=", daw::wmi::format_cim_datetime( current_cutoff ) );
+		} else if( !parsed_args.since.empty( ) ) {
+			query.where_compare( "TimeGenerated", ">=", parsed_args.since );
+		}
+		if( !parsed_args.until.empty( ) ) {
+			query.where_compare( "TimeGenerated", "<", parsed_args.until );
+		}
 
-			// Category
-			throw_on_false( row_items( L"CategoryString", current_result.category ), "Property not found: CategoryString" );
+		// Incremental runs only ask each host for what is newer than its
+		// watermark.  Events at the watermark's time are asked for again and
+		// those already seen are dropped by record number
+		auto const use_state = !parsed_args.state_file.empty( );
+		auto const watermarks = use_state ? daw::wmi::watermark_store::load( parsed_args.state_file ) : daw::wmi::watermark_store( );
+		std::map<std::wstring, host_state> host_states;
+		for( auto const & host : parsed_args.remote_computer_names ) {
+			auto & state = host_states[host];
+			state.sessions = daw::wmi::session_tracker( session_timeout );
+			state.previous = watermarks.find( host );
+			if( state.previous ) {
+				state.seen = *state.previous;
+			}
+		}
 
-			return current_result;
+		auto const host_query_str = [&]( std::wstring const & host, daw::wmi::time_slice const * slice ) {
+			auto host_query = query;
+			auto const & previous = host_states.at( host ).previous;
+			if( previous ) {
+				host_query.where_compare( "TimeGenerated", ">=", previous->time_generated );
+			}
+			if( nullptr != slice ) {
+				host_query.where_compare( "TimeGenerated", ">=", daw::wmi::format_cim_datetime( slice->first ) );
+				host_query.where_compare( "TimeGenerated", "<", daw::wmi::format_cim_datetime( slice->last ) );
+			}
+			auto result = host_query.str( );
+			if( parsed_args.show_query ) {
+				std::wcerr << host << L": ";
+				std::cerr << result << std::endl;
+			}
+			return result;
+		};
+
+		// COM, the credentials and each host's connection are set up once here
+		// and shared by the workers
+		daw::wmi::wmi_session session( parsed_args.prompt_credentials, false );
+
+		if( parsed_args.follow ) {
+			auto const follow_query = daw::wmi::wql_query( "__InstanceCreationEvent" )
+				.within( parsed_args.poll_interval )
+				.where_isa( "TargetInstance", "Win32_NTLogEvent" )
+				.where_equal( "TargetInstance.Logfile", "Security" )
+				.where_any_of( "TargetInstance.EventCode", { 4624, 4647 } )
+				.str( );
+			if( parsed_args.show_query ) {
+				std::cerr << follow_query << std::endl;
+			}
+			if( parsed_args.show_header ) {
+				if( parsed_args.sessions ) {
+					write_session_header( out );
+				} else {
+					write_header( out );
+				}
+				out.flush( );
+			}
+			daw::wmi::blocking_queue<daw::wmi::ComSmartPtr<IWbemClassObject>> events;
+			g_follow_events = &events;
+			SetConsoleCtrlHandler( console_ctrl_handler, TRUE );
+
+			host_state follow_state;
+			follow_state.sessions = daw::wmi::session_tracker( session_timeout );
+			auto const sessions = parsed_args.sessions;
+			daw::wmi::wmi_follow<result_row>( parsed_args.remote_computer_names, follow_query, session, events, make_row_callback( follow_state ), [&out, &names, &follow_state, sessions]( result_row const & result ) {
+				if( sessions ) {
+					follow_state.sessions.add( result );
+					write_sessions( out, names, follow_state.sessions );
+				} else {
+					write_row( out, names, result );
+				}
+				out.flush( );
+			} );
+			if( sessions ) {
+				// Whoever is still logged on
+				follow_state.sessions.finish( );
+				write_sessions( out, names, follow_state.sessions );
+				out.flush( );
+			}
+
+			SetConsoleCtrlHandler( console_ctrl_handler, FALSE );
+			g_follow_events = nullptr;
+			report_stats( );
+			return EXIT_SUCCESS;
+		}
+
+		// Aggregating and pairing sessions fold each row into its host's state
+		// as it arrives instead of keeping it
+		// Recording happens as the callback reads each property, so a replay
+		// sees exactly what the callback saw
+		std::unique_ptr<daw::wmi::event_recorder> recorder;
+		if( !parsed_args.record.empty( ) ) {
+			recorder = std::make_unique<daw::wmi::event_recorder>( parsed_args.record, daw::wmi::recorded_event::property_names_t { L"EventCode", L"RecordNumber", L"InsertionStrings", L"ComputerName", L"TimeGenerated", L"CategoryString" } );
+		}
+
+		auto const make_host_callback = [&make_row_callback, &add_sorted, &recorder, &sorter, aggregate, current]( host_state & state, bool const sessions ) {
+			return [row_callback = make_row_callback( state ), &add_sorted, &recorder, &sorter, &state, aggregate, sessions, current]( auto row_items ) mutable -> daw::wmi::row_result<result_row> {
+				auto result = [&]( ) {
+					if( !recorder ) {
+						return row_callback( std::move( row_items ) );
+					}
+					daw::wmi::recorded_event recorded( recorder->property_names( ) );
+					auto recorded_result = row_callback( daw::wmi::recording_row<decltype(row_items)>( std::move( row_items ), recorded ) );
+					recorder->write( recorded );
+					return recorded_result;
+				}( );
+				if( daw::wmi::row_action::emit != result.action( ) ) {
+					return result;
+				}
+				if( aggregate ) {
+					state.statistics.add( result.value( ) );
+					return daw::wmi::row_result<result_row>::skip( );
+				} else if( sessions ) {
+					state.sessions.add( result.value( ) );
+					return daw::wmi::row_result<result_row>::skip( );
+				} else if( current ) {
+					// A host's events arrive newest first, so nothing after
+					// its last boot or the lookback can change who is on
+					if( !state.current.add( result.value( ) ) ) {
+						return daw::wmi::row_result<result_row>::stop( );
+					}
+					return daw::wmi::row_result<result_row>::skip( );
+				} else if( sorter ) {
+					add_sorted( state, result.value( ) );
+					return daw::wmi::row_result<result_row>::skip( );
+				}
+				return result;
+			};
+		};
+
+		// Each worker, or slice worker, folds rows into a state of its own
+		// that is merged into the host's after.  Sessions need the host's
+		// rows in order so they are paired once the rows are back in order
+		auto const make_worker_states = []( host_state const & state, size_t const count ) {
+			std::vector<host_state> worker_states( count );
+			for( auto & worker_state : worker_states ) {
+				worker_state.previous = state.previous;
+				worker_state.sort_group = state.sort_group;
+			}
+			return worker_states;
+		};
+		auto const merge_worker_states = [&flush_sort_buffer, &sorter, sessions]( host_state & state, std::vector<host_state> & worker_states, std::vector<result_row> & rows ) {
+			for( auto & worker_state : worker_states ) {
+				if( sorter ) {
+					flush_sort_buffer( worker_state );
+				}
+				if( !worker_state.seen.time_generated.empty( ) ) {
+					state.seen.update( worker_state.seen.record_number, worker_state.seen.time_generated );
+				}
+				state.statistics.merge( worker_state.statistics );
+			}
+			if( sessions ) {
+				for( auto const & row : rows ) {
+					state.sessions.add( row );
+				}
+				rows.clear( );
+			}
+		};
+
+		// The range a host's query is sliced over, from since or the host's
+		// watermark, whichever is later, to until or now
+		auto const slice_range = [since, until]( host_state const & state ) {
+			auto first = since;
+			if( state.previous ) {
+				int64_t watermark = 0;
+				int16_t utc_offset = 0;
+				if( daw::wmi::parse_cim_datetime( state.previous->time_generated, watermark, utc_offset ) ) {
+					first = (std::max)( first, watermark );
+				}
+			}
+			auto last = until;
+			if( (std::numeric_limits<int64_t>::max)( ) == last ) {
+				last = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::system_clock::now( ).time_since_epoch( ) ).count( ) + 1;
+			}
+			return daw::wmi::time_slice { first, last };
+		};
+
+		auto const query_host = [&]( std::wstring const & host ) {
+			auto & state = host_states.at( host );
+			if( 1 < parsed_args.slices ) {
+				auto const range = slice_range( state );
+				// Without a start there is nothing to slice
+				if( (std::numeric_limits<int64_t>::min)( ) != range.first && range.first < range.last ) {
+					auto worker_states = make_worker_states( state, parsed_args.slices );
+					daw::wmi::adaptive_time_slicer slicer( range.first, range.last, parsed_args.slices );
+					auto rows = daw::wmi::query_time_slices<result_row, daw::wmi::impl::com_thread_scope>( slicer, parsed_args.slices, [&]( size_t const worker, daw::wmi::time_slice const & slice ) {
+						return session.query<result_row>( host, host_query_str( host, &slice ), make_host_callback( worker_states[worker], false ), parsed_args.batch_size );
+					} );
+					merge_worker_states( state, worker_states, rows );
+					return rows;
+				}
+			}
+			if( 1 == parsed_args.workers ) {
+				auto rows = session.query<result_row>( host, host_query_str( host, nullptr ), make_host_callback( state, sessions ), parsed_args.batch_size );
+				if( sorter ) {
+					flush_sort_buffer( state );
+				}
+				return rows;
+			}
+			auto worker_states = make_worker_states( state, parsed_args.workers );
+			auto rows = session.query_parallel<result_row>( host, host_query_str( host, nullptr ), parsed_args.workers, [&]( size_t const worker ) {
+				return make_host_callback( worker_states[worker], false );
+			}, parsed_args.batch_size );
+			merge_worker_states( state, worker_states, rows );
+			return rows;
+		};
+
+		auto host_results = daw::wmi::query_hosts<result_row, daw::wmi::impl::com_thread_scope>( parsed_args.remote_computer_names, parsed_args.jobs, [&]( std::wstring const & host ) {
+			if( !sorter ) {
+				return query_host( host );
+			}
+			// A failed host's rows are dropped, as query_hosts does with
+			// those it returns
+			auto & state = host_states.at( host );
+			state.sort_group = sorter->open_group( );
+			try {
+				auto rows = query_host( host );
+				sorter->commit( state.sort_group );
+				return rows;
+			} catch( ... ) {
+				state.sort_buffer.clear( );
+				sorter->discard( state.sort_group );
+				throw;
+			}
 		} );
 
-		std::sort( std::begin( results ), std::end( results ) );
+		for( auto const & error : host_results.errors ) {
+			std::wcerr << L"Error querying " << error.host << L":\n";
+			std::cerr << error.message << std::endl;
+		}
+		if( recorder ) {
+			recorder->close( );
+		}
+		if( 0 == host_results.hosts_succeeded ) {
+			report_stats( );
+			exit( EXIT_FAILURE );
+		}
+		auto const host_failed = [&host_results]( std::wstring const & host ) {
+			return std::any_of( host_results.errors.begin( ), host_results.errors.end( ), [&host]( daw::wmi::host_error const & error ) {
+				return error.host == host;
+			} );
+		};
 
-		if( parsed_args.show_header ) {
-			std::wcout << L"\"Timestamp\", \"User\", \"ComputerName\", \"Category\", \"EventCode\"\n";
+		if( current ) {
+			daw::wmi::current_users users;
+			for( auto const & host : parsed_args.remote_computer_names ) {
+				if( !host_failed( host ) ) {
+					users.merge( host_states.at( host ).current );
+				}
+			}
+			auto logged_on = users.logged_on( );
+			write_rows( out, names, logged_on, parsed_args.show_header );
+		} else if( aggregate ) {
+			daw::wmi::logon_statistics statistics;
+			for( auto const & host : parsed_args.remote_computer_names ) {
+				if( !host_failed( host ) ) {
+					statistics.merge( host_states.at( host ).statistics );
+				}
+			}
+			write_statistics( out, names, statistics, parsed_args.aggregate, parsed_args.show_header );
+		} else if( sessions ) {
+			std::vector<daw::wmi::logon_session> all_sessions;
+			for( auto const & host : parsed_args.remote_computer_names ) {
+				if( !host_failed( host ) ) {
+					auto & tracker = host_states.at( host ).sessions;
+					tracker.finish( );
+					auto host_sessions = tracker.take_completed( );
+					all_sessions.insert( all_sessions.end( ), host_sessions.begin( ), host_sessions.end( ) );
+				}
+			}
+			write_all_sessions( out, names, all_sessions, parsed_args.show_header );
+		} else if( sorter ) {
+			write_sorted_rows( out, names, *sorter, parsed_args.show_header );
+		} else {
+			auto & results = host_results.rows;
+			if( !parsed_args.snapshot.empty( ) ) {
+				// Saved in time order so reading it back needs no sort
+				sort_rows( results );
+			}
+			write_rows( out, names, results, parsed_args.show_header );
+			if( !parsed_args.snapshot.empty( ) ) {
+				daw::wmi::write_snapshot( parsed_args.snapshot, names, results );
+			}
 		}
-		for( auto const & result : results ) {
-			std::wcout << L"\"" << result.timestamp << L"\"";
-			std::wcout << L", \"" << result.user_name << L"\"";
-			std::wcout << L", \"" << result.computer_name << L"\"";
-			std::wcout << L", \"" << result.category << L"\"";
-			std::wcout << L", " << result.event_code;
-			std::wcout << "\n";
+		out.flush( );
+
+		// Only advance the watermarks once the events have been written out
+		if( use_state ) {
+			auto updated = watermarks;
+			for( auto const & host : parsed_args.remote_computer_names ) {
+				auto const & seen = host_states.at( host ).seen;
+				if( !host_failed( host ) && !seen.time_generated.empty( ) ) {
+					updated.set( host, seen );
+				}
+			}
+			updated.save( parsed_args.state_file );
 		}
+		report_stats( );
+#else
+		std::cerr << "ERROR: Querying computers needs Windows, read events with evtx, from_snapshot or replay instead" << std::endl;
+		exit( EXIT_FAILURE );
+#endif
 	} catch( std::exception const & e ) {
 		std::cerr << "Exception while running query:\n" << e.what( ) << std::endl;
 		exit( EXIT_FAILURE );
@@ -0,0 +1,574 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Micro-benchmarks of the stages a logon event goes through on its way
+// from a WMI object to a line of output, run over a fixed corpus of
+// Messages.  Only portable code is measured so it runs anywhere the
+// tool builds.  Usage: who_is_on_benchmark [seconds_per_stage]
+
+#include <algorithm>
+#include <atomic>
+#include <boost/utility/string_ref.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cim_datetime.h"
+#include "event_replay.h"
+#include "logon_event.h"
+#include "message_fields.h"
+#include "natural_sort.h"
+#include "output_writer.h"
+#include "property_handles.h"
+#include "result_row.h"
+#include "row_disposition.h"
+#include "string_pool.h"
+
+namespace {
+	// Every allocation in the process is counted, so a stage is charged
+	// with the ones it makes
+	std::atomic<uint64_t> g_allocations( 0 );
+}	// namespace anonymous
+
+void * operator new( size_t size ) {
+	++g_allocations;
+	auto result = std::malloc( 0 == size ? 1 : size );
+	if( nullptr == result ) {
+		throw std::bad_alloc( );
+	}
+	return result;
+}
+
+void operator delete( void * ptr ) noexcept {
+	std::free( ptr );
+}
+
+void operator delete( void * ptr, size_t ) noexcept {
+	std::free( ptr );
+}
+
+namespace {
+	using namespace daw::wmi;
+
+	struct sample_event {
+		int event_code;
+		wchar_t const * time_generated;
+		wchar_t const * computer_name;
+		wchar_t const * category;
+		wchar_t const * message;
+	};	// struct sample_event
+
+	// As Win32_NTLogEvent renders them on the Windows versions and
+	// languages seen in the field.  Localized Messages keep their labels
+	// in the local language so their fields are not found
+	sample_event const samples[] = {
+		// Windows 7 / Server 2008 R2, interactive logon
+		{ 4624, L"20160314083015.123456-300", L"WS-0142.corp.example.com", L"Logon",
+			L"An account was successfully logged on.\r\n\r\n"
+			L"Subject:\r\n\tSecurity ID:\t\tS-1-5-18\r\n\tAccount Name:\t\tWS-0142$\r\n\tAccount Domain:\t\tCORP\r\n\tLogon ID:\t\t0x3e7\r\n\r\n"
+			L"Logon Type:\t\t\t2\r\n\r\n"
+			L"New Logon:\r\n\tSecurity ID:\t\tS-1-5-21-3623811015-3361044348-30300820-1013\r\n\tAccount Name:\t\tjsmith\r\n\tAccount Domain:\t\tCORP\r\n\tLogon ID:\t\t0x1a2b3c4\r\n\tLogon GUID:\t\t{00000000-0000-0000-0000-000000000000}\r\n\r\n"
+			L"Process Information:\r\n\tProcess ID:\t\t0x2c0\r\n\tProcess Name:\t\tC:\\Windows\\System32\\winlogon.exe\r\n\r\n"
+			L"Network Information:\r\n\tWorkstation Name:\tWS-0142\r\n\tSource Network Address:\t127.0.0.1\r\n\tSource Port:\t\t0\r\n\r\n"
+			L"Detailed Authentication Information:\r\n\tLogon Process:\t\tUser32 \r\n\tAuthentication Package:\tNegotiate\r\n\tTransited Services:\t-\r\n\tPackage Name (NTLM only):\t-\r\n\tKey Length:\t\t0\r\n\r\n"
+			L"This event is generated when a logon session is created. It is generated on the computer that was accessed.\r\n\r\n"
+			L"The subject fields indicate the account on the local system which requested the logon. This is most commonly a service such as the Server service, or a local process such as Winlogon.exe or Services.exe.\r\n\r\n"
+			L"The logon type field indicates the kind of logon that occurred. The most common types are 2 (interactive) and 3 (network).\r\n\r\n"
+			L"The New Logon fields indicate the account for whom the new logon was created, i.e. the account that was logged on.\r\n\r\n"
+			L"The authentication information fields provide detailed information about this specific logon request.\r\n"
+			L"\t- Logon GUID is a unique identifier that can be used to correlate this event with a KDC event.\r\n"
+			L"\t- Transited services indicate which intermediate services have participated in this logon request.\r\n"
+			L"\t- Package name indicates which sub-protocol was used among the NTLM protocols.\r\n"
+			L"\t- Key length indicates the length of the generated session key. This will be 0 if no session key was requested." },
+		// Windows 10 / Server 2016 and later, interactive logon
+		{ 4624, L"20210907161203.500000-000", L"LT-7731.corp.example.com", L"Logon",
+			L"An account was successfully logged on.\r\n\r\n"
+			L"Subject:\r\n\tSecurity ID:\t\tS-1-5-18\r\n\tAccount Name:\t\tLT-7731$\r\n\tAccount Domain:\t\tCORP\r\n\tLogon ID:\t\t0x3E7\r\n\r\n"
+			L"Logon Information:\r\n\tLogon Type:\t\t2\r\n\tRestricted Admin Mode:\t-\r\n\tVirtual Account:\t\tNo\r\n\tElevated Token:\t\tNo\r\n\r\n"
+			L"Impersonation Level:\t\tImpersonation\r\n\r\n"
+			L"New Logon:\r\n\tSecurity ID:\t\tS-1-5-21-1004336348-1177238915-682003330-512\r\n\tAccount Name:\t\tadoe\r\n\tAccount Domain:\t\tCORP\r\n\tLogon ID:\t\t0x5F3C2A91\r\n\tLinked Logon ID:\t\t0x5F3C2AB7\r\n\tNetwork Account Name:\t-\r\n\tNetwork Account Domain:\t-\r\n\tLogon GUID:\t\t{4b1e9c1a-3f0e-2d8c-9a2b-7c1d5e6f8a90}\r\n\r\n"
+			L"Process Information:\r\n\tProcess ID:\t\t0x3a4\r\n\tProcess Name:\t\tC:\\Windows\\System32\\svchost.exe\r\n\r\n"
+			L"Network Information:\r\n\tWorkstation Name:\tLT-7731\r\n\tSource Network Address:\t127.0.0.1\r\n\tSource Port:\t\t0\r\n\r\n"
+			L"Detailed Authentication Information:\r\n\tLogon Process:\t\tUser32 \r\n\tAuthentication Package:\tNegotiate\r\n\tTransited Services:\t-\r\n\tPackage Name (NTLM only):\t-\r\n\tKey Length:\t\t0\r\n\r\n"
+			L"This event is generated when a logon session is created. It is generated on the computer that was accessed.\r\n\r\n"
+			L"The subject fields indicate the account on the local system which requested the logon. This is most commonly a service such as the Server service, or a local process such as Winlogon.exe or Services.exe.\r\n\r\n"
+			L"The logon type field indicates the kind of logon that occurred. The most common types are 2 (interactive) and 3 (network).\r\n\r\n"
+			L"The New Logon fields indicate the account for whom the new logon was created, i.e. the account that was logged on.\r\n\r\n"
+			L"The network fields indicate where a remote logon request originated. Workstation name is not always available and may be left blank in some cases.\r\n\r\n"
+			L"The impersonation level field indicates the extent to which a process in the logon session can impersonate.\r\n\r\n"
+			L"The authentication information fields provide detailed information about this specific logon request.\r\n"
+			L"\t- Logon GUID is a unique identifier that can be used to correlate this event with a KDC event.\r\n"
+			L"\t- Transited services indicate which intermediate services have participated in this logon request.\r\n"
+			L"\t- Package name indicates which sub-protocol was used among the NTLM protocols.\r\n"
+			L"\t- Key length indicates the length of the generated session key. This will be 0 if no session key was requested." },
+		// Server 2019, network logon, skipped
+		{ 4624, L"20220118020501.004211-000", L"FS-02.corp.example.com", L"Logon",
+			L"An account was successfully logged on.\r\n\r\n"
+			L"Subject:\r\n\tSecurity ID:\t\tS-1-0-0\r\n\tAccount Name:\t\t-\r\n\tAccount Domain:\t\t-\r\n\tLogon ID:\t\t0x0\r\n\r\n"
+			L"Logon Information:\r\n\tLogon Type:\t\t3\r\n\tRestricted Admin Mode:\t-\r\n\tVirtual Account:\t\tNo\r\n\tElevated Token:\t\tYes\r\n\r\n"
+			L"Impersonation Level:\t\tImpersonation\r\n\r\n"
+			L"New Logon:\r\n\tSecurity ID:\t\tS-1-5-21-1004336348-1177238915-682003330-1109\r\n\tAccount Name:\t\tsvc_backup\r\n\tAccount Domain:\t\tCORP.EXAMPLE.COM\r\n\tLogon ID:\t\t0x2D1F0E3\r\n\tLinked Logon ID:\t\t0x0\r\n\tNetwork Account Name:\t-\r\n\tNetwork Account Domain:\t-\r\n\tLogon GUID:\t\t{9d1c2b3a-4e5f-6071-8293-a4b5c6d7e8f9}\r\n\r\n"
+			L"Process Information:\r\n\tProcess ID:\t\t0x0\r\n\tProcess Name:\t\t-\r\n\r\n"
+			L"Network Information:\r\n\tWorkstation Name:\t-\r\n\tSource Network Address:\t10.20.4.17\r\n\tSource Port:\t\t51544\r\n\r\n"
+			L"Detailed Authentication Information:\r\n\tLogon Process:\t\tKerberos\r\n\tAuthentication Package:\tKerberos\r\n\tTransited Services:\t-\r\n\tPackage Name (NTLM only):\t-\r\n\tKey Length:\t\t0\r\n\r\n"
+			L"This event is generated when a logon session is created. It is generated on the computer that was accessed." },
+		// Service logon by SYSTEM, skipped
+		{ 4624, L"20220118020455.871000-000", L"FS-02.corp.example.com", L"Logon",
+			L"An account was successfully logged on.\r\n\r\n"
+			L"Subject:\r\n\tSecurity ID:\t\tS-1-5-18\r\n\tAccount Name:\t\tFS-02$\r\n\tAccount Domain:\t\tCORP\r\n\tLogon ID:\t\t0x3E7\r\n\r\n"
+			L"Logon Information:\r\n\tLogon Type:\t\t5\r\n\tRestricted Admin Mode:\t-\r\n\tVirtual Account:\t\tNo\r\n\tElevated Token:\t\tYes\r\n\r\n"
+			L"Impersonation Level:\t\tImpersonation\r\n\r\n"
+			L"New Logon:\r\n\tSecurity ID:\t\tS-1-5-18\r\n\tAccount Name:\t\tSYSTEM\r\n\tAccount Domain:\t\tNT AUTHORITY\r\n\tLogon ID:\t\t0x3E7\r\n\tLinked Logon ID:\t\t0x0\r\n\tNetwork Account Name:\t-\r\n\tNetwork Account Domain:\t-\r\n\tLogon GUID:\t\t{00000000-0000-0000-0000-000000000000}\r\n\r\n"
+			L"Process Information:\r\n\tProcess ID:\t\t0x2a8\r\n\tProcess Name:\t\tC:\\Windows\\System32\\services.exe\r\n\r\n"
+			L"This event is generated when a logon session is created. It is generated on the computer that was accessed." },
+		// Windows 10, logoff
+		{ 4647, L"20210907174510.250000-000", L"LT-7731.corp.example.com", L"Logoff",
+			L"User initiated logoff:\r\n\r\n"
+			L"Subject:\r\n\tSecurity ID:\t\tS-1-5-21-1004336348-1177238915-682003330-512\r\n\tAccount Name:\t\tadoe\r\n\tAccount Domain:\t\tCORP\r\n\tLogon ID:\t\t0x5F3C2A91\r\n\r\n"
+			L"This event is generated when a logoff is initiated. No further user-initiated activity can occur. This event can be interpreted as a logoff event." },
+		// Windows 7, logoff
+		{ 4647, L"20160314171122.000000-300", L"WS-0142.corp.example.com", L"Logoff",
+			L"User initiated logoff:\r\n\r\n"
+			L"Subject:\r\n\tSecurity ID:\t\tS-1-5-21-3623811015-3361044348-30300820-1013\r\n\tAccount Name:\t\tjsmith\r\n\tAccount Domain:\t\tCORP\r\n\tLogon ID:\t\t0x1a2b3c4\r\n\r\n"
+			L"This event is generated when a logoff is initiated. No further user-initiated activity can occur. This event can be interpreted as a logoff event." },
+		// English labels with names outside ASCII
+		{ 4624, L"20230602074401.318000+120", L"PC-M\u00dcNCHEN-07.example.de", L"Logon",
+			L"An account was successfully logged on.\r\n\r\n"
+			L"Subject:\r\n\tSecurity ID:\t\tS-1-5-18\r\n\tAccount Name:\t\tPC-M\u00dcNCHEN-07$\r\n\tAccount Domain:\t\tEXAMPLE\r\n\tLogon ID:\t\t0x3E7\r\n\r\n"
+			L"Logon Information:\r\n\tLogon Type:\t\t2\r\n\tRestricted Admin Mode:\t-\r\n\tVirtual Account:\t\tNo\r\n\tElevated Token:\t\tNo\r\n\r\n"
+			L"Impersonation Level:\t\tImpersonation\r\n\r\n"
+			L"New Logon:\r\n\tSecurity ID:\t\tS-1-5-21-2711830193-1852741305-2317458941-4117\r\n\tAccount Name:\t\tj\u00fcrgen.m\u00fcller\r\n\tAccount Domain:\t\tEXAMPLE\r\n\tLogon ID:\t\t0x9C01D2E\r\n\tLinked Logon ID:\t\t0x0\r\n\tNetwork Account Name:\t-\r\n\tNetwork Account Domain:\t-\r\n\tLogon GUID:\t\t{00000000-0000-0000-0000-000000000000}\r\n\r\n"
+			L"Process Information:\r\n\tProcess ID:\t\t0x3a4\r\n\tProcess Name:\t\tC:\\Windows\\System32\\svchost.exe\r\n\r\n"
+			L"This event is generated when a logon session is created. It is generated on the computer that was accessed." },
+		{ 4624, L"20230602091530.000000+540", L"TOKYO-WS-113.example.jp", L"Logon",
+			L"An account was successfully logged on.\r\n\r\n"
+			L"Subject:\r\n\tSecurity ID:\t\tS-1-5-18\r\n\tAccount Name:\t\tTOKYO-WS-113$\r\n\tAccount Domain:\t\tEXAMPLE\r\n\tLogon ID:\t\t0x3E7\r\n\r\n"
+			L"Logon Information:\r\n\tLogon Type:\t\t2\r\n\tRestricted Admin Mode:\t-\r\n\tVirtual Account:\t\tNo\r\n\tElevated Token:\t\tNo\r\n\r\n"
+			L"New Logon:\r\n\tSecurity ID:\t\tS-1-5-21-2711830193-1852741305-2317458941-5203\r\n\tAccount Name:\t\t\u5c71\u7530\u592a\u90ce\r\n\tAccount Domain:\t\tEXAMPLE\r\n\tLogon ID:\t\t0x1F2E3D4C\r\n\tLinked Logon ID:\t\t0x0\r\n\r\n"
+			L"This event is generated when a logon session is created. It is generated on the computer that was accessed." },
+		// German, labels are not found and the logon is skipped
+		{ 4624, L"20230602074401.318000+120", L"PC-BERLIN-02.example.de", L"Anmelden",
+			L"Ein Konto wurde erfolgreich angemeldet.\r\n\r\n"
+			L"Antragsteller:\r\n\tSicherheits-ID:\t\tS-1-5-18\r\n\tKontoname:\t\tPC-BERLIN-02$\r\n\tKontodom\u00e4ne:\t\tEXAMPLE\r\n\tAnmelde-ID:\t\t0x3E7\r\n\r\n"
+			L"Anmeldeinformationen:\r\n\tAnmeldetyp:\t\t2\r\n\tEingeschr\u00e4nkter Administratormodus:\t-\r\n\tVirtuelles Konto:\t\tNein\r\n\tRechteerweiterungstoken:\t\tNein\r\n\r\n"
+			L"Neue Anmeldung:\r\n\tSicherheits-ID:\t\tS-1-5-21-2711830193-1852741305-2317458941-4220\r\n\tKontoname:\t\tkschulz\r\n\tKontodom\u00e4ne:\t\tEXAMPLE\r\n\tAnmelde-ID:\t\t0x9C0F00A\r\n\tVerkn\u00fcpfte Anmelde-ID:\t\t0x0\r\n\r\n"
+			L"Dieses Ereignis wird beim Erstellen einer Anmeldesitzung generiert. Es wird auf dem Computer generiert, auf den zugegriffen wurde." },
+		// French logoff
+		{ 4647, L"20230602180002.000000+120", L"PC-PARIS-11.example.fr", L"Fermeture de session",
+			L"Fermeture de session initi\u00e9e par l'utilisateur :\r\n\r\n"
+			L"Sujet :\r\n\tID de s\u00e9curit\u00e9 :\t\tS-1-5-21-2711830193-1852741305-2317458941-6301\r\n\tNom du compte :\t\tcdupont\r\n\tDomaine du compte :\t\tEXAMPLE\r\n\tID d'ouverture de session :\t\t0x7A10B2C\r\n\r\n"
+			L"Cet \u00e9v\u00e9nement est g\u00e9n\u00e9r\u00e9 lorsqu'une fermeture de session est initi\u00e9e." },
+	};
+
+	size_t const corpus_size = 1000;
+
+	// Somewhere for results to go so the work is not optimized away
+	std::atomic<uint64_t> g_sink( 0 );
+
+	recorded_event::property_names_t const property_names = { L"EventCode", L"RecordNumber", L"Message", L"ComputerName", L"TimeGenerated", L"CategoryString" };
+
+	std::vector<recorded_event> make_corpus( ) {
+		size_t const sample_count = sizeof( samples ) / sizeof( samples[0] );
+		std::vector<recorded_event> result;
+		result.reserve( corpus_size );
+		for( size_t n = 0; n < corpus_size; ++n ) {
+			auto const & sample = samples[n % sample_count];
+			recorded_event event( property_names );
+			event.set_number( L"EventCode", sample.event_code );
+			event.set_number( L"RecordNumber", static_cast<int64_t>(1000000 + n) );
+			event.set_text( L"Message", sample.message );
+			event.set_text( L"ComputerName", sample.computer_name );
+			event.set_text( L"TimeGenerated", sample.time_generated );
+			event.set_text( L"CategoryString", sample.category );
+			result.push_back( std::move( event ) );
+		}
+		return result;
+	}
+
+	boost::wstring_ref text_of( recorded_event const & event, size_t const property ) {
+		return event.values( )[property].text;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Summary:	Run stage, which processes rows rows, over and over for
+	///				at least seconds and print the time and allocations it
+	///				took per row.  The first run is not counted.
+	//////////////////////////////////////////////////////////////////////////
+	template<typename Stage>
+	void run_stage( char const * name, size_t const rows, double const seconds, Stage stage ) {
+		using clock_t = std::chrono::steady_clock;
+		stage( );
+		auto const allocations = g_allocations.load( );
+		auto const start = clock_t::now( );
+		auto const stop = start + std::chrono::duration_cast<clock_t::duration>( std::chrono::duration<double>( seconds ) );
+		uint64_t passes = 0;
+		auto now = start;
+		do {
+			stage( );
+			++passes;
+			now = clock_t::now( );
+		} while( now < stop );
+		auto const total_rows = static_cast<double>(passes * rows);
+		auto const ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>( now - start ).count( ));
+		std::printf( "%-36s %12.1f %16.2f %12llu\n", name, ns / total_rows, static_cast<double>(g_allocations.load( ) - allocations) / total_rows, static_cast<unsigned long long>(passes) );
+	}
+
+	void write_row( output_writer & out, string_pool const & names, result_row const & row ) {
+		out.begin_record( );
+		out.time_field( "Timestamp", row.timestamp, row.utc_offset );
+		out.name_field( "User", names, row.user_name );
+		out.name_field( "ComputerName", names, row.computer_name );
+		out.name_field( "Category", names, row.category );
+		out.int_field( "EventCode", row.event_code );
+		out.end_record( );
+	}
+
+	size_t const sort_size = 100000;
+	int64_t const sort_step = 1000000;	// a second between events
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Summary:	Orders of rows to sort.  Hosts return their events about
+	///				newest first and query_hosts puts each host's after the
+	///				one before it
+	//////////////////////////////////////////////////////////////////////////
+	std::vector<result_row> make_sort_input( char const * const order ) {
+		std::vector<result_row> result( sort_size );
+		std::mt19937_64 random( 42 );
+		std::string const kind = order;
+		size_t const hosts = 16;
+		size_t const sawtooth_run = 1000;
+		for( size_t n = 0; n < sort_size; ++n ) {
+			auto & row = result[n];
+			row.logon_id = n;
+			if( "descending" == kind ) {
+				row.timestamp = static_cast<int64_t>(sort_size - n) * sort_step;
+			} else if( "merged hosts" == kind ) {
+				// Newest first on each host with the odd event a few seconds out of place
+				auto const per_host = sort_size / hosts;
+				auto const position = n % per_host;
+				row.timestamp = static_cast<int64_t>(per_host - position) * sort_step * static_cast<int64_t>(hosts) + static_cast<int64_t>(n / per_host) * sort_step;
+				if( 0 == random( ) % 50 ) {
+					row.timestamp += static_cast<int64_t>(random( ) % 5) * sort_step;
+				}
+			} else if( "random" == kind ) {
+				row.timestamp = static_cast<int64_t>(random( ) % sort_size) * sort_step;
+			} else if( "sawtooth" == kind ) {
+				row.timestamp = static_cast<int64_t>(n % sawtooth_run) * sort_step;
+			} else {
+				row.timestamp = sort_step;
+			}
+		}
+		return result;
+	}
+
+	std::FILE * open_null_device( ) {
+#ifdef _WIN32
+		auto result = std::fopen( "NUL", "wb" );
+#else
+		auto result = std::fopen( "/dev/null", "wb" );
+#endif
+		if( nullptr == result ) {
+			throw std::runtime_error( "Could not open the null device" );
+		}
+		return result;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Summary:	What the who_is_on row callback does with an object,
+	///				given anything that reads its properties by name
+	//////////////////////////////////////////////////////////////////////////
+	template<typename Row>
+	row_result<result_row> process_row( Row & row_items, string_pool & names, std::wstring & msg, std::wstring & time_str, std::wstring & computer_name, std::wstring & category ) {
+		logon_event event;
+		uint64_t record_number = 0;
+		if( !row_items( L"EventCode", event.event_code ) || !row_items( L"RecordNumber", record_number ) || !row_items( L"TimeGenerated", time_str ) || !row_items( L"Message", msg ) ) {
+			throw std::runtime_error( "Property not found" );
+		}
+		auto const fields = extract_message_fields( msg );
+		auto const & account = fields.target_account( event.event_code );
+		if( !row_items( L"ComputerName", computer_name ) || !row_items( L"CategoryString", category ) ) {
+			throw std::runtime_error( "Property not found" );
+		}
+		if( !parse_cim_datetime( time_str, event.timestamp, event.utc_offset ) ) {
+			throw std::runtime_error( "Invalid TimeGenerated" );
+		}
+		event.logon_type = parse_int( fields.logon_type );
+		event.security_id = account.security_id;
+		event.account_name = account.account_name;
+		event.account_domain = account.account_domain;
+		event.logon_id = parse_hex( account.logon_id ).value_or( 0 );
+		event.computer_name = computer_name;
+		event.category = category;
+		return make_logon_row( event, names );
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Summary:	A stand in for a WMI object read through property
+	///				handles.  Handles are resolved by name once through a
+	///				property_handle_cache, as IWbemWrapper does, and each
+	///				read is then an index
+	//////////////////////////////////////////////////////////////////////////
+	class handle_row {
+		recorded_event const * m_event;
+		property_handle_cache<size_t> * m_handles;
+
+		size_t handle( boost::wstring_ref property_name ) {
+			return m_handles->get( property_name, []( boost::wstring_ref name ) {
+				for( size_t n = 0; n < property_names.size( ); ++n ) {
+					if( name == property_names[n] ) {
+						return n;
+					}
+				}
+				throw std::runtime_error( "Property not found" );
+			} );
+		}
+
+	public:
+		handle_row( recorded_event const & event, property_handle_cache<size_t> & handles ): m_event( &event ), m_handles( &handles ) { }
+
+		bool operator( )( boost::wstring_ref property_name, std::wstring & out_value ) {
+			auto const & value = m_event->values( )[handle( property_name )];
+			out_value.assign( value.text.begin( ), value.text.end( ) );
+			return value_kind::text == value.kind;
+		}
+
+		template<typename T>
+		bool operator( )( boost::wstring_ref property_name, T & out_value ) {
+			auto const & value = m_event->values( )[handle( property_name )];
+			out_value = static_cast<T>(value.number);
+			return value_kind::number == value.kind;
+		}
+	};	// class handle_row
+}	// namespace anonymous
+
+int main( int argc, char * argv[] ) {
+	auto const seconds = argc > 1 ? std::atof( argv[1] ) : 0.5;
+	if( !(seconds > 0.0) ) {
+		std::fprintf( stderr, "Usage: %s [seconds_per_stage]\n", argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	auto const corpus = make_corpus( );
+	auto const rows = corpus.size( );
+	size_t const message = 2;
+	size_t const computer_name = 3;
+	size_t const time_generated = 4;
+	size_t const category = 5;
+
+	// Inputs to the later stages are made once, outside the timing
+	std::vector<message_fields> fields;
+	std::vector<logon_event> events;
+	for( auto const & event : corpus ) {
+		fields.push_back( extract_message_fields( text_of( event, message ) ) );
+	}
+	for( size_t n = 0; n < rows; ++n ) {
+		logon_event event;
+		event.event_code = static_cast<int>(corpus[n].values( )[0].number);
+		parse_cim_datetime( text_of( corpus[n], time_generated ), event.timestamp, event.utc_offset );
+		auto const & account = fields[n].target_account( event.event_code );
+		event.logon_type = parse_int( fields[n].logon_type );
+		event.security_id = account.security_id;
+		event.account_name = account.account_name;
+		event.account_domain = account.account_domain;
+		event.logon_id = parse_hex( account.logon_id ).value_or( 0 );
+		event.computer_name = text_of( corpus[n], computer_name );
+		event.category = text_of( corpus[n], category );
+		events.push_back( event );
+	}
+	string_pool row_names;
+	std::vector<result_row> result_rows;
+	for( auto const & event : events ) {
+		auto row = make_logon_row( event, row_names );
+		if( row_action::emit == row.action( ) ) {
+			result_rows.push_back( row.value( ) );
+		}
+	}
+
+	auto null_device = open_null_device( );
+	std::printf( "%zu rows per pass, %zu of them emitted\n\n", rows, result_rows.size( ) );
+	std::printf( "%-36s %12s %16s %12s\n", "stage", "ns/row", "allocations/row", "passes" );
+
+	run_stage( "extract_message_fields", rows, seconds, [&]( ) {
+		size_t total = 0;
+		for( auto const & event : corpus ) {
+			total += extract_message_fields( text_of( event, message ) ).logon_type.size( );
+		}
+		g_sink += total;
+	} );
+
+	run_stage( "parse_cim_datetime", rows, seconds, [&]( ) {
+		int64_t total = 0;
+		for( auto const & event : corpus ) {
+			int64_t timestamp = 0;
+			int16_t utc_offset = 0;
+			parse_cim_datetime( text_of( event, time_generated ), timestamp, utc_offset );
+			total += timestamp + utc_offset;
+		}
+		g_sink += static_cast<uint64_t>(total);
+	} );
+
+	run_stage( "parse_int + parse_hex", rows, seconds, [&]( ) {
+		uint64_t total = 0;
+		for( size_t n = 0; n < rows; ++n ) {
+			total += static_cast<uint64_t>(parse_int( fields[n].logon_type ).value_or( 0 ));
+			total += parse_hex( fields[n].new_logon.logon_id ).value_or( 0 );
+		}
+		g_sink += total;
+	} );
+
+	run_stage( "make_logon_row", rows, seconds, [&]( ) {
+		string_pool names;
+		uint64_t total = 0;
+		for( auto const & event : events ) {
+			auto row = make_logon_row( event, names );
+			total += static_cast<uint64_t>(row.action( ));
+		}
+		g_sink += total;
+	} );
+
+	// Six properties a row, the way the callback reads them
+	run_stage( "properties by name", rows, seconds, [&]( ) {
+		std::wstring text;
+		int64_t number = 0;
+		uint64_t total = 0;
+		for( auto const & event : corpus ) {
+			for( auto const & name : property_names ) {
+				total += event( name, text ) ? text.size( ) : (event( name, number ) ? 1 : 0);
+			}
+		}
+		g_sink += total;
+	} );
+
+	run_stage( "properties by handle", rows, seconds, [&]( ) {
+		property_handle_cache<size_t> handles;
+		std::wstring text;
+		int64_t number = 0;
+		uint64_t total = 0;
+		for( auto const & event : corpus ) {
+			handle_row row( event, handles );
+			for( auto const & name : property_names ) {
+				total += row( name, text ) ? text.size( ) : (row( name, number ) ? 1 : 0);
+			}
+		}
+		g_sink += total;
+	} );
+
+	run_stage( "csv output", rows, seconds, [&]( ) {
+		output_writer out( null_device, output_format::csv );
+		for( size_t n = 0; n < rows; ++n ) {
+			write_row( out, row_names, result_rows[n % result_rows.size( )] );
+		}
+		out.flush( );
+	} );
+
+	run_stage( "end to end callback + csv", rows, seconds, [&]( ) {
+		string_pool names;
+		property_handle_cache<size_t> handles;
+		output_writer out( null_device, output_format::csv );
+		std::wstring msg;
+		std::wstring time_str;
+		std::wstring computer;
+		std::wstring category_str;
+		for( auto const & event : corpus ) {
+			handle_row row_items( event, handles );
+			auto row = process_row( row_items, names, msg, time_str, computer, category_str );
+			if( row_action::emit == row.action( ) ) {
+				write_row( out, names, row.value( ) );
+			}
+		}
+		out.flush( );
+	} );
+
+	// Nine rows in ten skipped, the way the callback drops network and
+	// service logons, by throwing and by returning a row_result
+	auto const throwing_callback = []( size_t const n ) -> result_row {
+		if( 0 != n % 10 ) {
+			throw SkipRowException( );
+		}
+		result_row row;
+		row.logon_id = n;
+		return row;
+	};
+	auto const returning_callback = []( size_t const n ) -> row_result<result_row> {
+		if( 0 != n % 10 ) {
+			return row_result<result_row>::skip( );
+		}
+		result_row row;
+		row.logon_id = n;
+		return row;
+	};
+	std::printf( "\n" );
+	run_stage( "skip 90% by SkipRowException", rows, seconds, [&]( ) {
+		uint64_t total = 0;
+		for( size_t n = 0; n < rows; ++n ) {
+			auto row = impl::invoke_row_callback<result_row>( throwing_callback, n );
+			total += row_action::emit == row.action( ) ? row.value( ).logon_id : 1;
+		}
+		g_sink += total;
+	} );
+	run_stage( "skip 90% by row_result", rows, seconds, [&]( ) {
+		uint64_t total = 0;
+		for( size_t n = 0; n < rows; ++n ) {
+			auto row = impl::invoke_row_callback<result_row>( returning_callback, n );
+			total += row_action::emit == row.action( ) ? row.value( ).logon_id : 1;
+		}
+		g_sink += total;
+	} );
+
+	// Each pass copies the input so every sort starts from the same order.
+	// Both sorts reorder it in place, merge_runs_to when it reverses
+	// descending runs and extends short ones
+	std::printf( "\n%zu rows per sort\n\n", sort_size );
+	for( auto const order : { "descending", "merged hosts", "random", "sawtooth", "all equal" } ) {
+		auto const input = make_sort_input( order );
+		std::vector<result_row> work;
+		std::string const name = std::string( ": " ) + order;
+		run_stage( ("std::sort" + name).c_str( ), sort_size, seconds, [&]( ) {
+			work = input;
+			std::sort( work.begin( ), work.end( ) );
+			g_sink += work.front( ).logon_id;
+		} );
+		run_stage( ("natural_merge_sort" + name).c_str( ), sort_size, seconds, [&]( ) {
+			work = input;
+			natural_merge_sort( work.begin( ), work.end( ) );
+			g_sink += work.front( ).logon_id;
+		} );
+		run_stage( ("merge_runs_to" + name).c_str( ), sort_size, seconds, [&]( ) {
+			work = input;
+			uint64_t total = 0;
+			merge_runs_to( work.begin( ), work.end( ), [&total]( result_row const & row ) {
+				total = total * 31 + row.logon_id;
+			} );
+			g_sink += total;
+		} );
+	}
+
+	std::fclose( null_device );
+	return EXIT_SUCCESS;
+}
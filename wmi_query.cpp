@@ -26,6 +26,7 @@
 #endif
 #include <atlsafe.h>
 #include <exception>
+#include <limits>
 #include <boost/program_options.hpp>
 #include <iostream>
 #include <sstream>
@@ -42,6 +43,11 @@
 
 #include "wmi_query.h"
 #include "helpers.h"
+#include "run_stats.h"
+
+#ifdef max
+#undef max
+#endif
 
 namespace daw {
 	namespace wmi {
@@ -59,16 +65,118 @@ namespace daw {
 			}
 		}
 
-		IWbemWrapper::IWbemWrapper( ComSmartPtr<IWbemClassObject> obj ): m_obj( std::move( obj ) ) { }
+		IWbemWrapper::IWbemWrapper( ComSmartPtr<IWbemClassObject> obj ): m_obj( std::move( obj ) ), m_access( ), m_handles( nullptr ) { }
+
+		IWbemWrapper::IWbemWrapper( ComSmartPtr<IWbemClassObject> obj, wbem_property_handles & handles ): m_obj( std::move( obj ) ), m_access( ), m_handles( &handles ) {
+			if( m_obj && FAILED( m_obj->QueryInterface( IID_IWbemObjectAccess, reinterpret_cast<void **>(&m_access.ptr) ) ) ) {
+				m_access.ptr = nullptr;
+			}
+		}
 
 		ComSmartPtr<IWbemClassObject>& IWbemWrapper::ptr( ) {
 			return m_obj;
 		}
 
+		impl::property_handle IWbemWrapper::find_handle( boost::wstring_ref property_name ) {
+			if( !m_access || nullptr == m_handles ) {
+				return impl::property_handle { 0, CIM_EMPTY, false };
+			}
+			return m_handles->get( property_name, [this]( boost::wstring_ref name ) {
+				impl::property_handle result { 0, CIM_EMPTY, false };
+				auto const name_str = name.to_string( );
+				result.valid = SUCCEEDED( m_access->GetPropertyHandle( name_str.c_str( ), &result.type, &result.handle ) );
+				return result;
+			} );
+		}
+
+		bool IWbemWrapper::read_number( boost::wstring_ref property_name, int64_t & out_value ) {
+			auto const handle = find_handle( property_name );
+			if( !handle.valid ) {
+				return false;
+			}
+			// Anything but WBEM_S_NO_ERROR, such as WBEM_S_FALSE for null,
+			// is left to Get
+			switch( handle.type ) {
+			case CIM_SINT8:
+			case CIM_UINT8:
+			case CIM_SINT16:
+			case CIM_UINT16: {
+				union {
+					int8_t i8;
+					uint8_t u8;
+					int16_t i16;
+					uint16_t u16;
+				} value { };
+				long bytes_read = 0;
+				if( WBEM_S_NO_ERROR != m_access->ReadPropertyValue( handle.handle, sizeof( value ), &bytes_read, reinterpret_cast<BYTE *>(&value) ) ) {
+					return false;
+				}
+				switch( handle.type ) {
+				case CIM_SINT8:
+					out_value = value.i8;
+					break;
+				case CIM_UINT8:
+					out_value = value.u8;
+					break;
+				case CIM_SINT16:
+					out_value = value.i16;
+					break;
+				default:
+					out_value = value.u16;
+					break;
+				}
+				return true;
+			}
+			case CIM_SINT32:
+			case CIM_UINT32: {
+				DWORD value = 0;
+				if( WBEM_S_NO_ERROR != m_access->ReadDWORD( handle.handle, &value ) ) {
+					return false;
+				}
+				out_value = CIM_SINT32 == handle.type ? static_cast<int64_t>(static_cast<int32_t>(value)) : static_cast<int64_t>(value);
+				return true;
+			}
+			case CIM_SINT64:
+			case CIM_UINT64: {
+				unsigned __int64 value = 0;
+				if( WBEM_S_NO_ERROR != m_access->ReadQWORD( handle.handle, &value ) ) {
+					return false;
+				}
+				out_value = static_cast<int64_t>(value);
+				return true;
+			}
+			default:
+				return false;
+			}
+		}
+
 		bool IWbemWrapper::operator( )( boost::wstring_ref property_name, std::wstring& out_value ) {
+			auto const handle = find_handle( property_name );
+			if( handle.valid && (CIM_STRING == handle.type || CIM_DATETIME == handle.type) ) {
+				// Reused by every row read on this thread
+				static thread_local std::vector<BYTE> buffer( 1024 );
+				long bytes_read = 0;
+				auto hr = m_access->ReadPropertyValue( handle.handle, static_cast<long>(buffer.size( )), &bytes_read, buffer.data( ) );
+				if( WBEM_E_BUFFER_TOO_SMALL == hr && bytes_read > 0 ) {
+					buffer.resize( static_cast<size_t>(bytes_read) );
+					hr = m_access->ReadPropertyValue( handle.handle, static_cast<long>(buffer.size( )), &bytes_read, buffer.data( ) );
+				}
+				if( WBEM_S_NO_ERROR == hr ) {
+					// The value is null terminated
+					auto const first = reinterpret_cast<wchar_t const *>(buffer.data( ));
+					auto const length = static_cast<size_t>(bytes_read) / sizeof( wchar_t );
+					out_value.assign( first, length > 0 ? length - 1 : 0 );
+					return true;
+				}
+			}
 			return helpers::get_property( m_obj, property_name, out_value );
 		}
 
+		bool IWbemWrapper::operator( )( boost::wstring_ref property_name, std::vector<std::wstring> & out_values ) {
+			// IWbemObjectAccess cannot read arrays
+			return helpers::get_property( m_obj, property_name, out_values );
+		}
+
 		namespace impl {
 
 			class COMConnection {
@@ -99,6 +207,15 @@ namespace daw {
 				}() );
 				return cc;
 			}
+
+			com_thread_scope::com_thread_scope( ) {
+				throw_on_fail( CoInitializeEx( nullptr, COINIT_MULTITHREADED ), "Failed to initialize COM library." );
+			}
+
+			com_thread_scope::~com_thread_scope( ) {
+				CoUninitialize( );
+			}
+
 			Authentication::Authentication( bool const PromptCredentials, bool const UseNtlm ): m_name { }, m_password { }, m_domain { }, m_user_name { }, m_authority { }, m_use_token( true ), m_use_ntlm( UseNtlm ), m_auth_ident( { } ), m_user_account( nullptr ) {
 				if( PromptCredentials ) {
 					CREDUI_INFO cui { };
@@ -216,6 +333,7 @@ namespace daw {
 			}
 
 			ComSmartPtr<IWbemServices> connect_to_server( ComSmartPtr<IWbemLocator> & com_ptr, boost::wstring_ref host, Authentication & auth ) {
+				phase_timer const timer( run_phase::connect );
 				ComSmartPtr<IWbemServices> svc_ptr;
 
 				// Connect to the remote root\cimv2 namespace
@@ -234,13 +352,39 @@ namespace daw {
 
 				throw_on_fail( query_enumerator->Next( WBEM_INFINITE, 1, &(value.ptr), &value_type ), "Error getting next object from query." );
 				
-				if( 0 == value_type ) {
-					// TODO figure out better
-					throw StopProcessingException( );
-				}
+				// No object returned means the end of the enumeration and value is
+				// still empty
 				return value;
 			}
 
+			wbem_object_enumerator::wbem_object_enumerator( ComSmartPtr<IEnumWbemClassObject> query_enumerator ): m_enumerator( std::move( query_enumerator ) ), m_buffer( ) { }
+
+			bool wbem_object_enumerator::next_batch( std::vector<ComSmartPtr<IWbemClassObject>> & out_values, size_t max_count ) {
+				assert( std::numeric_limits<ULONG>::max( ) >= max_count );
+				out_values.clear( );
+				if( !m_enumerator ) {
+					return false;
+				}
+				m_buffer.assign( max_count, nullptr );
+				ULONG count = 0;
+
+				// Called from the prefetch thread.  It has not initialized COM so it
+				// runs in the process's implicit MTA, which is where the proxy lives
+				auto const hres = throw_on_fail( m_enumerator->Next( WBEM_INFINITE, static_cast<ULONG>(max_count), m_buffer.data( ), &count ), "Error getting next objects from query." );
+
+				out_values.resize( count );
+				for( ULONG n = 0; n < count; ++n ) {
+					// Next has already AddRef'd each object
+					out_values[n].ptr = m_buffer[n];
+				}
+				// WBEM_S_FALSE means fewer than max_count objects remained
+				if( WBEM_S_FALSE == hres || 0 == count ) {
+					m_enumerator.Release( );
+					return false;
+				}
+				return true;
+			}
+
 			SA::SA( ): ptr( nullptr ) { }
 
 			SA::~SA( ) {
@@ -260,20 +404,12 @@ namespace daw {
 					auto msg = ss.str( );
 					throw std::runtime_error( msg );
 				}
-				long current_prop, last_prop;
-				SafeArrayGetLBound( sa.ptr, 1, &current_prop );
-				SafeArrayGetUBound( sa.ptr, 1, &last_prop );
-				CComBSTR property_name;
-				
-				for( auto n = current_prop; n <= last_prop; ++n ) {
-					hres = SafeArrayGetElement( sa.ptr, &n, &property_name );
-					assert( nullptr != property_name );
-					results.emplace_back( property_name, SysStringLen( property_name ) );
-				}
+				helpers::get_strings( sa.ptr, results );
 				return results;
 			}
 
 			ComSmartPtr<IEnumWbemClassObject> execute_wmi_query( ComSmartPtr<IWbemServices> & com_ptr, boost::string_ref &query ) {
+				phase_timer const timer( run_phase::execute );
 				auto const wmi_query = ComSmartBtr( query.data( ) );
 				auto const wql = ComSmartBtr( "WQL" );
 
@@ -283,7 +419,122 @@ namespace daw {
 
 				return pEnumerator;
 			}
+
+			event_sink::event_sink( blocking_queue<ComSmartPtr<IWbemClassObject>> & events ): m_ref_count( 0 ), m_events( events ), m_status( S_OK ) { }
+
+			ULONG event_sink::AddRef( ) {
+				return static_cast<ULONG>(InterlockedIncrement( &m_ref_count ));
+			}
+
+			ULONG event_sink::Release( ) {
+				auto const ref_count = InterlockedDecrement( &m_ref_count );
+				if( 0 == ref_count ) {
+					delete this;
+				}
+				return static_cast<ULONG>(ref_count);
+			}
+
+			HRESULT event_sink::QueryInterface( REFIID riid, void ** ppv ) {
+				if( IID_IUnknown == riid || IID_IWbemObjectSink == riid ) {
+					*ppv = static_cast<IWbemObjectSink *>(this);
+					AddRef( );
+					return WBEM_S_NO_ERROR;
+				}
+				*ppv = nullptr;
+				return E_NOINTERFACE;
+			}
+
+			HRESULT event_sink::Indicate( LONG object_count, IWbemClassObject __RPC_FAR * __RPC_FAR * objects ) {
+				for( LONG n = 0; n < object_count; ++n ) {
+					// The event wraps the new Win32_NTLogEvent in TargetInstance
+					CComVariant target;
+					if( FAILED( objects[n]->Get( L"TargetInstance", 0, &target, nullptr, nullptr ) ) || VT_UNKNOWN != target.vt || nullptr == target.punkVal ) {
+						continue;
+					}
+					ComSmartPtr<IWbemClassObject> instance;
+					if( SUCCEEDED( target.punkVal->QueryInterface( IID_IWbemClassObject, reinterpret_cast<void **>(&instance.ptr) ) ) ) {
+						m_events.push( std::move( instance ) );
+					}
+				}
+				return WBEM_S_NO_ERROR;
+			}
+
+			HRESULT event_sink::SetStatus( LONG flags, HRESULT result, BSTR, IWbemClassObject __RPC_FAR * ) {
+				if( WBEM_STATUS_COMPLETE == flags ) {
+					// Cancelling the call also completes it, that is not an error
+					if( FAILED( result ) && WBEM_E_CALL_CANCELLED != result ) {
+						m_status = result;
+					}
+					m_events.close( );
+				}
+				return WBEM_S_NO_ERROR;
+			}
+
+			HRESULT event_sink::status( ) const {
+				return m_status;
+			}
+
+			event_subscription::event_subscription( boost::wstring_ref host, ComSmartPtr<IWbemServices> svc, boost::string_ref query, blocking_queue<ComSmartPtr<IWbemClassObject>> & events ): m_svc( std::move( svc ) ), m_sink( new event_sink( events ) ), m_stub_sink( ), m_host( host.to_string( ) ) {
+				// Deliver the callbacks through an unsecured apartment so that the
+				// remote host does not need to authenticate to us
+				ComSmartPtr<IUnsecuredApartment> apartment;
+				throw_on_fail( CoCreateInstance( CLSID_UnsecuredApartment, nullptr, CLSCTX_LOCAL_SERVER, IID_IUnsecuredApartment, reinterpret_cast<void **>(&apartment.ptr) ), "Failed to create unsecured apartment." );
+				ComSmartPtr<IUnknown> stub;
+				throw_on_fail( apartment->CreateObjectStub( m_sink.ptr, &stub.ptr ), "Failed to create event sink stub." );
+				throw_on_fail( stub->QueryInterface( IID_IWbemObjectSink, reinterpret_cast<void **>(&m_stub_sink.ptr) ), "Failed to get event sink stub." );
+
+				auto const wmi_query = ComSmartBtr( query );
+				auto const wql = ComSmartBtr( "WQL" );
+				throw_on_fail( m_svc->ExecNotificationQueryAsync( wql.ptr, wmi_query.ptr, WBEM_FLAG_SEND_STATUS, nullptr, m_stub_sink.ptr ), "Event notification query." );
+			}
+
+			event_subscription::~event_subscription( ) {
+				if( m_svc && m_stub_sink ) {
+					m_svc->CancelAsyncCall( m_stub_sink.ptr );
+				}
+			}
+
+			void event_subscription::check_status( ) const {
+				auto const hres = m_sink ? m_sink->status( ) : S_OK;
+				if( FAILED( hres ) ) {
+					std::stringstream ss;
+					ss << "Event subscription on " << std::string( m_host.begin( ), m_host.end( ) ) << " failed.";
+					throw_on_fail( hres, ss.str( ) );
+				}
+			}
 		}	// namespace impl
 
+		wmi_session::wmi_session( bool const prompt_credentials, bool const use_ntlm, size_t const max_connections ):
+				m_com( impl::intialize_COM( ) ),
+				m_auth( prompt_credentials, use_ntlm ),
+				m_locator( impl::obtain_wmi_locator( ) ),
+				m_connections( max_connections ) { }
+
+		ComSmartPtr<IWbemServices> wmi_session::connect( boost::wstring_ref host ) {
+			auto svc = impl::connect_to_server( m_locator, host, m_auth );
+			impl::set_wmi_security( svc, m_auth );
+			return svc;
+		}
+
+		impl::Authentication & wmi_session::auth( ) {
+			return m_auth;
+		}
+
+		ComSmartPtr<IWbemServices> wmi_session::services( boost::wstring_ref host ) {
+			bool reused = false;
+			return m_connections.get( host, [this]( boost::wstring_ref h ) { return connect( h ); }, reused );
+		}
+
+		ComSmartPtr<IEnumWbemClassObject> wmi_session::execute( boost::wstring_ref host, boost::string_ref query ) {
+			return m_connections.use( host, [this]( boost::wstring_ref h ) { return connect( h ); }, [&]( ComSmartPtr<IWbemServices> & svc ) {
+				auto query_enum = impl::execute_wmi_query( svc, query );
+				impl::set_wmi_security( query_enum, m_auth );
+				return query_enum;
+			} );
+		}
+
+		void wmi_session::disconnect( boost::wstring_ref host ) {
+			m_connections.remove( host );
+		}
 	}	// namespace wmi
 }	// namespace daw
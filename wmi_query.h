@@ -29,19 +29,50 @@
 #include <atlbase.h>
 #include <boost/program_options.hpp>
 #include <boost/utility/string_ref.hpp>
+#include <atomic>
 #include <functional>
 #include <vector>
 #include <Wbemidl.h>
 
+#include "connection_cache.h"
+#include "enumerator.h"
+#include "event_queue.h"
 #include "helpers.h"
+#include "property_handles.h"
+#include "row_disposition.h"
+#include "row_source.h"
 
 namespace daw {
 	namespace wmi {
+		namespace impl {
+			struct property_handle {
+				long handle;
+				CIMTYPE type;
+				bool valid;
+			};	// struct property_handle
+		}	// namespace impl
+
+		using wbem_property_handles = property_handle_cache<impl::property_handle>;
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Reads the properties of one object.  Given the
+		///				property handles of its query, values are read through
+		///				IWbemObjectAccess by handle, without the name lookup
+		///				and VARIANT of IWbemClassObject::Get.  Get is still
+		///				used for types without a handle read, null values and
+		///				objects without IWbemObjectAccess.
+		//////////////////////////////////////////////////////////////////////////
 		class IWbemWrapper {
 			ComSmartPtr<IWbemClassObject> m_obj;
+			ComSmartPtr<IWbemObjectAccess> m_access;
+			wbem_property_handles * m_handles;
+
+			impl::property_handle find_handle( boost::wstring_ref property_name );
+			bool read_number( boost::wstring_ref property_name, int64_t & out_value );
 
 		public:
 			explicit IWbemWrapper( ComSmartPtr<IWbemClassObject> obj );
+			IWbemWrapper( ComSmartPtr<IWbemClassObject> obj, wbem_property_handles & handles );
 			~IWbemWrapper( ) = default;
 			IWbemWrapper( IWbemWrapper const & ) = delete;
 			IWbemWrapper & operator=( IWbemWrapper const & ) = delete;
@@ -52,34 +83,34 @@ namespace daw {
 
 			template<typename T>
 			bool operator( )( boost::wstring_ref property_name, T & out_value ) {
+				int64_t value = 0;
+				if( read_number( property_name, value ) ) {
+					out_value = static_cast<T>(value);
+					return true;
+				}
 				return helpers::get_property( m_obj, property_name, out_value );
 			}
 
 			bool operator( )( boost::wstring_ref property_name, std::wstring & out_value );
+			bool operator( )( boost::wstring_ref property_name, std::vector<std::wstring> & out_values );
 		};	// class IWBemWrapper
 
-		struct SkipRowException {
-			SkipRowException( ) = default;
-			~SkipRowException( ) = default;
-			SkipRowException( SkipRowException const & ) = default;
-			SkipRowException( SkipRowException && ) = default;
-			SkipRowException & operator=( SkipRowException const & ) = default;
-			SkipRowException & operator=( SkipRowException && ) = default;
-		};	// struct SkipRowException
-
-		struct StopProcessingException {
-			StopProcessingException( ) = default;
-			~StopProcessingException( ) = default;
-			StopProcessingException( StopProcessingException const & ) = default;
-			StopProcessingException( StopProcessingException && ) = default;
-			StopProcessingException & operator=( StopProcessingException const & ) = default;
-			StopProcessingException & operator=( StopProcessingException && ) = default;
-		};	// struct StopProcessingException
-	
 		namespace impl {
 			class COMConnection;
 			std::shared_ptr<COMConnection> intialize_COM( );
 
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Join the multithreaded apartment for the lifetime of
+			///				the object.  For worker threads; intialize_COM must
+			///				already have been called on the main thread.
+			//////////////////////////////////////////////////////////////////////////
+			struct com_thread_scope {
+				com_thread_scope( );
+				~com_thread_scope( );
+				com_thread_scope( com_thread_scope const & ) = delete;
+				com_thread_scope & operator=( com_thread_scope const & ) = delete;
+			};	// struct com_thread_scope
+
 			struct Authentication {
 				using sec_array = daw::wmi::helpers::secure_wipe_array<wchar_t, CREDUI_MAX_USERNAME_LENGTH + 1>;
 			private:
@@ -123,8 +154,22 @@ namespace daw {
 
 			ComSmartPtr<IEnumWbemClassObject> execute_wmi_query( ComSmartPtr<IWbemServices> & com_ptr, boost::string_ref &query );
 
+			/// Summary: Next object from the query, or an empty pointer at the end
 			ComSmartPtr<IWbemClassObject> enumerator_next( ComSmartPtr<IEnumWbemClassObject> & query_enumerator );
 
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Pulls query results max_count objects per call to
+			///				IEnumWbemClassObject::Next.  The enumerator proxy
+			///				must already be secured.
+			//////////////////////////////////////////////////////////////////////////
+			class wbem_object_enumerator: public object_enumerator<ComSmartPtr<IWbemClassObject>> {
+				ComSmartPtr<IEnumWbemClassObject> m_enumerator;
+				std::vector<IWbemClassObject *> m_buffer;
+			public:
+				explicit wbem_object_enumerator( ComSmartPtr<IEnumWbemClassObject> query_enumerator );
+				bool next_batch( std::vector<ComSmartPtr<IWbemClassObject>> & out_values, size_t max_count ) override;
+			};	// class wbem_object_enumerator
+
 			//////////////////////////////////////////////////////////////////////////
 			/// Summary: Guarantee proper destruction of SAFEARRAY
 			//////////////////////////////////////////////////////////////////////////
@@ -139,14 +184,135 @@ namespace daw {
 			};	// struct SA
 
 			std::vector<std::wstring> get_property_names( ComSmartPtr<IWbemClassObject>& ptr );
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Receives the results of an event notification query and
+			///				pushes the TargetInstance of each event to a queue.
+			///				WMI calls it on its own threads.
+			//////////////////////////////////////////////////////////////////////////
+			class event_sink: public IWbemObjectSink {
+				LONG m_ref_count;
+				blocking_queue<ComSmartPtr<IWbemClassObject>> & m_events;
+				std::atomic<HRESULT> m_status;
+
+			public:
+				explicit event_sink( blocking_queue<ComSmartPtr<IWbemClassObject>> & events );
+				virtual ~event_sink( ) = default;
+				event_sink( event_sink const & ) = delete;
+				event_sink & operator=( event_sink const & ) = delete;
+
+				ULONG STDMETHODCALLTYPE AddRef( ) override;
+				ULONG STDMETHODCALLTYPE Release( ) override;
+				HRESULT STDMETHODCALLTYPE QueryInterface( REFIID riid, void ** ppv ) override;
+				HRESULT STDMETHODCALLTYPE Indicate( LONG object_count, IWbemClassObject __RPC_FAR * __RPC_FAR * objects ) override;
+				HRESULT STDMETHODCALLTYPE SetStatus( LONG flags, HRESULT result, BSTR param, IWbemClassObject __RPC_FAR * obj_param ) override;
+
+				/// Summary: Failure reported by WMI when it ended the subscription, S_OK otherwise
+				HRESULT status( ) const;
+			};	// class event_sink
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	An asynchronous event notification query against one
+			///				host.  The subscription is cancelled on destruction
+			//////////////////////////////////////////////////////////////////////////
+			class event_subscription {
+				ComSmartPtr<IWbemServices> m_svc;
+				ComSmartPtr<event_sink> m_sink;
+				ComSmartPtr<IWbemObjectSink> m_stub_sink;
+				std::wstring m_host;
+
+			public:
+				/// Summary: svc must already be secured
+				event_subscription( boost::wstring_ref host, ComSmartPtr<IWbemServices> svc, boost::string_ref query, blocking_queue<ComSmartPtr<IWbemClassObject>> & events );
+				~event_subscription( );
+				event_subscription( event_subscription const & ) = delete;
+				event_subscription & operator=( event_subscription const & ) = delete;
+				event_subscription( event_subscription && ) = default;
+				event_subscription & operator=( event_subscription && ) = default;
+
+				/// Summary: Throw if WMI ended the subscription with an error
+				void check_status( ) const;
+			};	// class event_subscription
 		}	// namespace impl		
 
-		template<typename T>
-		std::vector<T> wmi_query( boost::wstring_ref host, boost::string_ref query, bool const prompt_credentials, std::function<T( IWbemWrapper )> callback, bool const use_ntlm = false ) {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	What queries against any number of hosts can share: the
+		///				locator, the credentials, prompted for once, and a
+		///				secured IWbemServices proxy per host that later
+		///				queries to the host reuse.  Safe to use from several
+		///				threads in the multithreaded apartment.
+		//////////////////////////////////////////////////////////////////////////
+		class wmi_session {
+			std::shared_ptr<impl::COMConnection> m_com;
+			impl::Authentication m_auth;
+			ComSmartPtr<IWbemLocator> m_locator;
+			connection_cache<ComSmartPtr<IWbemServices>> m_connections;
 
-			auto wmi_locator = impl::obtain_wmi_locator( );
+			ComSmartPtr<IWbemServices> connect( boost::wstring_ref host );
 
-			impl::Authentication auth( prompt_credentials, use_ntlm );
+		public:
+			explicit wmi_session( bool const prompt_credentials = false, bool const use_ntlm = false, size_t const max_connections = connection_cache<ComSmartPtr<IWbemServices>>::default_max_size );
+			~wmi_session( ) = default;
+			wmi_session( wmi_session const & ) = delete;
+			wmi_session & operator=( wmi_session const & ) = delete;
+
+			impl::Authentication & auth( );
+
+			/// Summary: The secured proxy for host, connecting if there is none
+			ComSmartPtr<IWbemServices> services( boost::wstring_ref host );
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Start query on host and return the secured enumerator
+			///				of its results.  A reused proxy that fails to start
+			///				the query is replaced by a new connection and the
+			///				query is tried once more.
+			//////////////////////////////////////////////////////////////////////////
+			ComSmartPtr<IEnumWbemClassObject> execute( boost::wstring_ref host, boost::string_ref query );
+
+			/// Summary: Drop the proxy kept for host
+			void disconnect( boost::wstring_ref host );
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	Run query on host and collect the rows emitted by
+			///				callback, as wmi_query does, over the kept connection
+			//////////////////////////////////////////////////////////////////////////
+			template<typename T, typename Callback>
+			std::vector<T> query( boost::wstring_ref host, boost::string_ref query, Callback callback, size_t const batch_size = default_batch_size ) {
+				impl::wbem_object_enumerator source( execute( host, query ) );
+				wbem_property_handles handles;
+				return read_rows<T>( source, [&callback, &handles]( ComSmartPtr<IWbemClassObject> obj ) {
+					return impl::invoke_row_callback<T>( callback, IWbemWrapper( std::move( obj ), handles ) );
+				}, batch_size );
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Summary:	query with the rows processed by workers threads while
+			///				another reads the results, see read_rows_parallel.
+			///				Worker n uses the callback from make_callback( n ).
+			//////////////////////////////////////////////////////////////////////////
+			template<typename T, typename MakeCallback>
+			std::vector<T> query_parallel( boost::wstring_ref host, boost::string_ref query, size_t const workers, MakeCallback make_callback, size_t const batch_size = default_batch_size ) {
+				impl::wbem_object_enumerator source( execute( host, query ) );
+				return read_rows_parallel<T, impl::com_thread_scope>( source, workers, [&make_callback]( size_t const worker ) {
+					// Property handles are not thread safe, each worker has its own
+					return [callback = make_callback( worker ), handles = wbem_property_handles( )]( ComSmartPtr<IWbemClassObject> obj ) mutable {
+						return impl::invoke_row_callback<T>( callback, IWbemWrapper( std::move( obj ), handles ) );
+					};
+				}, batch_size );
+			}
+		};	// class wmi_session
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Run query on host and collect the rows emitted by
+		///				callback.  The callback is given an IWbemWrapper for each
+		///				object and returns a row_result<T>.  Callbacks returning
+		///				a T and throwing SkipRowException/StopProcessingException
+		///				are still accepted.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename T, typename Callback>
+		std::vector<T> wmi_query( boost::wstring_ref host, boost::string_ref query, impl::Authentication & auth, Callback callback, size_t const batch_size = default_batch_size ) {
+
+			auto wmi_locator = impl::obtain_wmi_locator( );
 
 			// Connect to WMI through the IWbemLocator::ConnectServer method
 			auto wmi_svc = connect_to_server( wmi_locator, host, auth );
@@ -160,21 +326,41 @@ namespace daw {
 			// Secure the enumerator proxy
 			impl::set_wmi_security( wmi_query_enum, auth );
 
+			impl::wbem_object_enumerator source( std::move( wmi_query_enum ) );
+			wbem_property_handles handles;
+			return read_rows<T>( source, [&callback, &handles]( ComSmartPtr<IWbemClassObject> obj ) {
+				return impl::invoke_row_callback<T>( callback, IWbemWrapper( std::move( obj ), handles ) );
+			}, batch_size );
+		}
 
-			std::vector<T> results;
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Subscribe to the event notification query on each host
+		///				and pass the TargetInstance of each event to callback as
+		///				it arrives, then the result to output.  Runs until
+		///				events is closed, the callback throws
+		///				StopProcessingException or a subscription fails.
+		//////////////////////////////////////////////////////////////////////////
+		template<typename T, typename Callback, typename Output>
+		void wmi_follow( std::vector<std::wstring> const & hosts, boost::string_ref query, wmi_session & session, blocking_queue<ComSmartPtr<IWbemClassObject>> & events, Callback callback, Output output ) {
+			std::vector<impl::event_subscription> subscriptions;
+			subscriptions.reserve( hosts.size( ) );
+			for( auto const & host : hosts ) {
+				subscriptions.emplace_back( host, session.services( host ), query, events );
+			}
 
-			while( wmi_query_enum ) {				
-				try {
-					auto current_obj = impl::enumerator_next( wmi_query_enum );
-					auto result = callback( IWbemWrapper( current_obj ) );
-					results.push_back( std::move( result ) );
-				} catch( SkipRowException const & ) {
-					continue;
-				} catch( StopProcessingException const & ) {
-					break;
-				}
+			follow_events<T>( events, [&callback]( ComSmartPtr<IWbemClassObject> obj ) {
+				return callback( IWbemWrapper( std::move( obj ) ) );
+			}, output );
+
+			for( auto const & subscription : subscriptions ) {
+				subscription.check_status( );
 			}
-			return results;
+		}
+
+		template<typename T, typename Callback>
+		std::vector<T> wmi_query( boost::wstring_ref host, boost::string_ref query, bool const prompt_credentials, Callback callback, bool const use_ntlm = false, size_t const batch_size = default_batch_size ) {
+			impl::Authentication auth( prompt_credentials, use_ntlm );
+			return wmi_query<T>( host, query, auth, std::move( callback ), batch_size );
 		}
 
 	}	// namespace wmi
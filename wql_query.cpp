@@ -0,0 +1,173 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "wql_query.h"
+
+#include <stdexcept>
+
+namespace daw {
+	namespace wmi {
+		namespace {
+			bool is_comparison( boost::string_ref op ) {
+				return op == "<" || op == "<=" || op == ">" || op == ">=" || op == "<>";
+			}
+
+			bool all_digits( boost::string_ref value ) {
+				for( auto const c : value ) {
+					if( c < '0' || c > '9' ) {
+						return false;
+					}
+				}
+				return true;
+			}
+
+			int to_int( boost::string_ref digits ) {
+				int result = 0;
+				for( auto const c : digits ) {
+					result = result * 10 + (c - '0');
+				}
+				return result;
+			}
+		}	// namespace anonymous
+
+		wql_query::wql_query( boost::string_ref class_name ): m_class_name( class_name.to_string( ) ), m_properties( ), m_conditions( ), m_polling_interval( 0 ) { }
+
+		wql_query & wql_query::select( boost::string_ref property_name ) {
+			m_properties.push_back( property_name.to_string( ) );
+			return *this;
+		}
+
+		wql_query & wql_query::select( std::initializer_list<boost::string_ref> property_names ) {
+			for( auto const & property_name : property_names ) {
+				select( property_name );
+			}
+			return *this;
+		}
+
+		wql_query & wql_query::where_equal( boost::string_ref property_name, boost::string_ref value ) {
+			m_conditions.push_back( property_name.to_string( ) + "=" + wql_string_literal( value ) );
+			return *this;
+		}
+
+		wql_query & wql_query::where_equal( boost::string_ref property_name, int64_t const value ) {
+			m_conditions.push_back( property_name.to_string( ) + "=" + std::to_string( value ) );
+			return *this;
+		}
+
+		wql_query & wql_query::where_any_of( boost::string_ref property_name, std::vector<int64_t> const & values ) {
+			if( values.empty( ) ) {
+				throw std::invalid_argument( "where_any_of requires at least one value" );
+			}
+			std::string condition = "(";
+			for( size_t n = 0; n < values.size( ); ++n ) {
+				if( n > 0 ) {
+					condition += " Or ";
+				}
+				condition += property_name.to_string( ) + "=" + std::to_string( values[n] );
+			}
+			condition += ")";
+			m_conditions.push_back( std::move( condition ) );
+			return *this;
+		}
+
+		wql_query & wql_query::within( unsigned const polling_interval ) {
+			m_polling_interval = polling_interval;
+			return *this;
+		}
+
+		wql_query & wql_query::where_isa( boost::string_ref property_name, boost::string_ref class_name ) {
+			m_conditions.push_back( property_name.to_string( ) + " Isa " + wql_string_literal( class_name ) );
+			return *this;
+		}
+
+		wql_query & wql_query::where_compare( boost::string_ref property_name, boost::string_ref op, boost::string_ref value ) {
+			if( !is_comparison( op ) ) {
+				throw std::invalid_argument( "Unsupported WQL comparison operator" );
+			}
+			m_conditions.push_back( property_name.to_string( ) + op.to_string( ) + wql_string_literal( value ) );
+			return *this;
+		}
+
+		wql_query & wql_query::where_compare( boost::string_ref property_name, boost::string_ref op, int64_t const value ) {
+			if( !is_comparison( op ) ) {
+				throw std::invalid_argument( "Unsupported WQL comparison operator" );
+			}
+			m_conditions.push_back( property_name.to_string( ) + op.to_string( ) + std::to_string( value ) );
+			return *this;
+		}
+
+		std::string wql_query::str( ) const {
+			std::string result = "Select ";
+			if( m_properties.empty( ) ) {
+				result += "*";
+			} else {
+				for( size_t n = 0; n < m_properties.size( ); ++n ) {
+					if( n > 0 ) {
+						result += ", ";
+					}
+					result += m_properties[n];
+				}
+			}
+			result += " from " + m_class_name;
+			if( m_polling_interval > 0 ) {
+				result += " Within " + std::to_string( m_polling_interval );
+			}
+			for( size_t n = 0; n < m_conditions.size( ); ++n ) {
+				result += 0 == n ? " Where " : " And ";
+				result += m_conditions[n];
+			}
+			return result;
+		}
+
+		std::string wql_string_literal( boost::string_ref value ) {
+			std::string result = "'";
+			for( auto const c : value ) {
+				if( '\'' == c || '\\' == c ) {
+					result += '\\';
+				}
+				result += c;
+			}
+			result += "'";
+			return result;
+		}
+
+		boost::optional<std::string> cim_datetime_from_argument( boost::string_ref value ) {
+			if( (8 != value.size( ) && 14 != value.size( )) || !all_digits( value ) ) {
+				return boost::optional<std::string>( );
+			}
+			auto const month = to_int( value.substr( 4, 2 ) );
+			auto const day = to_int( value.substr( 6, 2 ) );
+			if( month < 1 || month > 12 || day < 1 || day > 31 ) {
+				return boost::optional<std::string>( );
+			}
+			std::string result = value.to_string( );
+			if( 8 == value.size( ) ) {
+				result += "000000";
+			} else if( to_int( value.substr( 8, 2 ) ) > 23 || to_int( value.substr( 10, 2 ) ) > 59 || to_int( value.substr( 12, 2 ) ) > 59 ) {
+				return boost::optional<std::string>( );
+			}
+			result += ".000000+000";
+			return boost::optional<std::string>( std::move( result ) );
+		}
+	}	// namespace wmi
+}	// namespace daw
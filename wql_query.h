@@ -0,0 +1,89 @@
+// The MIT License (MIT)
+// 
+// Copyright (c) 2016 Darrell Wright
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace daw {
+	namespace wmi {
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Builds a WQL select.  Only the selected properties are
+		///				returned by the server and all conditions are And'ed
+		///				together and evaluated by the server.
+		//////////////////////////////////////////////////////////////////////////
+		class wql_query {
+			std::string m_class_name;
+			std::vector<std::string> m_properties;
+			std::vector<std::string> m_conditions;
+			unsigned m_polling_interval;
+
+		public:
+			explicit wql_query( boost::string_ref class_name );
+			~wql_query( ) = default;
+			wql_query( wql_query const & ) = default;
+			wql_query & operator=( wql_query const & ) = default;
+			wql_query( wql_query && ) = default;
+			wql_query & operator=( wql_query && ) = default;
+
+			/// Summary: Add properties to the projection.  With none selected all are returned
+			wql_query & select( boost::string_ref property_name );
+			wql_query & select( std::initializer_list<boost::string_ref> property_names );
+
+			wql_query & where_equal( boost::string_ref property_name, boost::string_ref value );
+			wql_query & where_equal( boost::string_ref property_name, int64_t const value );
+
+			/// Summary: property_name equals one of values
+			wql_query & where_any_of( boost::string_ref property_name, std::vector<int64_t> const & values );
+
+			/// Summary: For event queries, how often in seconds WMI polls for new instances
+			wql_query & within( unsigned const polling_interval );
+
+			/// Summary: property_name is an instance of class_name, e.g. TargetInstance of an event
+			wql_query & where_isa( boost::string_ref property_name, boost::string_ref class_name );
+
+			/// Summary: property_name op value where op is one of <, <=, >, >=, <>
+			wql_query & where_compare( boost::string_ref property_name, boost::string_ref op, boost::string_ref value );
+			wql_query & where_compare( boost::string_ref property_name, boost::string_ref op, int64_t const value );
+
+			std::string str( ) const;
+		};	// class wql_query
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Quote and escape value as a WQL string literal
+		//////////////////////////////////////////////////////////////////////////
+		std::string wql_string_literal( boost::string_ref value );
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Summary:	Convert a UTC time given as YYYYMMDD or YYYYMMDDHHMMSS to
+		///				a CIM_DATETIME string usable in a WQL comparison.
+		///				Returns nothing when value is not in either form
+		//////////////////////////////////////////////////////////////////////////
+		boost::optional<std::string> cim_datetime_from_argument( boost::string_ref value );
+	}	// namespace wmi
+}	// namespace daw